@@ -0,0 +1,201 @@
+/* Background Scaling Micro-benchmark
+ *
+ * Times scaling a wallpaper onto a monitor-sized cairo surface, through
+ * cairo's GdkPixbuf source & filtering like the greeter used to, & through
+ * the greeter's own kernels for every instruction set this CPU supports, on
+ * one thread & on every core.
+ *
+ * Usage: image-scale [IMAGE [WIDTH HEIGHT [ITERATIONS]]]
+ *
+ * Without an image, a 7680x4320 RGB gradient is scaled to 3840x2160, like an
+ * 8K wallpaper covering a 4K monitor.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cairo.h>
+#include <gdk/gdk.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <glib.h>
+
+#include "image_scale.h"
+
+#define DEFAULT_SOURCE_WIDTH  7680
+#define DEFAULT_SOURCE_HEIGHT 4320
+#define DEFAULT_TARGET_WIDTH  3840
+#define DEFAULT_TARGET_HEIGHT 2160
+#define DEFAULT_ITERATIONS    10
+
+
+static GdkPixbuf *new_gradient_pixbuf(gint width, gint height);
+static gdouble get_cover_scale(GdkPixbuf *source, gint width, gint height);
+static gdouble time_cairo(GdkPixbuf *source, gint width, gint height);
+static gdouble time_kernels(GdkPixbuf *source, gint width, gint height,
+                            ImageKernels kernels, guint thread_count);
+static void report(const gchar *name, gdouble *milliseconds, guint iterations);
+static gint compare_doubles(gconstpointer a, gconstpointer b);
+
+
+int main(int argc, char **argv)
+{
+    GdkPixbuf *source;
+    if (argc > 1) {
+        GError *load_error = NULL;
+        source = gdk_pixbuf_new_from_file(argv[1], &load_error);
+        if (source == NULL) {
+            fprintf(stderr, "Could not load %s: %s\n", argv[1], load_error->message);
+            g_error_free(load_error);
+            return EXIT_FAILURE;
+        }
+    } else {
+        source = new_gradient_pixbuf(DEFAULT_SOURCE_WIDTH, DEFAULT_SOURCE_HEIGHT);
+    }
+    gint width = argc > 3 ? atoi(argv[2]) : DEFAULT_TARGET_WIDTH;
+    gint height = argc > 3 ? atoi(argv[3]) : DEFAULT_TARGET_HEIGHT;
+    guint iterations = argc > 4 ? (guint) atoi(argv[4]) : DEFAULT_ITERATIONS;
+    if (width <= 0 || height <= 0 || iterations == 0) {
+        fprintf(stderr, "Usage: %s [IMAGE [WIDTH HEIGHT [ITERATIONS]]]\n", argv[0]);
+        g_object_unref(source);
+        return EXIT_FAILURE;
+    }
+
+    printf("Scaling %dx%d %s to %dx%d, %u iterations, %u processors\n\n",
+           gdk_pixbuf_get_width(source), gdk_pixbuf_get_height(source),
+           gdk_pixbuf_get_has_alpha(source) ? "RGBA" : "RGB",
+           width, height, iterations, g_get_num_processors());
+    printf("%-16s %10s %10s\n", "path", "best ms", "median ms");
+
+    gdouble *milliseconds = g_new(gdouble, iterations);
+    for (guint i = 0; i < iterations; i++) {
+        milliseconds[i] = time_cairo(source, width, height);
+    }
+    report("cairo", milliseconds, iterations);
+
+    for (gint k = 0; k < IMAGE_KERNELS_COUNT; k++) {
+        if (!image_kernels_supported((ImageKernels) k)) {
+            continue;
+        }
+        // A thread count of 0 uses every processor
+        const guint thread_counts[] = { 1, 0 };
+        for (gsize t = 0; t < G_N_ELEMENTS(thread_counts); t++) {
+            guint thread_count = thread_counts[t];
+            if (thread_count == 0 && g_get_num_processors() == 1) {
+                break;
+            }
+            for (guint i = 0; i < iterations; i++) {
+                milliseconds[i] = time_kernels(source, width, height,
+                                               (ImageKernels) k, thread_count);
+            }
+            gchar *name = g_strdup_printf(
+                "%s%s", image_kernels_name((ImageKernels) k),
+                thread_count == 1 ? "" : " threaded");
+            report(name, milliseconds, iterations);
+            g_free(name);
+        }
+    }
+
+    g_free(milliseconds);
+    g_object_unref(source);
+    return EXIT_SUCCESS;
+}
+
+
+/* Make an opaque image with a gradient in every channel */
+static GdkPixbuf *new_gradient_pixbuf(gint width, gint height)
+{
+    GdkPixbuf *pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+    guint8 *pixels = gdk_pixbuf_get_pixels(pixbuf);
+    gint rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+    for (gint y = 0; y < height; y++) {
+        guint8 *row = &pixels[(gsize) y * (gsize) rowstride];
+        for (gint x = 0; x < width; x++) {
+            row[x * 3] = (guint8) (x * 255 / width);
+            row[x * 3 + 1] = (guint8) (y * 255 / height);
+            row[x * 3 + 2] = (guint8) ((x + y) & 0xff);
+        }
+    }
+    return pixbuf;
+}
+
+
+/* Get the scale that makes the image cover the target */
+static gdouble get_cover_scale(GdkPixbuf *source, gint width, gint height)
+{
+    return MAX((gdouble) width / gdk_pixbuf_get_width(source),
+               (gdouble) height / gdk_pixbuf_get_height(source));
+}
+
+
+/* Time scaling through cairo, returning milliseconds */
+static gdouble time_cairo(GdkPixbuf *source, gint width, gint height)
+{
+    gdouble scale = get_cover_scale(source, width, height);
+    gint64 start = g_get_monotonic_time();
+
+    cairo_surface_t *surface =
+        cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+    cairo_t *cr = cairo_create(surface);
+    cairo_translate(cr, (width - gdk_pixbuf_get_width(source) * scale) / 2,
+                    (height - gdk_pixbuf_get_height(source) * scale) / 2);
+    cairo_scale(cr, scale, scale);
+    gdk_cairo_set_source_pixbuf(cr, source, 0, 0);
+    cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_GOOD);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    cairo_surface_flush(surface);
+
+    gint64 end = g_get_monotonic_time();
+    cairo_surface_destroy(surface);
+    return (gdouble) (end - start) / 1000;
+}
+
+
+/* Time scaling with the greeter's kernels, returning milliseconds */
+static gdouble time_kernels(GdkPixbuf *source, gint width, gint height,
+                            ImageKernels kernels, guint thread_count)
+{
+    gdouble scale = get_cover_scale(source, width, height);
+    ImageSource image = {
+        .pixels = gdk_pixbuf_read_pixels(source),
+        .width = gdk_pixbuf_get_width(source),
+        .height = gdk_pixbuf_get_height(source),
+        .rowstride = gdk_pixbuf_get_rowstride(source),
+        .channels = gdk_pixbuf_get_n_channels(source),
+    };
+    ImagePlacement placement = {
+        .scale = scale,
+        .x = (width - image.width * scale) / 2,
+        .y = (height - image.height * scale) / 2,
+    };
+    gint64 start = g_get_monotonic_time();
+
+    cairo_surface_t *surface =
+        cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+    cairo_surface_flush(surface);
+    image_scale_to_argb(&image, &placement, cairo_image_surface_get_data(surface),
+                        width, height, cairo_image_surface_get_stride(surface),
+                        kernels, thread_count);
+    cairo_surface_mark_dirty(surface);
+
+    gint64 end = g_get_monotonic_time();
+    cairo_surface_destroy(surface);
+    return (gdouble) (end - start) / 1000;
+}
+
+
+/* Print the best & median of a path's timings */
+static void report(const gchar *name, gdouble *milliseconds, guint iterations)
+{
+    qsort(milliseconds, iterations, sizeof(gdouble), compare_doubles);
+    printf("%-16s %10.1f %10.1f\n", name, milliseconds[0],
+           milliseconds[iterations / 2]);
+}
+
+
+/* Order timings for qsort */
+static gint compare_doubles(gconstpointer a, gconstpointer b)
+{
+    gdouble first = *(const gdouble *) a;
+    gdouble second = *(const gdouble *) b;
+    return (first > second) - (first < second);
+}
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""End-to-end login latency benchmark for lightdm-mini-greeter.
+
+Runs the greeter under Xvfb against a stand-in LightDM daemon that speaks the
+greeter protocol over the `LIGHTDM_TO_SERVER_FD`/`LIGHTDM_FROM_SERVER_FD`
+pipes, types a password with xdotool & reports:
+
+* time-to-first-frame, from the greeter's startup timing report
+* password submit to `authentication-complete`
+* `authentication-complete` to the `start_session` request
+
+over many iterations. Requires `Xvfb` & `xdotool`.
+"""
+import argparse
+import json
+import os
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+from mock_daemon import MockDaemon, start_greeter, start_xvfb, stop_greeter, wait_for
+
+
+def write_config(directory, user, timing_file):
+    path = os.path.join(directory, "lightdm-mini-greeter.conf")
+    with open(path, "w") as config:
+        config.write("[greeter]\nuser = %s\nstartup-timing-file = %s\n" % (user, timing_file))
+    return path
+
+
+def run_iteration(args, display, workdir):
+    timing_file = os.path.join(workdir, "timing.json")
+    if os.path.exists(timing_file):
+        os.unlink(timing_file)
+    config_file = args.config or write_config(workdir, args.user, timing_file)
+
+    greeter, daemon, env = start_greeter(
+        args.greeter, display, workdir, config_file,
+        {"LIGHTDM_MINI_GREETER_TIMING_FILE": timing_file},
+        default_session=args.session, auth_delay=args.auth_delay / 1000.0,
+        script=args.script)
+    try:
+        if not wait_for(lambda: os.path.exists(timing_file), args.timeout):
+            raise RuntimeError("greeter never drew its first frame (see %s/greeter.log)" % workdir)
+        with open(timing_file) as report:
+            phases = {phase["name"]: phase for phase in json.load(report)["phases"]}
+        if not wait_for(lambda: "prompt" in daemon.events, args.timeout):
+            raise RuntimeError("greeter never started authenticating")
+
+        subprocess.run(["xdotool", "type", "--delay", "0", args.password],
+                       env=env, check=True)
+        submitted = time.monotonic()
+        subprocess.run(["xdotool", "key", "Return"], env=env, check=True)
+        if not daemon.session_started.wait(args.timeout):
+            raise RuntimeError("greeter never requested a session start")
+    finally:
+        stop_greeter(greeter, daemon)
+
+    events = daemon.events
+    return {
+        "first_frame": phases["first_frame"]["end"] / 1e3,
+        "submit_to_authentication_complete":
+            (events["end_authentication"] - submitted) * 1e3,
+        "authentication_complete_to_start_session":
+            (events["start_session"] - events["end_authentication"]) * 1e3,
+        "submit_to_start_session": (events["start_session"] - submitted) * 1e3,
+    }
+
+
+def summarize(name, samples):
+    samples = sorted(samples)
+    p95 = samples[min(len(samples) - 1, int(round(0.95 * (len(samples) - 1))))]
+    return "%-42s %9.2f %9.2f %9.2f %9.2f %9.2f" % (
+        name, samples[0], statistics.median(samples), statistics.mean(samples),
+        p95, samples[-1])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--greeter", default="./lightdm-mini-greeter",
+                        help="path to the greeter executable")
+    parser.add_argument("--iterations", type=int, default=20)
+    parser.add_argument("--warmup", type=int, default=2,
+                        help="iterations to run before measuring")
+    parser.add_argument("--user", default=os.environ.get("USER", "nobody"))
+    parser.add_argument("--password", default="hunter2")
+    parser.add_argument("--session", default=None,
+                        help="default-session hint sent by the daemon")
+    parser.add_argument("--config", default=None,
+                        help="greeter config to use instead of a generated one")
+    parser.add_argument("--auth-delay", type=float, default=0.0,
+                        help="simulated PAM delay in milliseconds")
+    parser.add_argument("--script", type=argparse.FileType("r"), default=None,
+                        help="JSON list of conversation steps for the daemon "
+                             "to play, e.g. [[\"prompt\", 1, \"Password: \"]]")
+    parser.add_argument("--resolution", default="1920x1080x24")
+    parser.add_argument("--timeout", type=float, default=30.0)
+    parser.add_argument("--json", action="store_true",
+                        help="print every sample as JSON instead of a summary")
+    args = parser.parse_args()
+    if args.script is not None:
+        args.script = [tuple(step) for step in json.load(args.script)]
+
+    for tool in ("Xvfb", "xdotool"):
+        if shutil.which(tool) is None:
+            sys.exit("%s is required to run the benchmark" % tool)
+
+    xvfb, display = start_xvfb(args.resolution)
+    results = []
+    try:
+        with tempfile.TemporaryDirectory(prefix="mini-greeter-bench-") as workdir:
+            for iteration in range(args.warmup + args.iterations):
+                result = run_iteration(args, display, workdir)
+                if iteration >= args.warmup:
+                    results.append(result)
+    finally:
+        xvfb.terminate()
+        xvfb.wait()
+
+    metrics = ["first_frame", "submit_to_authentication_complete",
+               "authentication_complete_to_start_session", "submit_to_start_session"]
+    if args.json:
+        print(json.dumps([{m: r[m] for m in metrics} for r in results], indent=2))
+        return
+    print("%d iterations, all times in ms" % len(results))
+    print("%-42s %9s %9s %9s %9s %9s" % ("metric", "min", "median", "mean", "p95", "max"))
+    for metric in metrics:
+        print(summarize(metric, [r[metric] for r in results]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,308 @@
+"""A stand-in LightDM daemon for driving lightdm-mini-greeter.
+
+Speaks the greeter protocol over the `LIGHTDM_TO_SERVER_FD`/
+`LIGHTDM_FROM_SERVER_FD` pipes & plays scripted PAM conversations, so the
+greeter's authentication handling can be benchmarked & checked without
+LightDM or PAM. Shared by `bench/login-latency.py` & the conversation checks.
+"""
+import os
+import signal
+import struct
+import subprocess
+import sys
+import threading
+import time
+
+
+# Greeter -> Daemon messages
+GREETER_MESSAGE_CONNECT = 0
+GREETER_MESSAGE_AUTHENTICATE = 1
+GREETER_MESSAGE_AUTHENTICATE_AS_GUEST = 2
+GREETER_MESSAGE_CONTINUE_AUTHENTICATION = 3
+GREETER_MESSAGE_START_SESSION = 4
+GREETER_MESSAGE_CANCEL_AUTHENTICATION = 5
+GREETER_MESSAGE_SET_LANGUAGE = 6
+GREETER_MESSAGE_AUTHENTICATE_REMOTE = 7
+GREETER_MESSAGE_ENSURE_SHARED_DIR = 8
+
+# Daemon -> Greeter messages
+SERVER_MESSAGE_CONNECTED = 0
+SERVER_MESSAGE_PROMPT_AUTHENTICATION = 1
+SERVER_MESSAGE_END_AUTHENTICATION = 2
+SERVER_MESSAGE_SESSION_RESULT = 3
+SERVER_MESSAGE_SHARED_DIR_RESULT = 4
+
+# PAM message styles & return codes
+PAM_PROMPT_ECHO_OFF = 1
+PAM_PROMPT_ECHO_ON = 2
+PAM_ERROR_MSG = 3
+PAM_TEXT_INFO = 4
+PAM_SUCCESS = 0
+PAM_AUTH_ERR = 7
+
+DAEMON_VERSION = "1.30.0"
+
+
+class ProtocolError(Exception):
+    pass
+
+
+class Message:
+    """A greeter protocol message: big-endian int/length-prefixed strings."""
+
+    def __init__(self, payload=b""):
+        self.payload = payload
+        self.offset = 0
+
+    def read_int(self):
+        if self.offset + 4 > len(self.payload):
+            raise ProtocolError("truncated int")
+        value, = struct.unpack_from(">I", self.payload, self.offset)
+        self.offset += 4
+        return value
+
+    def read_string(self):
+        length = self.read_int()
+        if self.offset + length > len(self.payload):
+            raise ProtocolError("truncated string")
+        value = self.payload[self.offset:self.offset + length]
+        self.offset += length
+        return value.decode("utf-8", "replace")
+
+    @staticmethod
+    def encode(message_id, *fields):
+        payload = b""
+        for field in fields:
+            if isinstance(field, int):
+                payload += struct.pack(">I", field)
+            else:
+                data = field.encode("utf-8")
+                payload += struct.pack(">I", len(data)) + data
+        return struct.pack(">II", message_id, len(payload)) + payload
+
+
+class MockDaemon(threading.Thread):
+    """Answers a single greeter over a pair of pipes, timestamping each step.
+
+    A `script` is a list of conversation steps sent after every AUTHENTICATE:
+    `("prompt", style, text)` & `("message", style, text)` entries are batched
+    into PROMPT_AUTHENTICATION messages, `("wait", seconds)` pauses before the
+    next batch & `("result", code)` ends the authentication. A conversation
+    with no `result` ends once all prompts have been answered, using the
+    `auth_result` code.
+    """
+
+    def __init__(self, to_greeter, from_greeter, default_session=None,
+                 auth_delay=0.0, auth_result=PAM_SUCCESS, script=None):
+        super().__init__(daemon=True)
+        self.to_greeter = to_greeter
+        self.from_greeter = from_greeter
+        self.default_session = default_session
+        self.auth_delay = auth_delay
+        self.auth_result = auth_result
+        self.script = script or [("prompt", PAM_PROMPT_ECHO_OFF, "Password: ")]
+        self.events = {}
+        self.responses = []
+        self.sessions_started = []
+        self.session_started = threading.Event()
+        self.finished = threading.Event()
+        self.lock = threading.Lock()
+        self.sequence = None
+        self.username = None
+        self.pending_prompts = 0
+        self.prompt_batches = 0
+        self.script_played = False
+        self.log = None
+
+    def mark(self, name):
+        self.events.setdefault(name, time.monotonic())
+
+    def send(self, message_id, *fields):
+        os.write(self.to_greeter, Message.encode(message_id, *fields))
+
+    def read_exact(self, length):
+        data = b""
+        while len(data) < length:
+            chunk = os.read(self.from_greeter, length - len(data))
+            if not chunk:
+                raise EOFError
+            data += chunk
+        return data
+
+    def run(self):
+        try:
+            while True:
+                message_id, length = struct.unpack(">II", self.read_exact(8))
+                self.handle(message_id, Message(self.read_exact(length)))
+        except (EOFError, OSError):
+            pass
+        finally:
+            self.finished.set()
+
+    def handle(self, message_id, message):
+        if message_id == GREETER_MESSAGE_CONNECT:
+            self.mark("connect")
+            message.read_string()  # greeter's liblightdm version
+            hints = ["default-session", self.default_session] if self.default_session else []
+            self.send(SERVER_MESSAGE_CONNECTED, DAEMON_VERSION, *hints)
+        elif message_id == GREETER_MESSAGE_AUTHENTICATE:
+            self.mark("authenticate")
+            with self.lock:
+                self.sequence = message.read_int()
+                self.username = message.read_string()
+                self.pending_prompts = 0
+                self.script_played = False
+            self.run_script(self.sequence)
+        elif message_id == GREETER_MESSAGE_CONTINUE_AUTHENTICATION:
+            self.mark("continue_authentication")
+            count = message.read_int()
+            self.responses.extend(message.read_string() for _ in range(count))
+            with self.lock:
+                self.pending_prompts = max(0, self.pending_prompts - count)
+                finished = (self.pending_prompts == 0 and self.script_played and
+                            not self.script_has_result())
+                sequence = self.sequence
+            if finished:
+                time.sleep(self.auth_delay)
+                self.end_authentication(sequence, self.auth_result)
+        elif message_id == GREETER_MESSAGE_CANCEL_AUTHENTICATION:
+            self.mark("cancel_authentication")
+            with self.lock:
+                sequence, self.sequence = self.sequence, None
+            if sequence is not None:
+                self.send(SERVER_MESSAGE_END_AUTHENTICATION, sequence,
+                          self.username or "", PAM_AUTH_ERR)
+        elif message_id == GREETER_MESSAGE_START_SESSION:
+            self.mark("start_session")
+            self.sessions_started.append(message.read_string())
+            self.send(SERVER_MESSAGE_SESSION_RESULT, 0)
+            self.session_started.set()
+        elif message_id == GREETER_MESSAGE_ENSURE_SHARED_DIR:
+            self.send(SERVER_MESSAGE_SHARED_DIR_RESULT, "")
+        elif message_id in (GREETER_MESSAGE_SET_LANGUAGE,
+                            GREETER_MESSAGE_AUTHENTICATE_AS_GUEST,
+                            GREETER_MESSAGE_AUTHENTICATE_REMOTE):
+            pass
+        else:
+            raise ProtocolError("unknown greeter message %d" % message_id)
+
+    def script_has_result(self):
+        return any(step[0] == "result" for step in self.script)
+
+    def end_authentication(self, sequence, code):
+        with self.lock:
+            if sequence is None or sequence != self.sequence:
+                return
+            self.sequence = None
+        self.mark("end_authentication")
+        self.send(SERVER_MESSAGE_END_AUTHENTICATION, sequence, self.username or "", code)
+
+    def run_script(self, sequence):
+        # Scripts with waits run on their own thread so the daemon keeps
+        # reading responses while e.g. a fingerprint scan is "in progress".
+        thread = threading.Thread(target=self.play_script, args=(sequence,), daemon=True)
+        thread.start()
+
+    def play_script(self, sequence):
+        batch = []
+
+        def flush():
+            if not batch:
+                return
+            fields = [sequence, self.username or "", len(batch)]
+            for style, text in batch:
+                fields += [style, text]
+            with self.lock:
+                if sequence != self.sequence:
+                    return
+                self.pending_prompts += sum(
+                    1 for style, _ in batch if style in (PAM_PROMPT_ECHO_OFF, PAM_PROMPT_ECHO_ON))
+                self.prompt_batches += 1
+            self.mark("prompt")
+            self.send(SERVER_MESSAGE_PROMPT_AUTHENTICATION, *fields)
+            batch.clear()
+
+        for step in self.script:
+            if step[0] in ("prompt", "message"):
+                batch.append((step[1], step[2]))
+            elif step[0] == "wait":
+                flush()
+                time.sleep(step[1])
+            elif step[0] == "result":
+                flush()
+                self.end_authentication(sequence, step[1])
+                return
+        flush()
+        # Prompts answered while the script was still playing end it now
+        with self.lock:
+            if sequence != self.sequence:
+                return
+            self.script_played = True
+            finished = self.pending_prompts == 0
+        if finished:
+            time.sleep(self.auth_delay)
+            self.end_authentication(sequence, self.auth_result)
+
+
+def start_xvfb(resolution):
+    read_fd, write_fd = os.pipe()
+    xvfb = subprocess.Popen(
+        ["Xvfb", "-displayfd", str(write_fd), "-screen", "0", resolution,
+         "-nolisten", "tcp", "-noreset"],
+        pass_fds=(write_fd,), stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    os.close(write_fd)
+    with os.fdopen(read_fd) as display_pipe:
+        display = display_pipe.readline().strip()
+    if not display:
+        xvfb.kill()
+        sys.exit("Xvfb did not report a display number")
+    return xvfb, ":" + display
+
+
+def wait_for(predicate, timeout):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        if predicate():
+            return True
+        time.sleep(0.001)
+    return False
+
+
+def start_greeter(greeter_path, display, workdir, config_file, extra_env=None,
+                  **daemon_args):
+    """Start the greeter against a new MockDaemon, logging to the workdir.
+
+    Returns the greeter process, the running daemon & the greeter's
+    environment, for tools like xdotool that need the same display.
+    """
+    to_greeter_read, to_greeter_write = os.pipe()
+    from_greeter_read, from_greeter_write = os.pipe()
+    daemon = MockDaemon(to_greeter_write, from_greeter_read, **daemon_args)
+
+    env = dict(os.environ,
+               DISPLAY=display,
+               LIGHTDM_TO_SERVER_FD=str(from_greeter_write),
+               LIGHTDM_FROM_SERVER_FD=str(to_greeter_read),
+               LIGHTDM_MINI_GREETER_CONFIG=config_file,
+               **(extra_env or {}))
+    daemon.log = open(os.path.join(workdir, "greeter.log"), "ab")
+    greeter = subprocess.Popen([greeter_path], env=env, stdout=daemon.log,
+                               stderr=daemon.log,
+                               pass_fds=(from_greeter_write, to_greeter_read))
+    os.close(from_greeter_write)
+    os.close(to_greeter_read)
+    daemon.start()
+    return greeter, daemon, env
+
+
+def stop_greeter(greeter, daemon):
+    """Stop a greeter started by `start_greeter` & close its daemon's pipes."""
+    greeter.send_signal(signal.SIGTERM)
+    try:
+        greeter.wait(5)
+    except subprocess.TimeoutExpired:
+        greeter.kill()
+        greeter.wait()
+    os.close(daemon.to_greeter)
+    os.close(daemon.from_greeter)
+    daemon.log.close()
@@ -1,19 +1,30 @@
 /* Application Initialization Things */
 #include <stdlib.h>
+#include <sys/mman.h>
 
 #include <gtk/gtk.h>
 #include <lightdm.h>
 
 #include "app.h"
+#include "auth_metrics.h"
 #include "callbacks.h"
+#include "clock.h"
+#include "idle.h"
+#include "memory_report.h"
 #include "config.h"
+#include "timing.h"
 
 
 /* Initialize the Greeter & UI */
 App *initialize_app(int argc, char **argv)
 {
     g_log_set_always_fatal(G_LOG_LEVEL_CRITICAL);
+    timing_phase_begin(TIMING_GTK_INIT);
     gtk_init(&argc, &argv);
+    timing_phase_end(TIMING_GTK_INIT);
+    memory_report_sample("gtk_init");
+    // Grab the keyboard before anything slow, so early keys aren't lost
+    Typeahead *typeahead = initialize_typeahead();
 
     // Allocate & Initialize
     App *app = malloc(sizeof(App));
@@ -21,11 +32,51 @@ App *initialize_app(int argc, char **argv)
         g_error("Could not allocate memory for App");
     }
 
+    app->typeahead = typeahead;
+
+    timing_phase_begin(TIMING_INITIALIZE_CONFIG);
     app->config = initialize_config();
+    timing_phase_end(TIMING_INITIALIZE_CONFIG);
+    typeahead_set_hotkey_mask(app->typeahead, app->config->mod_bit);
+    // The password buffer is always locked, this keeps everything else out
+    // of any swap devices too
+    if (app->config->lock_memory) {
+        mlockall(MCL_CURRENT | MCL_FUTURE);
+    }
+    // The environment variables take precedence over the config file
+    const gchar *timing_report_file = g_getenv("LIGHTDM_MINI_GREETER_TIMING_FILE");
+    timing_set_report_file(timing_report_file != NULL
+                           ? timing_report_file
+                           : app->config->timing_report_file);
+    const gchar *memory_report_file = g_getenv("LIGHTDM_MINI_GREETER_MEMORY_FILE");
+    memory_report_set_file(memory_report_file != NULL
+                           ? memory_report_file
+                           : app->config->memory_report_file);
+    const gchar *auth_metrics_file = g_getenv("LIGHTDM_MINI_GREETER_AUTH_METRICS_FILE");
+    auth_metrics_set_file(auth_metrics_file != NULL
+                          ? auth_metrics_file
+                          : app->config->auth_metrics_file);
+    memory_report_sample("initialize_config");
+
     app->greeter = lightdm_greeter_new();
     app->ui = initialize_ui(app->config);
+    app->session_ring = NULL;
+    app->session_watch = NULL;
+    app->user_ring = NULL;
+    app->user_ring_idle_id = 0;
+    app->avatar_cancellable = NULL;
+    app->daemon_connected = FALSE;
+    app->prompt_pending = FALSE;
+    app->password_queued = FALSE;
+    app->prompts_answered = 0;
+    app->session_start_cancellable = NULL;
+    app->session_start_timeout_id = 0;
 
     // Connect Greeter & UI Signals
+    g_signal_connect(app->greeter, "show-prompt",
+                     G_CALLBACK(show_prompt_cb), app);
+    g_signal_connect(app->greeter, "show-message",
+                     G_CALLBACK(show_message_cb), app);
     g_signal_connect(app->greeter, "authentication-complete",
                      G_CALLBACK(authentication_complete_cb), app);
     app->password_callback_id =
@@ -35,17 +86,40 @@ App *initialize_app(int argc, char **argv)
     // instead of the main window, preventing users from entering their password.
     // It's undocument & probably not necessary any more. Investigate & remove.
     for (int m = 0; m < APP_MONITOR_COUNT(app); m++) {
-        g_signal_connect(GTK_WIDGET(APP_BACKGROUND_WINDOWS(app)[m]),
-                         "key-press-event",
+        GtkWindow *background_window = APP_BACKGROUND_WINDOWS(app)[m];
+        g_signal_connect(GTK_WIDGET(background_window), "key-press-event",
                          G_CALLBACK(handle_tab_key), app);
     }
+    // Add & remove background windows as monitors are connected
+    GdkDisplay *display = gdk_display_get_default();
+    app->primary_monitor = gdk_display_get_primary_monitor(display);
+    for (int m = 0; m < gdk_display_get_n_monitors(display); m++) {
+        GdkMonitor *monitor = gdk_display_get_monitor(display, m);
+        if (monitor != NULL) {
+            watch_monitor_changes(app, monitor);
+        }
+    }
+    g_signal_connect(display, "monitor-added",
+                     G_CALLBACK(handle_monitor_added), app);
+    g_signal_connect(display, "monitor-removed",
+                     G_CALLBACK(handle_monitor_removed), app);
+    // Move the background image when another monitor becomes the primary
+    g_signal_connect(gdk_screen_get_default(), "monitors-changed",
+                     G_CALLBACK(handle_monitors_changed), app);
     g_signal_connect(GTK_WIDGET(APP_MAIN_WINDOW(app)), "key-press-event",
                      G_CALLBACK(handle_hotkeys), app);
-    // Update the current time every 15 seconds
+    app->first_frame_callback_id =
+        g_signal_connect_after(GTK_WIDGET(APP_MAIN_WINDOW(app)), "draw",
+                               G_CALLBACK(handle_first_frame), app);
+    // Update the current time whenever it changes
+    app->clock = NULL;
     if (app->config->show_sys_info) {
-        handle_time_update(app);
-        g_timeout_add_seconds(15, G_SOURCE_FUNC(handle_time_update), app);
+        app->clock = initialize_clock(app->config->time_format,
+                                      handle_time_update, app);
     }
+    initialize_idle_timer(app);
+    // Apply changes to the config file without restarting
+    app->config_watch = initialize_config_watch(handle_config_change, app);
 
     return app;
 }
@@ -54,7 +128,35 @@ App *initialize_app(int argc, char **argv)
 /* Free any dynamically allocated memory */
 void destroy_app(App *app)
 {
+    memory_report_write("exit");
+    destroy_config_watch(app->config_watch);
+    destroy_typeahead(app->typeahead);
+    if (app->idle_timeout_id != 0) {
+        g_source_remove(app->idle_timeout_id);
+    }
+    if (app->clock != NULL) {
+        destroy_clock(app->clock);
+    }
+    if (app->session_watch != NULL) {
+        destroy_session_watch(app->session_watch);
+    }
+    if (app->session_ring != NULL) {
+        destroy_focus_ring(app->session_ring);
+    }
+    cancel_session_start(app);
+    if (app->user_ring_idle_id != 0) {
+        g_source_remove(app->user_ring_idle_id);
+    }
+    // Avatars that finish loading later must not be handed to freed users
+    if (app->avatar_cancellable != NULL) {
+        g_cancellable_cancel(app->avatar_cancellable);
+        g_object_unref(app->avatar_cancellable);
+    }
+    if (app->user_ring != NULL) {
+        destroy_focus_ring(app->user_ring);
+    }
+    g_object_unref(app->greeter);
+    destroy_ui(app->ui);
     destroy_config(app->config);
-    free(app->ui);
     free(app);
 }
@@ -3,8 +3,12 @@
 
 #include <lightdm.h>
 
+#include "clock.h"
 #include "config.h"
+#include "config_watch.h"
 #include "focus_ring.h"
+#include "sessions.h"
+#include "typeahead.h"
 #include "ui.h"
 
 
@@ -13,9 +17,39 @@ typedef struct App_ {
     LightDMGreeter *greeter;
     UI *ui;
     FocusRing *session_ring;
+    SessionWatch *session_watch;
+    // NULL unless the user list is shown & LightDM has been connected to
+    FocusRing *user_ring;
+    // Builds the user ring once the first prompt has been drawn
+    guint user_ring_idle_id;
+    GCancellable *avatar_cancellable;
+    Clock *clock;
+    ConfigWatch *config_watch;
+    // Keys typed before the first frame, replayed into the password input
+    Typeahead *typeahead;
+    // The primary monitor when the background images were last placed
+    GdkMonitor *primary_monitor;
+
+    /* Idle Power Mode */
+    guint idle_timeout_id;
+    gboolean is_idle;
+
+    /* Authentication State */
+    gboolean daemon_connected;
+    // LightDM has prompted for a response that we haven't sent yet
+    gboolean prompt_pending;
+    // A password was entered before LightDM was ready for it
+    gboolean password_queued;
+    // The number of prompts answered since authentication began
+    guint prompts_answered;
+    // The pending session start request, NULL when there isn't one
+    GCancellable *session_start_cancellable;
+    guint session_start_timeout_id;
 
     // Signal Handler ID for the `handle_password` callback
     gulong password_callback_id;
+    // Signal Handler ID for the `handle_first_frame` callback
+    gulong first_frame_callback_id;
 } App;
 
 
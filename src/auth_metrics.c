@@ -0,0 +1,208 @@
+/* Authentication Latency Metrics
+ *
+ * Each part of a login attempt is timed with the monotonic clock & counted
+ * in a fixed-bucket histogram per outcome. After every timed step, the
+ * histograms are written in the Prometheus text format, so node_exporter's
+ * textfile collector can pick them up. Timing is always on since it only
+ * costs a clock read, but nothing is written unless a metrics file is set.
+ */
+#include <glib.h>
+
+#include "auth_metrics.h"
+
+
+// Bucket upper bounds in microseconds, with the `le` label for each
+#define AUTH_METRIC_BUCKET_COUNT 12
+static const gint64 bucket_bounds[AUTH_METRIC_BUCKET_COUNT] = {
+    10000, 25000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000, 10000000, 30000000, G_MAXINT64,
+};
+static const gchar *const bucket_labels[AUTH_METRIC_BUCKET_COUNT] = {
+    "0.01", "0.025", "0.05", "0.1", "0.25", "0.5",
+    "1", "2.5", "5", "10", "30", "+Inf",
+};
+
+typedef enum {
+    AUTH_OUTCOME_SUCCESS,
+    AUTH_OUTCOME_FAILURE,
+    AUTH_OUTCOME_COUNT
+} AuthOutcome;
+
+static const gchar *const outcome_labels[AUTH_OUTCOME_COUNT] = {
+    [AUTH_OUTCOME_SUCCESS] = "success",
+    [AUTH_OUTCOME_FAILURE] = "failure",
+};
+
+// Cumulative counts, like the exported buckets
+typedef struct Histogram_ {
+    guint64 buckets[AUTH_METRIC_BUCKET_COUNT];
+    gint64  sum;
+    guint64 count;
+} Histogram;
+
+typedef struct MetricInfo_ {
+    const gchar *name;
+    const gchar *help;
+} MetricInfo;
+
+static const MetricInfo metric_info[AUTH_METRIC_COUNT] = {
+    [AUTH_METRIC_PROMPT] = {
+        "lightdm_mini_greeter_auth_prompt_seconds",
+        "Time from starting authentication to LightDM's first prompt.",
+    },
+    [AUTH_METRIC_RESPONSE] = {
+        "lightdm_mini_greeter_auth_response_seconds",
+        "Time from sending the password to the authentication result, "
+        "excluding time spent answering later prompts.",
+    },
+    [AUTH_METRIC_SESSION_START] = {
+        "lightdm_mini_greeter_session_start_seconds",
+        "Time from requesting the session to LightDM's reply.",
+    },
+};
+
+static Histogram histograms[AUTH_METRIC_COUNT][AUTH_OUTCOME_COUNT];
+// When each metric's current step began or resumed, or -1 if none is running
+static gint64 step_begin[AUTH_METRIC_COUNT] = { -1, -1, -1 };
+// The time counted before a step was paused, or -1 if no step was started
+static gint64 step_elapsed[AUTH_METRIC_COUNT] = { -1, -1, -1 };
+static gchar *metrics_path = NULL;
+
+static void write_auth_metrics(void);
+static void append_seconds(GString *text, gint64 microseconds);
+
+
+/* Set the path the metrics are written to. The file name must end in
+ * `.prom` for node_exporter to collect it.
+ *
+ * A NULL or empty path disables writing.
+ */
+void auth_metrics_set_file(const gchar *metrics_file)
+{
+    g_free(metrics_path);
+    if (metrics_file == NULL || metrics_file[0] == '\0') {
+        metrics_path = NULL;
+    } else {
+        metrics_path = g_strdup(metrics_file);
+    }
+}
+
+
+/* Start timing a step, replacing any step that didn't end */
+void auth_metric_begin(AuthMetric metric)
+{
+    step_elapsed[metric] = 0;
+    step_begin[metric] = g_get_monotonic_time();
+}
+
+
+/* Record how long a step took & write the metrics.
+ *
+ * Does nothing if the step wasn't started, or has already ended.
+ */
+void auth_metric_end(AuthMetric metric, gboolean success)
+{
+    if (step_elapsed[metric] < 0) {
+        return;
+    }
+    auth_metric_pause(metric);
+    const gint64 duration = step_elapsed[metric];
+    step_elapsed[metric] = -1;
+
+    Histogram *histogram =
+        &histograms[metric][success ? AUTH_OUTCOME_SUCCESS : AUTH_OUTCOME_FAILURE];
+    for (int b = 0; b < AUTH_METRIC_BUCKET_COUNT; b++) {
+        if (duration <= bucket_bounds[b]) {
+            histogram->buckets[b]++;
+        }
+    }
+    histogram->sum += duration;
+    histogram->count++;
+
+    write_auth_metrics();
+}
+
+
+/* Stop timing a step without recording it, e.g. when it was abandoned */
+void auth_metric_cancel(AuthMetric metric)
+{
+    step_begin[metric] = -1;
+    step_elapsed[metric] = -1;
+}
+
+
+/* Stop the clock of a running step without ending it, e.g. while waiting for
+ * the user to answer another prompt.
+ */
+void auth_metric_pause(AuthMetric metric)
+{
+    if (step_begin[metric] < 0) {
+        return;
+    }
+    step_elapsed[metric] += g_get_monotonic_time() - step_begin[metric];
+    step_begin[metric] = -1;
+}
+
+
+/* Restart the clock of a paused step, adding to the time it already took.
+ *
+ * Starts a new step if none was started.
+ */
+void auth_metric_resume(AuthMetric metric)
+{
+    if (step_elapsed[metric] < 0) {
+        auth_metric_begin(metric);
+    } else if (step_begin[metric] < 0) {
+        step_begin[metric] = g_get_monotonic_time();
+    }
+}
+
+
+/* Write every histogram in the Prometheus text exposition format.
+ *
+ * The file is replaced atomically, so a scrape never sees a partial file.
+ */
+static void write_auth_metrics(void)
+{
+    if (metrics_path == NULL) {
+        return;
+    }
+
+    GString *text = g_string_new(NULL);
+    for (int m = 0; m < AUTH_METRIC_COUNT; m++) {
+        const gchar *name = metric_info[m].name;
+        g_string_append_printf(text, "# HELP %s %s\n", name, metric_info[m].help);
+        g_string_append_printf(text, "# TYPE %s histogram\n", name);
+        for (int o = 0; o < AUTH_OUTCOME_COUNT; o++) {
+            const Histogram *histogram = &histograms[m][o];
+            for (int b = 0; b < AUTH_METRIC_BUCKET_COUNT; b++) {
+                g_string_append_printf(
+                    text, "%s_bucket{result=\"%s\",le=\"%s\"} %" G_GUINT64_FORMAT "\n",
+                    name, outcome_labels[o], bucket_labels[b], histogram->buckets[b]);
+            }
+            g_string_append_printf(text, "%s_sum{result=\"%s\"} ",
+                                   name, outcome_labels[o]);
+            append_seconds(text, histogram->sum);
+            g_string_append_printf(text, "\n%s_count{result=\"%s\"} %" G_GUINT64_FORMAT "\n",
+                                   name, outcome_labels[o], histogram->count);
+        }
+    }
+
+    GError *write_error = NULL;
+    if (!g_file_set_contents(metrics_path, text->str, (gssize) text->len, &write_error)) {
+        g_warning("Could not write authentication metrics to %s: %s",
+                  metrics_path, write_error->message);
+        g_error_free(write_error);
+    }
+
+    g_string_free(text, TRUE);
+}
+
+
+/* Append a duration in seconds, always with a `.` as the decimal point */
+static void append_seconds(GString *text, gint64 microseconds)
+{
+    g_string_append_printf(text, "%" G_GINT64_FORMAT ".%06" G_GINT64_FORMAT,
+                           microseconds / G_USEC_PER_SEC,
+                           microseconds % G_USEC_PER_SEC);
+}
@@ -0,0 +1,27 @@
+#ifndef AUTH_METRICS_H
+#define AUTH_METRICS_H
+
+#include <glib.h>
+
+
+// The parts of a login attempt that are timed
+typedef enum {
+    // From starting authentication to LightDM's first prompt
+    AUTH_METRIC_PROMPT,
+    // From sending the first response to the authentication result, without
+    // the time spent waiting for the user to answer any later prompts
+    AUTH_METRIC_RESPONSE,
+    // From asking LightDM to start the session to its reply
+    AUTH_METRIC_SESSION_START,
+    AUTH_METRIC_COUNT
+} AuthMetric;
+
+
+void auth_metrics_set_file(const gchar *metrics_file);
+void auth_metric_begin(AuthMetric metric);
+void auth_metric_end(AuthMetric metric, gboolean success);
+void auth_metric_cancel(AuthMetric metric);
+void auth_metric_pause(AuthMetric metric);
+void auth_metric_resume(AuthMetric metric);
+
+#endif
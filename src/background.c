@@ -0,0 +1,601 @@
+/* Pre-scaled Background Images
+ *
+ * Decoding & scaling a large wallpaper is the most expensive part of drawing
+ * the first frame, so the image is scaled to each monitor's size once & cached
+ * on disk as raw, premultiplied cairo ARGB32 data. Later starts mmap the cache
+ * file straight into a cairo surface.
+ *
+ * The `background-blur` & `background-dim` effects are applied to the scaled
+ * image before it's cached, so they cost nothing on later starts.
+ *
+ * Cache files are named by the image's path & the monitor's geometry. The
+ * image's mtime & size, the `background-image-size` & the effects are checked
+ * against the file's header, so any change to those rewrites the file in
+ * place. Writing a file removes the files of other images & all but the most
+ * recently written sizes of this one, so the cache can't grow without limit.
+ *
+ * Within a single greeter, the source image is decoded at most once & every
+ * monitor with the same size shares one scaled surface.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cairo.h>
+#include <gdk/gdk.h>
+#include <glib.h>
+
+#include "background.h"
+#include "image_scale.h"
+#include "utils.h"
+
+
+#define BACKGROUND_CACHE_MAGIC       0x4742474dU  // "MGBG"
+#define BACKGROUND_CACHE_VERSION     3U
+// Keep the pixel data page-aligned so the mapping can be used as-is
+#define BACKGROUND_CACHE_DATA_OFFSET 4096U
+// The monitor sizes kept in the cache for an image, e.g. docked & undocked
+#define BACKGROUND_CACHE_MAX_SIZES   8
+
+// The `background-image-size` values we can scale ourselves
+typedef enum {
+    BACKGROUND_SIZE_AUTO,
+    BACKGROUND_SIZE_COVER,
+    BACKGROUND_SIZE_CONTAIN,
+    BACKGROUND_SIZE_UNSUPPORTED
+} BackgroundSize;
+
+// Written at the start of every cache file
+typedef struct BackgroundCacheHeader_ {
+    guint32 magic;
+    guint32 version;
+    gint64  source_mtime;
+    gint64  source_size;
+    gint32  width;
+    gint32  height;
+    gint32  stride;
+    gint32  scale_factor;
+    guint32 size_mode;
+    guint32 data_offset;
+    /* The blur radius in device pixels & the brightness left after dimming */
+    guint32 blur_radius;
+    guint32 brightness;
+} BackgroundCacheHeader;
+// Headers are compared with memcmp, so they must not contain any padding
+_Static_assert(sizeof(BackgroundCacheHeader) == 56, "BackgroundCacheHeader is padded");
+
+// A cache file that may be pruned, & when it was written
+typedef struct CacheFile_ {
+    gchar  *path;
+    gint64  mtime;
+} CacheFile;
+
+static const cairo_user_data_key_t mapping_key;
+
+static BackgroundSize parse_background_size(const gchar *size);
+static gchar *get_background_cache_path(const gchar *image_path,
+                                        const BackgroundCacheHeader *header);
+static cairo_surface_t *map_cached_background(const gchar *cache_path,
+                                              const BackgroundCacheHeader *expected);
+static void unmap_cached_background(void *mapping);
+static GdkPixbuf *get_source_image(BackgroundCache *cache);
+static cairo_surface_t *render_background(GdkPixbuf *source,
+                                          BackgroundSize size_mode,
+                                          gint width, gint height,
+                                          gint scale_factor);
+static void apply_background_effects(cairo_surface_t *surface,
+                                     const BackgroundCacheHeader *header);
+static void write_cached_background(const gchar *cache_path,
+                                    const BackgroundCacheHeader *header,
+                                    cairo_surface_t *surface);
+static gboolean write_all(int fd, const void *buffer, gsize length);
+static void prune_background_cache(const gchar *cache_path);
+static gint compare_cache_files(gconstpointer a, gconstpointer b);
+
+
+/* Create a cache for the configured background image.
+ *
+ * Nothing is decoded or scaled until an image is requested.
+ */
+BackgroundCache *initialize_background_cache(const Config *config)
+{
+    BackgroundCache *cache = malloc(sizeof(BackgroundCache));
+    if (cache == NULL) {
+        g_error("Could not allocate memory for BackgroundCache");
+    }
+    cache->image_path = NULL;
+    cache->size_mode = (guint) parse_background_size(config->background_image_size);
+    cache->source_mtime = 0;
+    cache->source_size = 0;
+    cache->blur = config->background_blur;
+    cache->dim = config->background_dim;
+    cache->source = NULL;
+    cache->surfaces = g_hash_table_new_full(
+        g_str_hash, g_str_equal, g_free, (GDestroyNotify) cairo_surface_destroy);
+
+    if (cache->size_mode == BACKGROUND_SIZE_UNSUPPORTED) {
+        if (cache->blur > 0 || cache->dim > 0) {
+            g_message("background-blur & background-dim need a background-image-size "
+                      "of auto, cover or contain");
+        }
+        return cache;
+    }
+    gchar *image_path = get_background_image_path(config);
+    if (image_path == NULL) {
+        return cache;
+    }
+    struct stat image_stat;
+    if (stat(image_path, &image_stat) != 0) {
+        g_warning("Could not read background image %s: %s",
+                  image_path, g_strerror(errno));
+        g_free(image_path);
+        return cache;
+    }
+    cache->image_path = image_path;
+    cache->source_mtime = (gint64) image_stat.st_mtim.tv_sec * G_USEC_PER_SEC
+                          + image_stat.st_mtim.tv_nsec / 1000;
+    cache->source_size = (gint64) image_stat.st_size;
+
+    return cache;
+}
+
+
+/* Free the cache, any surfaces still in use by windows stay valid */
+void destroy_background_cache(BackgroundCache *cache)
+{
+    background_cache_release_source(cache);
+    g_hash_table_destroy(cache->surfaces);
+    g_free(cache->image_path);
+    free(cache);
+}
+
+
+/* Get the background image for a monitor, scaled to the monitor's size.
+ *
+ * The image is centered on a transparent surface the size of the monitor, so
+ * the window's CSS background color shows around it. Monitors with the same
+ * size share a single surface & the source image is decoded at most once.
+ *
+ * Returns a new reference to the surface, or NULL if no image is configured,
+ * the image cannot be loaded, or the `background-image-size` is not one we
+ * can scale ourselves - in which case the caller should fall back to the CSS
+ * `with-image` class.
+ */
+cairo_surface_t *background_cache_get_image(BackgroundCache *cache,
+                                            const GdkRectangle *geometry,
+                                            gint scale_factor)
+{
+    if (cache->image_path == NULL) {
+        return NULL;
+    }
+
+    gchar *size_key = g_strdup_printf(
+        "%dx%d@%d", geometry->width, geometry->height, scale_factor);
+    cairo_surface_t *surface = g_hash_table_lookup(cache->surfaces, size_key);
+    if (surface != NULL) {
+        g_free(size_key);
+        return cairo_surface_reference(surface);
+    }
+
+    BackgroundCacheHeader header = {
+        .magic = BACKGROUND_CACHE_MAGIC,
+        .version = BACKGROUND_CACHE_VERSION,
+        .source_mtime = cache->source_mtime,
+        .source_size = cache->source_size,
+        .width = geometry->width * scale_factor,
+        .height = geometry->height * scale_factor,
+        .stride = cairo_format_stride_for_width(
+            CAIRO_FORMAT_ARGB32, geometry->width * scale_factor),
+        .scale_factor = scale_factor,
+        .size_mode = cache->size_mode,
+        .data_offset = BACKGROUND_CACHE_DATA_OFFSET,
+        .blur_radius = MIN(MIN(cache->blur, IMAGE_BLUR_MAX_RADIUS) * (guint) scale_factor,
+                           IMAGE_BLUR_MAX_RADIUS),
+        // Rounded to the nearest channel value
+        .brightness = ((100 - cache->dim) * 255 + 50) / 100,
+    };
+
+    gchar *cache_path = get_background_cache_path(cache->image_path, &header);
+    surface = map_cached_background(cache_path, &header);
+    if (surface == NULL) {
+        GdkPixbuf *source = get_source_image(cache);
+        if (source != NULL) {
+            g_message("Scaling background image %s to %dx%d with %s kernels",
+                      cache->image_path, header.width, header.height,
+                      image_kernels_name(image_kernels_detect()));
+            surface = render_background(source, (BackgroundSize) cache->size_mode,
+                                        header.width, header.height, scale_factor);
+            if (surface != NULL) {
+                apply_background_effects(surface, &header);
+                write_cached_background(cache_path, &header, surface);
+            }
+        }
+    }
+    g_free(cache_path);
+
+    if (surface == NULL) {
+        g_free(size_key);
+        return NULL;
+    }
+    cairo_surface_set_device_scale(surface, scale_factor, scale_factor);
+    g_hash_table_insert(cache->surfaces, size_key, surface);
+    return cairo_surface_reference(surface);
+}
+
+
+/* Free the decoded source image.
+ *
+ * Call this once every monitor has its background, so the full-size image
+ * isn't kept (& locked) in memory. It is decoded again if a new monitor size
+ * needs it later.
+ */
+void background_cache_release_source(BackgroundCache *cache)
+{
+    if (cache->source != NULL) {
+        g_object_unref(cache->source);
+        cache->source = NULL;
+    }
+}
+
+
+/* Decode the source image, if it hasn't been already */
+static GdkPixbuf *get_source_image(BackgroundCache *cache)
+{
+    if (cache->source == NULL) {
+        GError *load_error = NULL;
+        cache->source = gdk_pixbuf_new_from_file(cache->image_path, &load_error);
+        if (cache->source == NULL) {
+            g_warning("Could not load background image %s: %s",
+                      cache->image_path, load_error->message);
+            g_error_free(load_error);
+            // Don't retry the decode for every monitor
+            g_free(cache->image_path);
+            cache->image_path = NULL;
+        }
+    }
+    return cache->source;
+}
+
+
+/* Get the configured background image's path, without any quotes.
+ *
+ * Returns NULL if no background image is set.
+ */
+gchar *get_background_image_path(const Config *config)
+{
+    if (strcmp(config->background_image, "\"\"") == 0) {
+        return NULL;
+    }
+    gchar *image_path = g_strdup(config->background_image);
+    remove_char(image_path, '"');
+    remove_char(image_path, '\'');
+    g_strstrip(image_path);
+    if (image_path[0] == '\0') {
+        g_free(image_path);
+        return NULL;
+    }
+    return image_path;
+}
+
+
+/* Parse a `background-image-size` value into a size mode */
+static BackgroundSize parse_background_size(const gchar *size)
+{
+    gchar *normalized = g_ascii_strdown(size, -1);
+    g_strstrip(normalized);
+
+    BackgroundSize size_mode;
+    if (strcmp(normalized, "auto") == 0 || strcmp(normalized, "auto auto") == 0) {
+        size_mode = BACKGROUND_SIZE_AUTO;
+    } else if (strcmp(normalized, "cover") == 0) {
+        size_mode = BACKGROUND_SIZE_COVER;
+    } else if (strcmp(normalized, "contain") == 0) {
+        size_mode = BACKGROUND_SIZE_CONTAIN;
+    } else {
+        size_mode = BACKGROUND_SIZE_UNSUPPORTED;
+    }
+
+    g_free(normalized);
+    return size_mode;
+}
+
+
+/* Build the cache file path from a hash of the image's path & the size.
+ *
+ * The other keys live in the header, so changing them replaces this file
+ * instead of adding another.
+ */
+static gchar *get_background_cache_path(const gchar *image_path,
+                                        const BackgroundCacheHeader *header)
+{
+    gchar *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, image_path, -1);
+    gchar *file_name = g_strdup_printf(
+        "%s-%dx%d@%d.argb", hash, header->width, header->height, header->scale_factor);
+    gchar *cache_path = g_build_filename(
+        g_get_user_cache_dir(), "lightdm-mini-greeter", "backgrounds", file_name, NULL);
+
+    g_free(file_name);
+    g_free(hash);
+    return cache_path;
+}
+
+
+/* Map a cache file into a cairo surface, if it exists & matches the header.
+ *
+ * The mapping is released when the surface is destroyed.
+ */
+static cairo_surface_t *map_cached_background(const gchar *cache_path,
+                                              const BackgroundCacheHeader *expected)
+{
+    int fd = open(cache_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat cache_stat;
+    gsize data_length = (gsize) expected->stride * (gsize) expected->height;
+    gsize file_length = expected->data_offset + data_length;
+    if (fstat(fd, &cache_stat) != 0 || (gsize) cache_stat.st_size != file_length) {
+        close(fd);
+        return NULL;
+    }
+
+    void *mapping = mmap(NULL, file_length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+    if (memcmp(mapping, expected, sizeof(BackgroundCacheHeader)) != 0) {
+        munmap(mapping, file_length);
+        return NULL;
+    }
+
+    // cairo only reads from source surfaces, so a read-only mapping is safe
+    cairo_surface_t *surface = cairo_image_surface_create_for_data(
+        (unsigned char *) mapping + expected->data_offset, CAIRO_FORMAT_ARGB32,
+        expected->width, expected->height, expected->stride);
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(surface);
+        munmap(mapping, file_length);
+        return NULL;
+    }
+    // munmap needs the mapping's length as well as its address
+    gsize *mapping_info = g_new(gsize, 2);
+    mapping_info[0] = (gsize) mapping;
+    mapping_info[1] = file_length;
+    cairo_surface_set_user_data(surface, &mapping_key, mapping_info,
+                                unmap_cached_background);
+    return surface;
+}
+
+
+/* Release a cache file mapping when its surface is destroyed */
+static void unmap_cached_background(void *mapping)
+{
+    gsize *mapping_info = mapping;
+    munmap((void *) mapping_info[0], mapping_info[1]);
+    g_free(mapping_info);
+}
+
+
+/* Scale the source image onto a surface the size of the monitor, in device
+ * pixels, positioned like the CSS `background-position: center` would.
+ *
+ * The scaling is split across the CPU's cores, using its vector instructions.
+ * Returns NULL if the surface can't be allocated.
+ */
+static cairo_surface_t *render_background(GdkPixbuf *source,
+                                          BackgroundSize size_mode,
+                                          gint width, gint height,
+                                          gint scale_factor)
+{
+    gdouble image_width = gdk_pixbuf_get_width(source);
+    gdouble image_height = gdk_pixbuf_get_height(source);
+
+    gdouble scale;
+    switch (size_mode) {
+        case BACKGROUND_SIZE_COVER:
+            scale = MAX(width / image_width, height / image_height);
+            break;
+        case BACKGROUND_SIZE_CONTAIN:
+            scale = MIN(width / image_width, height / image_height);
+            break;
+        case BACKGROUND_SIZE_AUTO:
+        case BACKGROUND_SIZE_UNSUPPORTED:
+        default:
+            // Unscaled, in logical pixels like the CSS would draw it
+            scale = scale_factor;
+            break;
+    }
+
+    cairo_surface_t *surface =
+        cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(surface);
+        return NULL;
+    }
+    // GdkPixbufs are always 8-bit RGB, with or without alpha
+    ImageSource image = {
+        .pixels = gdk_pixbuf_read_pixels(source),
+        .width = gdk_pixbuf_get_width(source),
+        .height = gdk_pixbuf_get_height(source),
+        .rowstride = gdk_pixbuf_get_rowstride(source),
+        .channels = gdk_pixbuf_get_n_channels(source),
+    };
+    ImagePlacement placement = {
+        .scale = scale,
+        .x = (width - image_width * scale) / 2,
+        .y = (height - image_height * scale) / 2,
+    };
+    cairo_surface_flush(surface);
+    image_scale_to_argb(&image, &placement, cairo_image_surface_get_data(surface),
+                        width, height, cairo_image_surface_get_stride(surface),
+                        image_kernels_detect(), 0);
+    cairo_surface_mark_dirty(surface);
+
+    return surface;
+}
+
+
+/* Blur & dim a scaled background in place, as the header describes.
+ *
+ * The blur is split across the CPU's cores like the scaling.
+ */
+static void apply_background_effects(cairo_surface_t *surface,
+                                     const BackgroundCacheHeader *header)
+{
+    if (header->blur_radius == 0 && header->brightness == 255) {
+        return;
+    }
+    guint8 *pixels = cairo_image_surface_get_data(surface);
+    cairo_surface_flush(surface);
+    if (header->blur_radius > 0) {
+        image_blur_argb(pixels, header->width, header->height, header->stride,
+                        (gint) header->blur_radius, image_kernels_detect(), 0);
+    }
+    if (header->brightness < 255) {
+        image_dim_argb(pixels, header->width, header->height, header->stride,
+                       (guint8) header->brightness);
+    }
+    cairo_surface_mark_dirty(surface);
+}
+
+
+/* Write a scaled background to the cache.
+ *
+ * The file is written under a temporary name & renamed into place, so a
+ * crash or concurrent greeter never leaves a partial cache file behind.
+ * Failures are logged but otherwise ignored, the cache is only an
+ * optimization.
+ */
+static void write_cached_background(const gchar *cache_path,
+                                    const BackgroundCacheHeader *header,
+                                    cairo_surface_t *surface)
+{
+    gchar *cache_directory = g_path_get_dirname(cache_path);
+    if (g_mkdir_with_parents(cache_directory, 0700) != 0) {
+        g_message("Could not create background cache directory %s: %s",
+                  cache_directory, g_strerror(errno));
+        g_free(cache_directory);
+        return;
+    }
+    g_free(cache_directory);
+
+    gchar *temp_path = g_strconcat(cache_path, ".XXXXXX", NULL);
+    int fd = g_mkstemp(temp_path);
+    if (fd < 0) {
+        g_message("Could not create background cache file %s: %s",
+                  temp_path, g_strerror(errno));
+        g_free(temp_path);
+        return;
+    }
+
+    guint8 header_block[BACKGROUND_CACHE_DATA_OFFSET] = { 0 };
+    memcpy(header_block, header, sizeof(BackgroundCacheHeader));
+    gsize data_length = (gsize) header->stride * (gsize) header->height;
+    gboolean written =
+        write_all(fd, header_block, sizeof(header_block)) &&
+        write_all(fd, cairo_image_surface_get_data(surface), data_length);
+    close(fd);
+
+    if (!written || rename(temp_path, cache_path) != 0) {
+        g_message("Could not write background cache file %s: %s",
+                  cache_path, g_strerror(errno));
+        unlink(temp_path);
+    } else {
+        prune_background_cache(cache_path);
+    }
+    g_free(temp_path);
+}
+
+
+/* Remove the cache files of other images, & the oldest sizes of this one.
+ *
+ * The image's just written file is always kept. Temporary files are left for
+ * the greeter writing them.
+ */
+static void prune_background_cache(const gchar *cache_path)
+{
+    gchar *cache_directory = g_path_get_dirname(cache_path);
+    GDir *directory = g_dir_open(cache_directory, 0, NULL);
+    if (directory == NULL) {
+        g_free(cache_directory);
+        return;
+    }
+    gchar *kept_name = g_path_get_basename(cache_path);
+    // Everything up to & including the '-' is the hash of the image's path
+    gsize prefix_length = (gsize) (strchr(kept_name, '-') - kept_name) + 1;
+    gchar *image_prefix = g_strndup(kept_name, prefix_length);
+
+    GArray *sizes = g_array_new(FALSE, FALSE, sizeof(CacheFile));
+    const gchar *name;
+    while ((name = g_dir_read_name(directory)) != NULL) {
+        if (!g_str_has_suffix(name, ".argb") || strcmp(name, kept_name) == 0) {
+            continue;
+        }
+        gchar *path = g_build_filename(cache_directory, name, NULL);
+        struct stat file_stat;
+        if (!g_str_has_prefix(name, image_prefix)) {
+            unlink(path);
+            g_free(path);
+        } else if (stat(path, &file_stat) == 0) {
+            CacheFile file = {
+                path,
+                (gint64) file_stat.st_mtim.tv_sec * G_USEC_PER_SEC
+                    + file_stat.st_mtim.tv_nsec / 1000,
+            };
+            g_array_append_val(sizes, file);
+        } else {
+            g_free(path);
+        }
+    }
+    g_dir_close(directory);
+
+    // Newest first, the kept file takes one of the image's places
+    g_array_sort(sizes, compare_cache_files);
+    for (guint i = 0; i < sizes->len; i++) {
+        CacheFile *file = &g_array_index(sizes, CacheFile, i);
+        if (i + 1 >= BACKGROUND_CACHE_MAX_SIZES) {
+            unlink(file->path);
+        }
+        g_free(file->path);
+    }
+
+    g_array_free(sizes, TRUE);
+    g_free(image_prefix);
+    g_free(kept_name);
+    g_free(cache_directory);
+}
+
+
+/* Order cache files from the most to the least recently written */
+static gint compare_cache_files(gconstpointer a, gconstpointer b)
+{
+    gint64 first = ((const CacheFile *) a)->mtime;
+    gint64 second = ((const CacheFile *) b)->mtime;
+    return (first < second) - (first > second);
+}
+
+
+/* Write an entire buffer to a file descriptor, retrying short writes */
+static gboolean write_all(int fd, const void *buffer, gsize length)
+{
+    const guint8 *remaining = buffer;
+    while (length > 0) {
+        ssize_t written = write(fd, remaining, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE;
+        }
+        remaining += written;
+        length -= (gsize) written;
+    }
+    return TRUE;
+}
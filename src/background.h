@@ -0,0 +1,35 @@
+#ifndef BACKGROUND_H
+#define BACKGROUND_H
+
+#include <cairo.h>
+#include <gdk/gdk.h>
+
+#include "config.h"
+
+
+// The decoded background image & its scaled surfaces, shared by all monitors
+typedef struct BackgroundCache_ {
+    /* Path to the image, or NULL if we can't scale it ourselves */
+    gchar      *image_path;
+    guint       size_mode;
+    gint64      source_mtime;
+    gint64      source_size;
+    /* The `background-blur` in logical pixels & `background-dim` percentage */
+    guint       blur;
+    guint       dim;
+    /* The decoded image, only kept while surfaces are being built */
+    GdkPixbuf  *source;
+    /* Maps "<width>x<height>@<scale>" to a scaled cairo_surface_t */
+    GHashTable *surfaces;
+} BackgroundCache;
+
+
+BackgroundCache *initialize_background_cache(const Config *config);
+void destroy_background_cache(BackgroundCache *cache);
+cairo_surface_t *background_cache_get_image(BackgroundCache *cache,
+                                            const GdkRectangle *geometry,
+                                            gint scale_factor);
+void background_cache_release_source(BackgroundCache *cache);
+gchar *get_background_image_path(const Config *config);
+
+#endif
@@ -1,51 +1,295 @@
 /* Callback Functions for LightDM & GTK */
+#include <stdlib.h>
+#include <string.h>
+
 #include <gtk/gtk.h>
 #include <lightdm.h>
-#include <string.h>
-#include <time.h>
 
 #include "app.h"
+#include "auth_metrics.h"
 #include "utils.h"
 #include "focus_ring.h"
+#include "idle.h"
+#include "memory_report.h"
+#include "secure_buffer.h"
+#include "sessions.h"
 #include "callbacks.h"
 #include "compat.h"
+#include "timing.h"
+#include "users.h"
 
-static void set_ui_feedback_label(App *app, gchar *feedback_text);
+static void start_selected_session(App *app);
+static void session_started_cb(GObject *greeter, GAsyncResult *result,
+                               gpointer user_data);
+static gboolean handle_session_start_timeout(App *app);
+static void clear_session_start(App *app);
+static void session_start_failed(App *app, const gchar *feedback_text);
+static void reset_password_input(App *app);
+static void respond_with_password(App *app);
+static gboolean handle_deferred_ui(App *app);
+static gboolean handle_user_ring_idle(App *app);
+static void handle_monitor_geometry_change(GdkMonitor *monitor, GParamSpec *pspec,
+                                           App *app);
+static gboolean handle_hotkey(App *app, const GdkEventKey *event);
+static void select_next_user(App *app);
+static void set_ui_feedback_label(App *app, const gchar *feedback_text);
+static void warn_about_restart_only_changes(const Config *old_config,
+                                            const Config *config);
 
 
 /* LightDM Callbacks */
 
+/* Finish connecting to the LightDM daemon & start authenticating.
+ *
+ * The windows are already visible by the time this runs, so the daemon's
+ * round trip is off the path to the first frame.
+ */
+void daemon_connected_cb(GObject *greeter, GAsyncResult *result, gpointer user_data)
+{
+    App *app = user_data;
+    GError *connect_error = NULL;
+    if (!compat_greeter_connect_to_daemon_finish(app->greeter, result, &connect_error)) {
+        g_critical("Could not connect to the LightDM daemon: %s",
+                   connect_error != NULL ? connect_error->message : "unknown error");
+        if (connect_error != NULL) {
+            g_error_free(connect_error);
+        }
+        return;
+    }
+    timing_phase_end(TIMING_CONNECT_TO_DAEMON);
+    app->daemon_connected = TRUE;
+
+    timing_phase_begin(TIMING_BEGIN_AUTHENTICATION);
+    begin_authentication_as_selected_user(app);
+    timing_phase_end(TIMING_BEGIN_AUTHENTICATION);
+    timing_phase_begin(TIMING_SESSION_FOCUS_RING);
+    make_session_focus_ring(app);
+    timing_phase_end(TIMING_SESSION_FOCUS_RING);
+}
+
+
+/* Note that LightDM is waiting for a response.
+ *
+ * The first secret prompt is for the password, which is sent right away if
+ * it was entered before the prompt arrived. Any other prompt, e.g. for a PIN
+ * or one-time code after the password, is shown in place of the password
+ * label & needs a fresh answer.
+ *
+ * Listing the users can read every home directory, so the user ring is only
+ * built once the first prompt has been drawn.
+ */
+void show_prompt_cb(LightDMGreeter *greeter, const gchar *text,
+                    LightDMPromptType type, App *app)
+{
+    app->prompt_pending = TRUE;
+    if (app->config->show_user_list && app->user_ring == NULL &&
+            app->user_ring_idle_id == 0) {
+        // Below GDK's redraw priority, so the next frame is drawn first
+        app->user_ring_idle_id = g_idle_add_full(
+            G_PRIORITY_LOW, G_SOURCE_FUNC(handle_user_ring_idle), app, NULL);
+    }
+    auth_metric_end(AUTH_METRIC_PROMPT, TRUE);
+    // The user's time answering another prompt isn't part of the response
+    auth_metric_pause(AUTH_METRIC_RESPONSE);
+    const gboolean is_secret = type == LIGHTDM_PROMPT_TYPE_SECRET;
+    if (app->prompts_answered == 0 && is_secret) {
+        if (app->password_queued) {
+            respond_with_password(app);
+        }
+        return;
+    }
+
+    g_message("LightDM prompted for: %s", text);
+    app->password_queued = FALSE;
+    set_ui_prompt(app->config, app->ui, text, is_secret);
+    reset_password_input(app);
+}
+
+
+/* Show an informational or error message from the PAM conversation.
+ *
+ * Messages don't need a response, so the password input stays usable. This
+ * lets a password be typed while e.g. a fingerprint reader is waiting, &
+ * whichever authenticates first wins.
+ */
+void show_message_cb(LightDMGreeter *greeter, const gchar *text,
+                     LightDMMessageType type, App *app)
+{
+    g_message("LightDM message: %s", text);
+    set_ui_feedback_label(app, text);
+}
+
+
 /* Start the Selected Session Once Fully Authenticated.
  *
- * The callback will clear & re-enable the input widget, and re-add the
- * `handle_password` callback so the user can try again if authentication
- * fails.
+ * If authentication fails, the callback will clear & re-enable the input
+ * widget, and re-add the `handle_password` callback so the user can try
+ * again. The input stays disabled while the session is starting.
+ *
+ * A password still queued when authentication succeeds, e.g. because a
+ * fingerprint was accepted first, is wiped without being sent.
  */
 void authentication_complete_cb(LightDMGreeter *greeter, App *app)
 {
-    if (lightdm_greeter_get_is_authenticated(greeter)) {
-        const gchar *session = focus_ring_get_value(app->session_ring);
+    app->prompt_pending = FALSE;
+    memory_report_sample("authentication_complete");
+    const gboolean is_authenticated = lightdm_greeter_get_is_authenticated(greeter);
+    auth_metric_cancel(AUTH_METRIC_PROMPT);
+    auth_metric_end(AUTH_METRIC_RESPONSE, is_authenticated);
+    if (is_authenticated) {
+        if (app->password_queued) {
+            app->password_queued = FALSE;
+            secure_entry_buffer_wipe(SECURE_ENTRY_BUFFER(
+                gtk_entry_get_buffer(GTK_ENTRY(APP_PASSWORD_INPUT(app)))));
+        }
+        start_selected_session(app);
+        return;
+    }
 
-        g_message("Attempting to start session: %s", session);
+    g_message("Authentication failed");
+    // Without an answer, it was e.g. the fingerprint that didn't match & PAM
+    // has already said why
+    if (app->prompts_answered > 0 && strlen(app->config->invalid_password_text) > 0) {
+        set_ui_feedback_label(app, app->config->invalid_password_text);
+    }
+    app->password_queued = FALSE;
+    begin_authentication_as_selected_user(app);
+    reset_password_input(app);
+}
 
-        gboolean session_started_successfully =
-            !lightdm_greeter_start_session_sync(greeter, session, NULL);
 
-        if (!session_started_successfully) {
-            g_message("Unable to start session");
-        }
+/* Ask LightDM to start the selected session without blocking the UI.
+ *
+ * A "Starting <session>…" message is shown until LightDM replies. If it
+ * doesn't reply within the `session-start-timeout`, the attempt is
+ * abandoned so the user can try again.
+ */
+static void start_selected_session(App *app)
+{
+    const gchar *session = NULL;
+    const gchar *session_name = "default session";
+    if (app->session_ring != NULL && focus_ring_get_length(app->session_ring) > 0) {
+        session = focus_ring_get_value(app->session_ring);
+        session_name =
+            ((const Session *) focus_ring_get_selected(app->session_ring))->name;
+    }
+
+    g_message("Attempting to start session: %s", session);
+    gchar *starting_text = g_strdup_printf("Starting %s\u2026", session_name);
+    set_ui_feedback_label(app, starting_text);
+    g_free(starting_text);
+
+    // The request's cancellable identifies its reply, & leads back to us
+    GCancellable *cancellable = g_cancellable_new();
+    g_object_set_data(G_OBJECT(cancellable), "app", app);
+    app->session_start_cancellable = cancellable;
+    if (app->config->session_start_timeout > 0) {
+        app->session_start_timeout_id = g_timeout_add_seconds(
+            app->config->session_start_timeout,
+            G_SOURCE_FUNC(handle_session_start_timeout), app);
+    }
+
+    auth_metric_begin(AUTH_METRIC_SESSION_START);
+    lightdm_greeter_start_session(app->greeter, session, cancellable,
+                                  session_started_cb, cancellable);
+}
+
+
+/* Handle LightDM's reply to a session start request.
+ *
+ * The request holds its own reference to the cancellable, so it's valid here
+ * even after the request was abandoned. A reply to an abandoned request is
+ * stale & ignored. On success there is nothing left to do, LightDM will stop
+ * the greeter.
+ */
+static void session_started_cb(GObject *greeter, GAsyncResult *result,
+                               gpointer user_data)
+{
+    GCancellable *cancellable = user_data;
+    GError *start_error = NULL;
+    gboolean session_started = lightdm_greeter_start_session_finish(
+        LIGHTDM_GREETER(greeter), result, &start_error);
+
+    if (g_cancellable_is_cancelled(cancellable)) {
+        g_message("Ignoring the reply to an abandoned session start");
     } else {
-        g_message("Authentication failed");
-        if (strlen(app->config->invalid_password_text) > 0) {
-            set_ui_feedback_label(app, app->config->invalid_password_text);
+        App *app = g_object_get_data(G_OBJECT(cancellable), "app");
+        clear_session_start(app);
+        auth_metric_end(AUTH_METRIC_SESSION_START, session_started);
+        if (session_started) {
+            g_message("Session started");
+        } else {
+            g_message("Unable to start session: %s",
+                      start_error != NULL ? start_error->message : "unknown error");
+            session_start_failed(app, "Unable to start session");
         }
-        begin_authentication_as_default_user(app);
     }
+
+    if (start_error != NULL) {
+        g_error_free(start_error);
+    }
+}
+
+
+/* Give up on a session start that LightDM hasn't replied to.
+ *
+ * The request is cancelled, so a late reply can't be mistaken for the next
+ * attempt's.
+ */
+static gboolean handle_session_start_timeout(App *app)
+{
+    app->session_start_timeout_id = 0;
+    g_message("Timed out waiting for the session to start");
+    auth_metric_end(AUTH_METRIC_SESSION_START, FALSE);
+    cancel_session_start(app);
+    session_start_failed(app, "Timed out starting session");
+
+    return G_SOURCE_REMOVE;
+}
+
+
+/* Abandon the pending session start request, if there is one */
+void cancel_session_start(App *app)
+{
+    if (app->session_start_cancellable != NULL) {
+        g_cancellable_cancel(app->session_start_cancellable);
+    }
+    clear_session_start(app);
+}
+
+
+/* Forget the pending session start request & stop its timeout */
+static void clear_session_start(App *app)
+{
+    if (app->session_start_timeout_id != 0) {
+        g_source_remove(app->session_start_timeout_id);
+        app->session_start_timeout_id = 0;
+    }
+    g_clear_object(&app->session_start_cancellable);
+}
+
+
+/* Show why the session didn't start & let the user authenticate again */
+static void session_start_failed(App *app, const gchar *feedback_text)
+{
+    set_ui_feedback_label(app, feedback_text);
+    begin_authentication_as_selected_user(app);
+    reset_password_input(app);
+}
+
+
+/* Clear & re-enable the password input, re-adding the `handle_password`
+ * callback if it was disabled.
+ */
+static void reset_password_input(App *app)
+{
     gtk_entry_set_text(GTK_ENTRY(APP_PASSWORD_INPUT(app)), "");
     gtk_editable_set_editable(GTK_EDITABLE(APP_PASSWORD_INPUT(app)), TRUE);
-    app->password_callback_id =
-        g_signal_connect(GTK_ENTRY(APP_PASSWORD_INPUT(app)), "activate",
-                         G_CALLBACK(handle_password), app);
+    if (app->password_callback_id == 0) {
+        app->password_callback_id =
+            g_signal_connect(GTK_ENTRY(APP_PASSWORD_INPUT(app)), "activate",
+                             G_CALLBACK(handle_password), app);
+    }
 }
 
 
@@ -57,6 +301,10 @@ void authentication_complete_cb(LightDMGreeter *greeter, App *app)
  * The callback disables itself & the input widget to prevent two
  * authentication attempts from running at the same time - which would cause
  * LightDM to throw a critical error.
+ *
+ * LightDM only accepts a response once it has prompted for one, so a
+ * password entered before we've connected to the daemon or received the
+ * prompt is queued & sent by `show_prompt_cb`.
  */
 void handle_password(GtkWidget *password_input, App *app)
 {
@@ -66,18 +314,44 @@ void handle_password(GtkWidget *password_input, App *app)
         app->password_callback_id = 0;
     }
 
-    if (!lightdm_greeter_get_is_authenticated(app->greeter)) {
-        gtk_editable_set_editable(GTK_EDITABLE(password_input), FALSE);
-        if (!lightdm_greeter_get_in_authentication(app->greeter)) {
-            begin_authentication_as_default_user(app);
-        }
-        g_message("Using entered password to authenticate");
-        const gchar *password_text =
-            gtk_entry_get_text(GTK_ENTRY(password_input));
-        compat_greeter_respond(app->greeter, password_text, NULL);
-    } else {
+    if (app->daemon_connected && lightdm_greeter_get_is_authenticated(app->greeter)) {
         g_message("Password entered while already authenticated");
+        return;
+    }
+
+    gtk_editable_set_editable(GTK_EDITABLE(password_input), FALSE);
+    if (app->daemon_connected &&
+            !lightdm_greeter_get_in_authentication(app->greeter)) {
+        begin_authentication_as_selected_user(app);
+    }
+    if (!app->prompt_pending) {
+        g_message("Queueing password until LightDM prompts for it");
+        app->password_queued = TRUE;
+        return;
+    }
+    respond_with_password(app);
+}
+
+
+/* Send the entered password, or answer, to LightDM in response to its prompt */
+static void respond_with_password(App *app)
+{
+    app->password_queued = FALSE;
+    app->prompt_pending = FALSE;
+    app->prompts_answered++;
+
+    g_message("Using entered password to authenticate");
+    const gchar *password_text =
+        gtk_entry_get_text(GTK_ENTRY(APP_PASSWORD_INPUT(app)));
+    // Every response of one authentication is timed as a single step
+    if (app->prompts_answered == 1) {
+        auth_metric_begin(AUTH_METRIC_RESPONSE);
+    } else {
+        auth_metric_resume(AUTH_METRIC_RESPONSE);
     }
+    compat_greeter_respond(app->greeter, password_text, NULL);
+    secure_entry_buffer_wipe(SECURE_ENTRY_BUFFER(
+        gtk_entry_get_buffer(GTK_ENTRY(APP_PASSWORD_INPUT(app)))));
 }
 
 
@@ -87,6 +361,16 @@ gboolean handle_tab_key(GtkWidget *widget, GdkEvent *event, App *app)
     (void) widget;  // Window accessible through app.
 
     GdkEventKey *key_event = (GdkEventKey *) event;
+    // Don't lose a hotkey that woke us, other keys only wake the greeter
+    if (wake_from_idle(app)) {
+        gtk_window_present(GTK_WINDOW(APP_MAIN_WINDOW(app)));
+        gtk_widget_grab_focus(GTK_WIDGET(APP_PASSWORD_INPUT(app)));
+        if (event->type == GDK_KEY_PRESS) {
+            handle_hotkey(app, key_event);
+        }
+        return TRUE;
+    }
+
     if (event->type == GDK_KEY_PRESS && key_event->keyval == GDK_KEY_Tab) {
         g_message("Handling Tab Key Press");
         gtk_window_present(GTK_WINDOW(APP_MAIN_WINDOW(app)));
@@ -96,12 +380,19 @@ gboolean handle_tab_key(GtkWidget *widget, GdkEvent *event, App *app)
     return TRUE;
 }
 
-/* Shutdown, Restart, Hibernate, Suspend, or Switch Sessions if the correct
- * keys are pressed.
+/* Shutdown, Restart, Hibernate, Suspend, or Switch Sessions or Users if the
+ * correct keys are pressed.
  */
 gboolean handle_hotkeys(GtkWidget *widget, GdkEventKey *event, App *app)
 {
     (void) widget;
+    wake_from_idle(app);
+    return handle_hotkey(app, event);
+}
+
+/* Run the action bound to a key press, returning FALSE if it isn't a hotkey */
+static gboolean handle_hotkey(App *app, const GdkEventKey *event)
+{
     Config *config = app->config;
     FocusRing *sessions = app->session_ring;
 
@@ -117,9 +408,13 @@ gboolean handle_hotkeys(GtkWidget *widget, GdkEventKey *event, App *app)
         } else if (event->keyval == config->shutdown_key &&
                    lightdm_get_can_shutdown()) {
             lightdm_shutdown(NULL);
-        } else if (event->keyval == config->session_key && sessions != NULL) {
-            gchar *new_session = focus_ring_next(sessions);
+        } else if (event->keyval == config->session_key && sessions != NULL &&
+                   focus_ring_get_length(sessions) > 0) {
+            const gchar *new_session = focus_ring_next(sessions);
             set_ui_feedback_label(app, new_session);
+        } else if (event->keyval == config->user_key && app->user_ring != NULL &&
+                   focus_ring_get_length(app->user_ring) > 1) {
+            select_next_user(app);
         } else {
             return FALSE;
         }
@@ -129,21 +424,236 @@ gboolean handle_hotkeys(GtkWidget *widget, GdkEventKey *event, App *app)
     return FALSE;
 }
 
-/** Determine the current time & update the time GtkLabel.
+/* Switch to the next user in the user list.
+ *
+ * Their default session is selected if they have one, & authentication
+ * restarts as them. Anything typed for the previous user is discarded.
  */
-gboolean handle_time_update(App *app)
+static void select_next_user(App *app)
 {
-    time_t now = time(NULL);
-    struct tm *local_now = localtime(&now);
-    gchar date_string[30];
-    strftime(date_string, 29, "%H:%M", local_now);
-    gtk_label_set_text(GTK_LABEL(APP_TIME_LABEL(app)), date_string);
+    focus_ring_next(app->user_ring);
+    const User *user = focus_ring_get_selected(app->user_ring);
+    g_message("Switching to user: %s", user->name);
+    show_selected_user_in_ui(app);
+    if (user->session != NULL && app->session_ring != NULL) {
+        focus_ring_scroll_to_value(app->session_ring, user->session);
+    }
 
-    return TRUE;
+    app->password_queued = FALSE;
+    if (app->daemon_connected && !lightdm_greeter_get_is_authenticated(app->greeter)) {
+        begin_authentication_as_selected_user(app);
+    }
+    reset_password_input(app);
+}
+
+/* Build the user ring, off the path to the first prompt */
+static gboolean handle_user_ring_idle(App *app)
+{
+    app->user_ring_idle_id = 0;
+    make_user_focus_ring(app);
+    return G_SOURCE_REMOVE;
+}
+
+/* Show a user's avatar once it has loaded, if they're still selected */
+void handle_avatar_loaded(User *user, gpointer user_data)
+{
+    App *app = user_data;
+    if (focus_ring_get_selected(app->user_ring) == user) {
+        show_selected_user_in_ui(app);
+    }
+}
+
+/** Show the newly rendered time in the time GtkLabel.
+ */
+void handle_time_update(const gchar *time_text, gpointer user_data)
+{
+    App *app = user_data;
+    if (APP_TIME_LABEL(app) == NULL) {
+        // Not built yet when using a staged startup
+        return;
+    }
+    gtk_label_set_text(GTK_LABEL(APP_TIME_LABEL(app)), time_text);
+}
+
+/* Apply a reloaded configuration to the running greeter.
+ *
+ * Only the parts of the UI whose settings changed are updated. Settings that
+ * change which widgets exist, or that were already used during startup, only
+ * take effect after a restart.
+ */
+void handle_config_change(Config *config, gpointer user_data)
+{
+    App *app = user_data;
+    Config *old_config = app->config;
+    app->config = config;
+
+    update_ui_theme(config, app->ui);
+    update_ui_widgets(old_config, config, app->ui);
+    if (strcmp(old_config->background_image, config->background_image) != 0 ||
+            strcmp(old_config->background_image_size, config->background_image_size) != 0 ||
+            old_config->background_blur != config->background_blur ||
+            old_config->background_dim != config->background_dim ||
+            old_config->show_image_on_all_monitors != config->show_image_on_all_monitors) {
+        reload_background_images(config, app->ui);
+    }
+    if (app->clock != NULL &&
+            strcmp(old_config->time_format, config->time_format) != 0) {
+        destroy_clock(app->clock);
+        app->clock = initialize_clock(config->time_format, handle_time_update, app);
+        if (app->is_idle) {
+            clock_stop(app->clock);
+        }
+    }
+    if (old_config->idle_timeout != config->idle_timeout) {
+        reset_idle_timer(app);
+    }
+    warn_about_restart_only_changes(old_config, config);
+
+    destroy_config(old_config);
+}
+
+
+/* Log the changed settings that need a restart to take effect */
+static void warn_about_restart_only_changes(const Config *old_config,
+                                            const Config *config)
+{
+    if (strcmp(old_config->login_user, config->login_user) != 0) {
+        g_message("The user setting will be used after a restart");
+    }
+    if (old_config->show_password_label != config->show_password_label) {
+        g_message("The show-password-label setting will be used after a restart");
+    }
+    if (old_config->show_user_list != config->show_user_list) {
+        g_message("The show-user-list setting will be used after a restart");
+    }
+    if (old_config->avatar_size != config->avatar_size) {
+        g_message("The avatar-size setting will be used after a restart");
+    }
+    if (old_config->span_background != config->span_background) {
+        g_message("The span-background setting will be used after a restart");
+    }
+    if (old_config->show_sys_info != config->show_sys_info) {
+        g_message("The show-sys-info setting will be used after a restart");
+    }
+    if (old_config->staged_startup != config->staged_startup) {
+        g_message("The staged-startup setting will be used after a restart");
+    }
+    if (old_config->lock_memory != config->lock_memory) {
+        g_message("The lock-memory setting will be used after a restart");
+    }
+}
+
+
+/* Record the first frame drawn on the main window, replay the keys typed
+ * before it & start loading the rest of a staged UI.
+ *
+ * The callback disconnects itself so later redraws cost nothing.
+ */
+gboolean handle_first_frame(GtkWidget *widget, cairo_t *cr, App *app)
+{
+    g_signal_handler_disconnect(widget, app->first_frame_callback_id);
+    app->first_frame_callback_id = 0;
+    timing_phase_end(TIMING_FIRST_FRAME);
+    memory_report_sample("first_frame");
+    typeahead_replay(app->typeahead, GTK_ENTRY(APP_PASSWORD_INPUT(app)));
+
+    if (app->config->staged_startup) {
+        g_idle_add(G_SOURCE_FUNC(handle_deferred_ui), app);
+    }
+
+    return FALSE;
+}
+
+
+/* Load one stage of the deferred UI per idle iteration, so redraws & key
+ * presses are handled between them.
+ */
+static gboolean handle_deferred_ui(App *app)
+{
+    if (load_next_deferred_ui_stage(app->config, app->ui)) {
+        return G_SOURCE_CONTINUE;
+    }
+    if (app->clock != NULL) {
+        handle_time_update(clock_get_text(app->clock), app);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Cover a newly connected monitor with a background window & keep the main
+ * window centered.
+ */
+void handle_monitor_added(GdkDisplay *display, GdkMonitor *monitor, App *app)
+{
+    g_message("Adding a background window for a new monitor");
+    GtkWindow *background_window =
+        add_background_window(app->config, app->ui, monitor);
+    if (background_window != NULL) {
+        g_signal_connect(GTK_WIDGET(background_window), "key-press-event",
+                         G_CALLBACK(handle_tab_key), app);
+        // Stay blank if the monitor was connected while idle
+        set_window_idle_state(app, GTK_WIDGET(background_window));
+        gtk_widget_show_all(GTK_WIDGET(background_window));
+    }
+    watch_monitor_changes(app, monitor);
+    center_main_window(app->ui);
+}
+
+
+/* Remove a disconnected monitor's background window & move the main window
+ * back onto a connected monitor.
+ */
+void handle_monitor_removed(GdkDisplay *display, GdkMonitor *monitor, App *app)
+{
+    g_message("Removing the background window of a disconnected monitor");
+    g_signal_handlers_disconnect_matched(
+        monitor, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, app);
+    remove_background_window(app->config, app->ui, monitor);
+    if (app->primary_monitor == monitor) {
+        app->primary_monitor = NULL;
+    }
+    center_main_window(app->ui);
 }
 
+
+/* Move the background image & the main window when another monitor becomes
+ * the primary one.
+ */
+void handle_monitors_changed(GdkScreen *screen, App *app)
+{
+    GdkMonitor *primary_monitor =
+        gdk_display_get_primary_monitor(gdk_screen_get_display(screen));
+    if (primary_monitor == app->primary_monitor) {
+        return;
+    }
+    g_message("Moving the background image to the new primary monitor");
+    app->primary_monitor = primary_monitor;
+    update_background_images(app->config, app->ui);
+    center_main_window(app->ui);
+}
+
+
+/* Resize a monitor's background window when its geometry or scale changes */
+static void handle_monitor_geometry_change(GdkMonitor *monitor, GParamSpec *pspec,
+                                           App *app)
+{
+    update_background_window(app->config, app->ui, monitor);
+    center_main_window(app->ui);
+}
+
+
+/* Follow geometry & scale changes of a monitor with a background window */
+void watch_monitor_changes(App *app, GdkMonitor *monitor)
+{
+    g_signal_connect(monitor, "notify::geometry",
+                     G_CALLBACK(handle_monitor_geometry_change), app);
+    g_signal_connect(monitor, "notify::scale-factor",
+                     G_CALLBACK(handle_monitor_geometry_change), app);
+}
+
+
 /* Set the Feedback Label's text & ensure it is visible. */
-static void set_ui_feedback_label(App *app, gchar *feedback_text)
+static void set_ui_feedback_label(App *app, const gchar *feedback_text)
 {
     if (!gtk_widget_get_visible(APP_FEEDBACK_LABEL(app))) {
         gtk_widget_show(APP_FEEDBACK_LABEL(app));
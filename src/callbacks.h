@@ -4,12 +4,26 @@
 #include <lightdm.h>
 
 #include "app.h"
+#include "users.h"
 
 
+void daemon_connected_cb(GObject *greeter, GAsyncResult *result, gpointer user_data);
+void show_prompt_cb(LightDMGreeter *greeter, const gchar *text,
+                    LightDMPromptType type, App *app);
+void show_message_cb(LightDMGreeter *greeter, const gchar *text,
+                     LightDMMessageType type, App *app);
 void authentication_complete_cb(LightDMGreeter *greeter, App *app);
+void cancel_session_start(App *app);
 void handle_password(GtkWidget *password_input, App *app);
 gboolean handle_tab_key(GtkWidget *widget, GdkEvent *event, App *app);
 gboolean handle_hotkeys(GtkWidget *widget, GdkEventKey *event, App *app);
-gboolean handle_time_update(App *app);
+void handle_avatar_loaded(User *user, gpointer user_data);
+void handle_time_update(const gchar *time_text, gpointer user_data);
+void handle_config_change(Config *config, gpointer user_data);
+gboolean handle_first_frame(GtkWidget *widget, cairo_t *cr, App *app);
+void handle_monitor_added(GdkDisplay *display, GdkMonitor *monitor, App *app);
+void handle_monitor_removed(GdkDisplay *display, GdkMonitor *monitor, App *app);
+void handle_monitors_changed(GdkScreen *screen, App *app);
+void watch_monitor_changes(App *app, GdkMonitor *monitor);
 
 #endif
@@ -0,0 +1,252 @@
+/* The System Information Clock
+ *
+ * Instead of polling, a timerfd is armed for the next minute boundary, or the
+ * next second for formats that show seconds. The timer is cancelled when the
+ * wall clock is set, & /etc/localtime is watched for timezone changes, so the
+ * time is re-rendered as soon as either happens.
+ *
+ * The update function is only called when the rendered text changes.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "clock.h"
+
+
+#ifndef TFD_TIMER_CANCEL_ON_SET
+#define TFD_TIMER_CANCEL_ON_SET (1 << 1)
+#endif
+
+#define LOCALTIME_FILE "/etc/localtime"
+
+static gboolean format_shows_seconds(const gchar *format);
+static void arm_clock_timer(Clock *wall_clock);
+static gboolean handle_clock_timer(gint fd, GIOCondition condition,
+                                   gpointer user_data);
+static gboolean handle_clock_timeout(gpointer user_data);
+static void watch_timezone(Clock *wall_clock);
+static void handle_timezone_change(GFileMonitor *monitor, GFile *file,
+                                   GFile *other_file, GFileMonitorEvent event,
+                                   gpointer user_data);
+static void update_clock(Clock *wall_clock);
+
+
+/* Start a clock that renders the time with a strftime format.
+ *
+ * The update function is called once immediately, then on every change.
+ */
+Clock *initialize_clock(const gchar *format, ClockUpdateFunc update_func,
+                        gpointer user_data)
+{
+    Clock *wall_clock = malloc(sizeof(Clock));
+    if (wall_clock == NULL) {
+        g_error("Could not allocate memory for Clock");
+    }
+    wall_clock->format = g_strdup(format);
+    wall_clock->shows_seconds = format_shows_seconds(format);
+    wall_clock->timer_source_id = 0;
+    wall_clock->timezone_monitor = NULL;
+    wall_clock->time_text[0] = '\0';
+    wall_clock->update_func = update_func;
+    wall_clock->user_data = user_data;
+
+    wall_clock->timer_fd =
+        timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (wall_clock->timer_fd >= 0) {
+        arm_clock_timer(wall_clock);
+        wall_clock->timer_source_id = g_unix_fd_add(
+            wall_clock->timer_fd, G_IO_IN, handle_clock_timer, wall_clock);
+    } else {
+        // Fall back to polling, without alignment or clock-change detection
+        g_warning("Could not create the clock timer: %s", g_strerror(errno));
+        wall_clock->timer_source_id = g_timeout_add_seconds(
+            wall_clock->shows_seconds ? 1 : 15, handle_clock_timeout, wall_clock);
+    }
+    watch_timezone(wall_clock);
+
+    update_clock(wall_clock);
+    return wall_clock;
+}
+
+
+/* Stop the clock & free it */
+void destroy_clock(Clock *wall_clock)
+{
+    if (wall_clock->timer_source_id != 0) {
+        g_source_remove(wall_clock->timer_source_id);
+    }
+    if (wall_clock->timer_fd >= 0) {
+        close(wall_clock->timer_fd);
+    }
+    if (wall_clock->timezone_monitor != NULL) {
+        g_file_monitor_cancel(wall_clock->timezone_monitor);
+        g_object_unref(wall_clock->timezone_monitor);
+    }
+    g_free(wall_clock->format);
+    free(wall_clock);
+}
+
+
+/* Get the most recently rendered time */
+const gchar *clock_get_text(const Clock *wall_clock)
+{
+    return wall_clock->time_text;
+}
+
+
+/* Stop updating the time, leaving no timers that could wake the greeter */
+void clock_stop(Clock *wall_clock)
+{
+    if (wall_clock->timer_fd >= 0) {
+        struct itimerspec disarmed;
+        memset(&disarmed, 0, sizeof(disarmed));
+        timerfd_settime(wall_clock->timer_fd, 0, &disarmed, NULL);
+    } else if (wall_clock->timer_source_id != 0) {
+        g_source_remove(wall_clock->timer_source_id);
+        wall_clock->timer_source_id = 0;
+    }
+}
+
+
+/* Resume updating the time after `clock_stop`, updating it right away */
+void clock_start(Clock *wall_clock)
+{
+    if (wall_clock->timer_fd >= 0) {
+        arm_clock_timer(wall_clock);
+    } else if (wall_clock->timer_source_id == 0) {
+        wall_clock->timer_source_id = g_timeout_add_seconds(
+            wall_clock->shows_seconds ? 1 : 15, handle_clock_timeout, wall_clock);
+    }
+    update_clock(wall_clock);
+}
+
+
+/* Determine if a strftime format can change more than once a minute */
+static gboolean format_shows_seconds(const gchar *format)
+{
+    for (const gchar *c = format; *c != '\0'; c++) {
+        if (*c != '%') {
+            continue;
+        }
+        c++;
+        // Skip any flags, field width & the E/O modifiers
+        while (*c != '\0' && strchr("_-0^#+EO123456789", *c) != NULL) {
+            c++;
+        }
+        if (*c == '\0') {
+            break;
+        }
+        if (strchr("ScrsTX", *c) != NULL) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+
+/* Arm the timer for the next boundary, repeating every period after it.
+ *
+ * Timezone offsets are whole minutes, so UTC boundaries are local ones too.
+ */
+static void arm_clock_timer(Clock *wall_clock)
+{
+    const time_t period = wall_clock->shows_seconds ? 1 : 60;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    struct itimerspec timer_spec;
+    timer_spec.it_value.tv_sec = now.tv_sec - now.tv_sec % period + period;
+    timer_spec.it_value.tv_nsec = 0;
+    timer_spec.it_interval.tv_sec = period;
+    timer_spec.it_interval.tv_nsec = 0;
+    if (timerfd_settime(wall_clock->timer_fd,
+                        TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET,
+                        &timer_spec, NULL) != 0) {
+        g_warning("Could not arm the clock timer: %s", g_strerror(errno));
+    }
+}
+
+
+/* Update the time at a boundary, or re-arm the timer if the clock was set */
+static gboolean handle_clock_timer(gint fd, GIOCondition condition,
+                                   gpointer user_data)
+{
+    Clock *wall_clock = user_data;
+    guint64 expirations;
+    ssize_t read_length = read(fd, &expirations, sizeof(expirations));
+    if (read_length < 0 && errno == ECANCELED) {
+        arm_clock_timer(wall_clock);
+    }
+    update_clock(wall_clock);
+
+    return G_SOURCE_CONTINUE;
+}
+
+
+/* Update the time when the timer couldn't be created */
+static gboolean handle_clock_timeout(gpointer user_data)
+{
+    update_clock(user_data);
+
+    return G_SOURCE_CONTINUE;
+}
+
+
+/* Watch /etc/localtime, which is replaced when the timezone changes */
+static void watch_timezone(Clock *wall_clock)
+{
+    GFile *localtime_file = g_file_new_for_path(LOCALTIME_FILE);
+    GError *monitor_error = NULL;
+    wall_clock->timezone_monitor = g_file_monitor_file(
+        localtime_file, G_FILE_MONITOR_NONE, NULL, &monitor_error);
+    if (wall_clock->timezone_monitor == NULL) {
+        g_warning("Could not watch %s for timezone changes: %s",
+                  LOCALTIME_FILE, monitor_error->message);
+        g_error_free(monitor_error);
+    } else {
+        g_signal_connect(wall_clock->timezone_monitor, "changed",
+                         G_CALLBACK(handle_timezone_change), wall_clock);
+    }
+    g_object_unref(localtime_file);
+}
+
+
+/* Reload the timezone & re-render the time */
+static void handle_timezone_change(GFileMonitor *monitor, GFile *file,
+                                   GFile *other_file, GFileMonitorEvent event,
+                                   gpointer user_data)
+{
+    tzset();
+    update_clock(user_data);
+}
+
+
+/* Render the current time, calling the update function if it changed */
+static void update_clock(Clock *wall_clock)
+{
+    time_t now = time(NULL);
+    struct tm *local_now = localtime(&now);
+
+    gchar time_text[sizeof(wall_clock->time_text)];
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+    gsize time_length =
+        strftime(time_text, sizeof(time_text), wall_clock->format, local_now);
+#pragma GCC diagnostic pop
+    time_text[time_length] = '\0';
+
+    if (strcmp(time_text, wall_clock->time_text) == 0) {
+        return;
+    }
+    memcpy(wall_clock->time_text, time_text, sizeof(time_text));
+    wall_clock->update_func(wall_clock->time_text, wall_clock->user_data);
+}
@@ -0,0 +1,32 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <gio/gio.h>
+#include <glib.h>
+
+
+// Called with the newly rendered time whenever it changes
+typedef void (*ClockUpdateFunc)(const gchar *time_text, gpointer user_data);
+
+// A wall clock that wakes only when its rendered text can change
+typedef struct Clock_ {
+    gchar           *format;
+    // Update every second instead of every minute
+    gboolean         shows_seconds;
+    int              timer_fd;
+    guint            timer_source_id;
+    GFileMonitor    *timezone_monitor;
+    gchar            time_text[128];
+    ClockUpdateFunc  update_func;
+    gpointer         user_data;
+} Clock;
+
+
+Clock *initialize_clock(const gchar *format, ClockUpdateFunc update_func,
+                        gpointer user_data);
+void destroy_clock(Clock *clock);
+const gchar *clock_get_text(const Clock *clock);
+void clock_stop(Clock *clock);
+void clock_start(Clock *clock);
+
+#endif
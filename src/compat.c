@@ -1,8 +1,41 @@
 /* Backwards-Compatible Functions for LightDM */
+#include <gio/gio.h>
 #include <lightdm.h>
 
 #include "compat.h"
 
+/* Start connecting to the LightDM daemon.
+ *
+ * LightDM older than 1.19.2 only has `lightdm_greeter_connect_sync`, so we
+ * connect synchronously & the callback is run from an idle on the next main
+ * loop iteration, like the asynchronous connection's would be.
+ */
+void compat_greeter_connect_to_daemon(LightDMGreeter *greeter, GCancellable *cancellable,
+                                      GAsyncReadyCallback callback, gpointer user_data)
+{
+#ifdef LIGHTDM_1_19_1_LOWER
+    GTask *task = g_task_new(greeter, cancellable, callback, user_data);
+    GError *connect_error = NULL;
+    if (lightdm_greeter_connect_sync(greeter, &connect_error)) {
+        g_task_return_boolean(task, TRUE);
+    } else {
+        g_task_return_error(task, connect_error);
+    }
+    g_object_unref(task);
+#else
+    lightdm_greeter_connect_to_daemon(greeter, cancellable, callback, user_data);
+#endif
+}
+
+gboolean compat_greeter_connect_to_daemon_finish(LightDMGreeter *greeter, GAsyncResult *result, GError **error)
+{
+#ifdef LIGHTDM_1_19_1_LOWER
+    return g_task_propagate_boolean(G_TASK(result), error);
+#else
+    return lightdm_greeter_connect_to_daemon_finish(greeter, result, error);
+#endif
+}
+
 gboolean compat_greeter_authenticate(LightDMGreeter *greeter, const gchar *username, GError **error)
 {
 #ifdef LIGHTDM_1_19_1_LOWER
@@ -5,6 +5,11 @@
 
 #include "defines.h"
 
+// LightDM older than v1.19.2 can only connect synchronously, so this finishes from an idle there
+void compat_greeter_connect_to_daemon(LightDMGreeter *greeter, GCancellable *cancellable,
+                                      GAsyncReadyCallback callback, gpointer user_data);
+gboolean compat_greeter_connect_to_daemon_finish(LightDMGreeter *greeter, GAsyncResult *result, GError **error);
+
 // v1.19.2 of LightDM introduced GError arguments but Debian jessie & stretch are not updated yet
 gboolean compat_greeter_authenticate(LightDMGreeter *greeter, const gchar *username, GError **error);
 gboolean compat_greeter_respond(LightDMGreeter *greeter, const gchar *response, GError **error);
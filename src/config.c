@@ -6,9 +6,16 @@
 #include <glib.h>
 
 #include "config.h"
+#include "config_cache.h"
 #include "utils.h"
 
 
+static gchar *read_config_file(const gchar *config_path, gsize *length,
+                               GError **error);
+static Config *parse_config(const gchar *contents, gsize length, GError **error);
+static gboolean parse_greeter_mod_bit(GKeyFile *keyfile, guint *mod_bit,
+                                      GError **error);
+static void free_parsed_config(Config *config);
 static gchar *parse_greeter_string(GKeyFile *keyfile, const char *group_name,
                                    const char *key_name, const gchar *fallback);
 static gint parse_greeter_integer(GKeyFile *keyfile, const char *group_name,
@@ -16,32 +23,195 @@ static gint parse_greeter_integer(GKeyFile *keyfile, const char *group_name,
 static gboolean parse_greeter_boolean(GKeyFile *keyfile, const char *group_name,
                                       const char *key_name, const gboolean fallback);
 static GdkRGBA *parse_greeter_color_key(GKeyFile *keyfile, const char *key_name, const char *default_str);
+static GdkRGBA *copy_greeter_color(const GdkRGBA *color);
 static guint parse_greeter_hotkey_keyval(GKeyFile *keyfile, const char *key_name, const char default_char);
 static gunichar *parse_greeter_password_char(GKeyFile *keyfile);
 static gfloat parse_greeter_password_alignment(GKeyFile *keyfile);
 static gboolean is_rtl_keymap_layout(void);
 gboolean input_string_equals(gchar *input_str, const gchar * const fixed_str);
 
-/* Initialize the configuration, sourcing the greeter's configuration file */
+
+// The offsets of every string field in a Config
+static const glong config_string_fields[] = {
+    G_STRUCT_OFFSET(Config, login_user),
+    G_STRUCT_OFFSET(Config, password_label_text),
+    G_STRUCT_OFFSET(Config, invalid_password_text),
+    G_STRUCT_OFFSET(Config, time_format),
+    G_STRUCT_OFFSET(Config, timing_report_file),
+    G_STRUCT_OFFSET(Config, memory_report_file),
+    G_STRUCT_OFFSET(Config, auth_metrics_file),
+    G_STRUCT_OFFSET(Config, font),
+    G_STRUCT_OFFSET(Config, font_size),
+    G_STRUCT_OFFSET(Config, font_weight),
+    G_STRUCT_OFFSET(Config, font_style),
+    G_STRUCT_OFFSET(Config, background_image),
+    G_STRUCT_OFFSET(Config, background_image_size),
+    G_STRUCT_OFFSET(Config, border_width),
+    G_STRUCT_OFFSET(Config, password_border_width),
+    G_STRUCT_OFFSET(Config, password_border_radius),
+    G_STRUCT_OFFSET(Config, sys_info_font),
+    G_STRUCT_OFFSET(Config, sys_info_font_size),
+    G_STRUCT_OFFSET(Config, sys_info_margin),
+};
+
+// The offsets of every color field in a Config
+static const glong config_color_fields[] = {
+    G_STRUCT_OFFSET(Config, text_color),
+    G_STRUCT_OFFSET(Config, error_color),
+    G_STRUCT_OFFSET(Config, background_color),
+    G_STRUCT_OFFSET(Config, window_color),
+    G_STRUCT_OFFSET(Config, border_color),
+    G_STRUCT_OFFSET(Config, password_color),
+    G_STRUCT_OFFSET(Config, password_background_color),
+    G_STRUCT_OFFSET(Config, password_border_color),
+    G_STRUCT_OFFSET(Config, sys_info_color),
+};
+
+
+/* Get the path to the greeter's configuration file.
+ *
+ * The `LIGHTDM_MINI_GREETER_CONFIG` environment variable overrides the
+ * compiled-in `CONFIG_FILE`, which lets benchmarks & tests run the greeter
+ * without touching the system configuration.
+ */
+const gchar *get_config_file_path(void)
+{
+    const gchar *config_file = g_getenv("LIGHTDM_MINI_GREETER_CONFIG");
+    if (config_file == NULL || config_file[0] == '\0') {
+        return CONFIG_FILE;
+    }
+    return config_file;
+}
+
+
+/* Initialize the configuration, sourcing the greeter's configuration file.
+ *
+ * Exits with an error if the file can't be read or parsed.
+ */
 Config *initialize_config(void)
 {
-    Config *config = malloc(sizeof(Config));
+    GError *load_error = NULL;
+    Config *config = load_config(&load_error);
     if (config == NULL) {
-        g_error("Could not allocate memory for Config");
+        g_error("Could not load configuration file: %s", load_error->message);
     }
+    return config;
+}
 
-    // Load the key-value file
-    GKeyFile *keyfile = g_key_file_new();
-    GError *keyerror = NULL;
-    gboolean keyfile_loaded = g_key_file_load_from_file(
-        keyfile, CONFIG_FILE, G_KEY_FILE_NONE, &keyerror);
-    if (!keyfile_loaded) {
-        if (keyerror != NULL) {
-            g_error("Could not load configuration file: %s", keyerror->message);
-            free(keyerror);
-        } else {
-            g_error("Could not load configuration file.");
+
+/* Load the greeter's configuration file into a new Config.
+ *
+ * A compiled config matching the file is used when one exists, either the
+ * one built by `--compile-config` or one we wrote on an earlier start.
+ * Otherwise the file is parsed & compiled for next time. Returns NULL if the
+ * file can't be read or parsed.
+ */
+Config *load_config(GError **error)
+{
+    const gchar *config_path = get_config_file_path();
+    gsize length;
+    gchar *contents = read_config_file(config_path, &length, error);
+    if (contents == NULL) {
+        return NULL;
+    }
+    ConfigSource source;
+    identify_config_source(&source, config_path, contents, length);
+
+    gchar *compiled_path = get_compiled_config_path(config_path);
+    Config *config = load_compiled_config(compiled_path, &source);
+    g_free(compiled_path);
+    if (config == NULL) {
+        gchar *user_compiled_path = get_user_compiled_config_path(config_path);
+        config = load_compiled_config(user_compiled_path, &source);
+        if (config == NULL) {
+            config = parse_config(contents, length, error);
+            if (config != NULL) {
+                write_compiled_config(user_compiled_path, &source, config);
+            }
         }
+        g_free(user_compiled_path);
+    }
+    g_free(contents);
+    if (config == NULL) {
+        return NULL;
+    }
+
+    // The keymap can change without the config changing, so it's never cached
+    if (is_rtl_keymap_layout()) {
+        config->password_alignment = 1 - config->password_alignment;
+    }
+
+    return config;
+}
+
+
+/* Parse the configuration file & write it next to the file as a compiled
+ * config. Used by `--compile-config`, so packaging can pre-build it.
+ */
+gboolean compile_config_file(void)
+{
+    const gchar *config_path = get_config_file_path();
+    gsize length;
+    GError *load_error = NULL;
+    gchar *contents = read_config_file(config_path, &length, &load_error);
+    Config *config = NULL;
+    if (contents != NULL) {
+        config = parse_config(contents, length, &load_error);
+    }
+    if (config == NULL) {
+        g_warning("Could not load configuration file: %s", load_error->message);
+        g_error_free(load_error);
+        g_free(contents);
+        return FALSE;
+    }
+    ConfigSource source;
+    identify_config_source(&source, config_path, contents, length);
+
+    gchar *compiled_path = get_compiled_config_path(config_path);
+    gboolean compiled = write_compiled_config(compiled_path, &source, config);
+    if (compiled) {
+        g_message("Compiled %s to %s", config_path, compiled_path);
+    }
+
+    g_free(compiled_path);
+    destroy_config(config);
+    g_free(contents);
+    return compiled;
+}
+
+
+/* Read the configuration file, returning NULL if it can't be read */
+static gchar *read_config_file(const gchar *config_path, gsize *length,
+                               GError **error)
+{
+    gchar *contents = NULL;
+    if (!g_file_get_contents(config_path, &contents, length, error)) {
+        return NULL;
+    }
+    return contents;
+}
+
+
+/* Parse the contents of the configuration file into a new Config.
+ *
+ * Every field is parsed into its own allocation, then packed into a single
+ * block by `pack_config`. The password alignment is parsed for left-to-right
+ * layouts, `initialize_config` mirrors it for right-to-left keymaps.
+ */
+static Config *parse_config(const gchar *contents, gsize length, GError **error)
+{
+    // Load the key-value file & check the values that can't fall back
+    GKeyFile *keyfile = g_key_file_new();
+    guint mod_bit;
+    if (!g_key_file_load_from_data(keyfile, contents, length, G_KEY_FILE_NONE, error) ||
+            !parse_greeter_mod_bit(keyfile, &mod_bit, error)) {
+        g_key_file_free(keyfile);
+        return NULL;
+    }
+
+    Config *config = malloc(sizeof(Config));
+    if (config == NULL) {
+        g_error("Could not allocate memory for Config");
     }
 
     // Parse values from the keyfile into a Config.
@@ -63,8 +233,34 @@ Config *initialize_config(void)
         keyfile, "greeter", "password-input-width", -1);
     config->show_image_on_all_monitors = parse_greeter_boolean(
         keyfile, "greeter", "show-image-on-all-monitors", FALSE);
+    config->span_background = parse_greeter_boolean(
+        keyfile, "greeter", "span-background", FALSE);
     config->show_sys_info = parse_greeter_boolean(
         keyfile, "greeter", "show-sys-info", FALSE);
+    config->time_format =
+        parse_greeter_string(keyfile, "greeter", "time-format", "%H:%M");
+    config->staged_startup = parse_greeter_boolean(
+        keyfile, "greeter", "staged-startup", FALSE);
+    gint session_start_timeout = parse_greeter_integer(
+        keyfile, "greeter", "session-start-timeout", 30);
+    config->session_start_timeout =
+        session_start_timeout < 0 ? 0 : (guint) session_start_timeout;
+    config->lock_memory = parse_greeter_boolean(
+        keyfile, "greeter", "lock-memory", TRUE);
+    gint idle_timeout = parse_greeter_integer(
+        keyfile, "greeter", "idle-timeout", 0);
+    config->idle_timeout = idle_timeout < 0 ? 0 : (guint) idle_timeout;
+    config->timing_report_file = parse_greeter_string(
+        keyfile, "greeter", "startup-timing-file", "");
+    config->memory_report_file = parse_greeter_string(
+        keyfile, "greeter", "memory-report-file", "");
+    config->auth_metrics_file = parse_greeter_string(
+        keyfile, "greeter", "auth-metrics-file", "");
+    config->show_user_list = parse_greeter_boolean(
+        keyfile, "greeter", "show-user-list", FALSE);
+    gint avatar_size = parse_greeter_integer(
+        keyfile, "greeter-theme", "avatar-size", 64);
+    config->avatar_size = avatar_size < 0 ? 0 : avatar_size;
 
     // Parse Hotkey Settings
     config->suspend_key = parse_greeter_hotkey_keyval(keyfile, "suspend-key", 'u');
@@ -72,22 +268,8 @@ Config *initialize_config(void)
     config->restart_key = parse_greeter_hotkey_keyval(keyfile, "restart-key", 'r');
     config->shutdown_key = parse_greeter_hotkey_keyval(keyfile, "shutdown-key", 's');
     config->session_key = parse_greeter_hotkey_keyval(keyfile, "session-key", 'e');
-    gchar *mod_key =
-        g_key_file_get_string(keyfile, "greeter-hotkeys", "mod-key", NULL);
-    if (mod_key == NULL) {
-        config->mod_bit = GDK_SUPER_MASK;
-    } else {
-        g_strchomp(mod_key);
-        if (strcmp(mod_key, "control") == 0) {
-            config->mod_bit = GDK_CONTROL_MASK;
-        } else if (strcmp(mod_key, "alt") == 0) {
-            config->mod_bit = GDK_MOD1_MASK;
-        } else if (strcmp(mod_key, "meta") == 0) {
-            config->mod_bit = GDK_SUPER_MASK;
-        } else {
-            g_error("Invalid mod-key configuration value: '%s'\n", mod_key);
-        }
-    }
+    config->user_key = parse_greeter_hotkey_keyval(keyfile, "user-key", 'n');
+    config->mod_bit = mod_bit;
 
     // Parse Theme Settings
     // Font
@@ -107,12 +289,20 @@ Config *initialize_config(void)
     config->background_image =
         g_key_file_get_string(keyfile, "greeter-theme", "background-image", NULL);
     if (config->background_image == NULL || strcmp(config->background_image, "") == 0) {
-        config->background_image = (gchar *) "\"\"";
+        g_free(config->background_image);
+        config->background_image = g_strdup("\"\"");
     }
     config->background_color =
         parse_greeter_color_key(keyfile, "background-color", "#1B1D1E");
     config->background_image_size =
         parse_greeter_string(keyfile, "greeter-theme", "background-image-size", "auto");
+    gint background_blur = parse_greeter_integer(
+        keyfile, "greeter-theme", "background-blur", 0);
+    config->background_blur = background_blur < 0 ? 0 : (guint) background_blur;
+    gint background_dim = parse_greeter_integer(
+        keyfile, "greeter-theme", "background-dim", 0);
+    config->background_dim =
+        background_dim < 0 ? 0 : (guint) MIN(background_dim, 100);
     // Window
     config->window_color =
         parse_greeter_color_key(keyfile, "window-color", "#F92672");
@@ -130,7 +320,7 @@ Config *initialize_config(void)
     gchar *temp_password_border_color = g_key_file_get_string(
         keyfile, "greeter-theme", "password-border-color", NULL);
     if (temp_password_border_color == NULL) {
-        config->password_border_color = config->border_color;
+        config->password_border_color = copy_greeter_color(config->border_color);
     } else {
         free(temp_password_border_color);
         config->password_border_color =
@@ -144,8 +334,9 @@ Config *initialize_config(void)
     gchar *temp_sys_info_color = g_key_file_get_string(
         keyfile, "greeter-theme", "sys-info-color", NULL);
     if (temp_sys_info_color == NULL) {
-        config->sys_info_color = config->text_color;
+        config->sys_info_color = copy_greeter_color(config->text_color);
     } else {
+        free(temp_sys_info_color);
         config->sys_info_color = parse_greeter_color_key(
             keyfile, "sys-info-color", "#080800");
     }
@@ -167,37 +358,92 @@ Config *initialize_config(void)
 
     g_key_file_free(keyfile);
 
-    return config;
+    Config *packed_config = pack_config(config);
+    free_parsed_config(config);
+    return packed_config;
 }
 
 
-/* Cleanup any memory allocated for the Config */
-void destroy_config(Config *config)
+/* Copy a Config into a single allocation.
+ *
+ * The block holds the Config, followed by its colors, its password character
+ * & then its strings, so the whole configuration is one contiguous region
+ * that `destroy_config` releases with a single `free`. The source Config is
+ * left untouched.
+ */
+Config *pack_config(const Config *config)
 {
-    free(config->login_user);
-    free(config->font);
-    free(config->font_size);
-    free(config->font_weight);
-    free(config->font_style);
-    free(config->text_color);
-    free(config->error_color);
-    free(config->background_image);
-    free(config->background_color);
-    free(config->background_image_size);
-    free(config->window_color);
-    free(config->border_color);
-    free(config->border_width);
-    free(config->password_label_text);
-    free(config->invalid_password_text);
+    gsize strings_size = 0;
+    for (gsize i = 0; i < G_N_ELEMENTS(config_string_fields); i++) {
+        const gchar *value =
+            G_STRUCT_MEMBER(gchar *, config, config_string_fields[i]);
+        if (value != NULL) {
+            strings_size += strlen(value) + 1;
+        }
+    }
+    gsize arena_size = sizeof(Config) +
+        G_N_ELEMENTS(config_color_fields) * sizeof(GdkRGBA) +
+        sizeof(gunichar) + strings_size;
+
+    Config *packed = malloc(arena_size);
+    if (packed == NULL) {
+        g_error("Could not allocate memory for Config");
+    }
+    *packed = *config;
+
+    GdkRGBA *colors = (GdkRGBA *) (packed + 1);
+    for (gsize i = 0; i < G_N_ELEMENTS(config_color_fields); i++) {
+        const GdkRGBA *color =
+            G_STRUCT_MEMBER(GdkRGBA *, config, config_color_fields[i]);
+        if (color != NULL) {
+            colors[i] = *color;
+            G_STRUCT_MEMBER(GdkRGBA *, packed, config_color_fields[i]) = &colors[i];
+        }
+    }
+
+    gunichar *password_char =
+        (gunichar *) (colors + G_N_ELEMENTS(config_color_fields));
+    if (config->password_char != NULL) {
+        *password_char = *config->password_char;
+        packed->password_char = password_char;
+    }
+
+    gchar *strings = (gchar *) (password_char + 1);
+    for (gsize i = 0; i < G_N_ELEMENTS(config_string_fields); i++) {
+        const gchar *value =
+            G_STRUCT_MEMBER(gchar *, config, config_string_fields[i]);
+        if (value != NULL) {
+            gsize value_size = strlen(value) + 1;
+            memcpy(strings, value, value_size);
+            G_STRUCT_MEMBER(gchar *, packed, config_string_fields[i]) = strings;
+            strings += value_size;
+        }
+    }
+
+    return packed;
+}
+
+
+/* Free a Config whose fields were each allocated separately while parsing */
+static void free_parsed_config(Config *config)
+{
+    for (gsize i = 0; i < G_N_ELEMENTS(config_string_fields); i++) {
+        g_free(G_STRUCT_MEMBER(gchar *, config, config_string_fields[i]));
+    }
+    for (gsize i = 0; i < G_N_ELEMENTS(config_color_fields); i++) {
+        free(G_STRUCT_MEMBER(GdkRGBA *, config, config_color_fields[i]));
+    }
     free(config->password_char);
-    free(config->password_color);
-    free(config->password_background_color);
-    free(config->password_border_color);
-    free(config->password_border_width);
-    free(config->password_border_radius);
-    free(config->sys_info_color);
-    free(config->sys_info_font_size);
-    free(config->sys_info_margin);
+    free(config);
+}
+
+
+/* Cleanup any memory allocated for the Config.
+ *
+ * Configs are always packed into one block, so this is a single `free`.
+ */
+void destroy_config(Config *config)
+{
     free(config);
 }
 
@@ -302,6 +548,48 @@ static GdkRGBA *parse_greeter_color_key(GKeyFile *keyfile, const char *key_name,
     return default_color;
 }
 
+/* Copy a color into a newly-allocated GdkRGBA */
+static GdkRGBA *copy_greeter_color(const GdkRGBA *color)
+{
+    GdkRGBA *copy = malloc(sizeof(GdkRGBA));
+    if (copy == NULL) {
+        g_error("Could not allocate memory for color");
+    }
+    *copy = *color;
+    return copy;
+}
+
+/* Parse the greeter-hotkeys mod-key into a GdkModifierType bit.
+ *
+ * Returns FALSE if the key has an invalid value.
+ */
+static gboolean parse_greeter_mod_bit(GKeyFile *keyfile, guint *mod_bit,
+                                      GError **error)
+{
+    gchar *mod_key =
+        g_key_file_get_string(keyfile, "greeter-hotkeys", "mod-key", NULL);
+    if (mod_key == NULL) {
+        *mod_bit = GDK_SUPER_MASK;
+        return TRUE;
+    }
+
+    gboolean is_valid = TRUE;
+    g_strchomp(mod_key);
+    if (strcmp(mod_key, "control") == 0) {
+        *mod_bit = GDK_CONTROL_MASK;
+    } else if (strcmp(mod_key, "alt") == 0) {
+        *mod_bit = GDK_MOD1_MASK;
+    } else if (strcmp(mod_key, "meta") == 0) {
+        *mod_bit = GDK_SUPER_MASK;
+    } else {
+        g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                    "Invalid mod-key configuration value: '%s'", mod_key);
+        is_valid = FALSE;
+    }
+    g_free(mod_key);
+    return is_valid;
+}
+
 /* Parse a greeter-hotkeys key into the GDKkeyval of it's first character */
 static guint parse_greeter_hotkey_keyval(GKeyFile *keyfile, const char *key_name, const char default_char)
 {
@@ -388,9 +676,9 @@ static gunichar *parse_greeter_password_char(GKeyFile *keyfile)
     return result;
 }
 
-/* Parse the password input alignment, properly handling RTL layouts.
+/* Parse the password input alignment for a left-to-right layout.
  *
- * Note that the gboolean returned by this function is meant to be used with
+ * Note that the gfloat returned by this function is meant to be used with
  * the `gtk_entry_set_alignment` function.
  */
 static gfloat parse_greeter_password_alignment(GKeyFile *keyfile)
@@ -399,14 +687,13 @@ static gfloat parse_greeter_password_alignment(GKeyFile *keyfile)
 
     gchar *password_alignment_text = parse_greeter_string(
         keyfile, "greeter", "password-alignment", "right");
-    gboolean is_rtl = is_rtl_keymap_layout();
 
     if (input_string_equals(password_alignment_text, "left")) {
-        alignment = is_rtl ? 1 : 0;
+        alignment = 0;
     } else if (input_string_equals(password_alignment_text, "center")) {
         alignment = 0.5;
     } else {
-        alignment = is_rtl ? 0 : 1;
+        alignment = 1;
     }
     free(password_alignment_text);
     return alignment;
@@ -10,6 +10,9 @@
 
 
 // Represents the System's Greeter Configuration. Parsed from `CONFIG_FILE`.
+// New fields must also be added to the `CompiledConfig` in config_cache.c, &
+// strings or colors to the field tables in config.c. Every Config is packed
+// into a single allocation by `pack_config`.
 typedef struct Config_ {
     gchar    *login_user;
     gboolean  show_password_label;
@@ -19,7 +22,18 @@ typedef struct Config_ {
     gfloat    password_alignment;
     gint      password_input_width;
     gboolean  show_image_on_all_monitors;
+    gboolean  span_background;
     gboolean  show_sys_info;
+    gchar    *time_format;
+    gboolean  staged_startup;
+    guint     session_start_timeout;
+    guint     idle_timeout;
+    gboolean  lock_memory;
+    gchar    *timing_report_file;
+    gchar    *memory_report_file;
+    gchar    *auth_metrics_file;
+    gboolean  show_user_list;
+    gint      avatar_size;
 
     /* Theme Configuration */
     gchar    *font;
@@ -32,6 +46,8 @@ typedef struct Config_ {
     gchar    *background_image;
     GdkRGBA  *background_color;
     gchar    *background_image_size;
+    guint     background_blur;
+    guint     background_dim;
     GdkRGBA  *window_color;
     GdkRGBA  *border_color;
     gchar    *border_width;
@@ -56,10 +72,15 @@ typedef struct Config_ {
     guint     hibernate_key;
     guint     suspend_key;
     guint     session_key;
+    guint     user_key;
 } Config;
 
 
+const gchar *get_config_file_path(void);
 Config *initialize_config(void);
+Config *load_config(GError **error);
+gboolean compile_config_file(void);
+Config *pack_config(const Config *config);
 void destroy_config(Config *config);
 
 #endif
@@ -0,0 +1,414 @@
+/* Compiled Configuration Cache
+ *
+ * Parsing the configuration file takes dozens of GKeyFile lookups, color
+ * parsing & keyval conversion. The parsed `Config` is instead written to a
+ * compact binary file that later starts map in with a single mmap, as long as
+ * the configuration file's mtime, size & SHA-256 hash still match.
+ *
+ * A compiled file is a fixed-size `CompiledConfig` record followed by a table
+ * of NUL-terminated strings, which the record refers to by offset.
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gdk/gdk.h>
+#include <glib.h>
+
+#include "config_cache.h"
+
+
+#define COMPILED_CONFIG_MAGIC   0x4347434dU  // "MCGC"
+#define COMPILED_CONFIG_VERSION 9U
+// The string offset used for NULL strings
+#define COMPILED_CONFIG_NULL    G_MAXUINT32
+
+// The on-disk form of a `Config`. Bump the version when changing it.
+typedef struct CompiledConfig_ {
+    /* Header */
+    guint32 magic;
+    guint32 version;
+    gint64  source_mtime;
+    gint64  source_size;
+    gchar   source_hash[64];
+    guint32 record_size;
+    guint32 strings_size;
+
+    /* Colors */
+    GdkRGBA text_color;
+    GdkRGBA error_color;
+    GdkRGBA background_color;
+    GdkRGBA window_color;
+    GdkRGBA border_color;
+    GdkRGBA password_color;
+    GdkRGBA password_background_color;
+    GdkRGBA password_border_color;
+    GdkRGBA sys_info_color;
+
+    /* Strings, as offsets into the string table */
+    guint32 login_user;
+    guint32 password_label_text;
+    guint32 invalid_password_text;
+    guint32 timing_report_file;
+    guint32 memory_report_file;
+    guint32 auth_metrics_file;
+    guint32 time_format;
+    guint32 font;
+    guint32 font_size;
+    guint32 font_weight;
+    guint32 font_style;
+    guint32 background_image;
+    guint32 background_image_size;
+    guint32 border_width;
+    guint32 password_border_width;
+    guint32 password_border_radius;
+    guint32 sys_info_font;
+    guint32 sys_info_font_size;
+    guint32 sys_info_margin;
+
+    /* Scalars */
+    guint32 show_password_label;
+    guint32 show_input_cursor;
+    guint32 show_image_on_all_monitors;
+    guint32 show_sys_info;
+    guint32 staged_startup;
+    guint32 session_start_timeout;
+    guint32 idle_timeout;
+    guint32 lock_memory;
+    guint32 show_user_list;
+    gint32  avatar_size;
+    gint32  password_input_width;
+    gfloat  password_alignment;
+    guint32 layout_spacing;
+    guint32 has_password_char;
+    guint32 password_char;
+    guint32 mod_bit;
+    guint32 shutdown_key;
+    guint32 restart_key;
+    guint32 hibernate_key;
+    guint32 suspend_key;
+    guint32 session_key;
+    guint32 user_key;
+    guint32 span_background;
+    guint32 background_blur;
+    guint32 background_dim;
+} CompiledConfig;
+// The record is written as-is, so keep it free of padding
+_Static_assert(sizeof(CompiledConfig) == 560, "CompiledConfig is padded");
+
+static guint32 add_string(GString *strings, const gchar *value);
+static gchar *get_string(const gchar *strings, guint32 strings_size, guint32 offset,
+                         gboolean *valid);
+
+
+/* Record the mtime, size & hash of a configuration file's contents */
+void identify_config_source(ConfigSource *source, const gchar *config_path,
+                            const gchar *contents, gsize length)
+{
+    struct stat config_stat;
+    if (stat(config_path, &config_stat) == 0) {
+        source->mtime = (gint64) config_stat.st_mtim.tv_sec * G_USEC_PER_SEC +
+                        config_stat.st_mtim.tv_nsec / 1000;
+    } else {
+        source->mtime = 0;
+    }
+    source->size = (gint64) length;
+
+    gchar *hash = g_compute_checksum_for_data(
+        G_CHECKSUM_SHA256, (const guchar *) contents, length);
+    memcpy(source->hash, hash, sizeof(source->hash));
+    g_free(hash);
+}
+
+
+/* Get the path of the compiled config that packaging places next to the
+ * configuration file with `--compile-config`.
+ */
+gchar *get_compiled_config_path(const gchar *config_path)
+{
+    return g_strconcat(config_path, ".cache", NULL);
+}
+
+
+/* Get the path of the compiled config the greeter writes for itself, since
+ * it usually can't write next to the configuration file.
+ */
+gchar *get_user_compiled_config_path(const gchar *config_path)
+{
+    gchar *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, config_path, -1);
+    gchar *file_name = g_strconcat(hash, ".config", NULL);
+    gchar *compiled_path = g_build_filename(
+        g_get_user_cache_dir(), "lightdm-mini-greeter", file_name, NULL);
+
+    g_free(file_name);
+    g_free(hash);
+    return compiled_path;
+}
+
+
+/* Load a compiled config, if it exists & was compiled from the source.
+ *
+ * Returns NULL if the file is missing, stale or invalid.
+ */
+Config *load_compiled_config(const gchar *compiled_path, const ConfigSource *source)
+{
+    int fd = open(compiled_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat compiled_stat;
+    if (fstat(fd, &compiled_stat) != 0 ||
+            (gsize) compiled_stat.st_size < sizeof(CompiledConfig)) {
+        close(fd);
+        return NULL;
+    }
+    gsize file_length = (gsize) compiled_stat.st_size;
+    void *mapping = mmap(NULL, file_length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return NULL;
+    }
+
+    const CompiledConfig *compiled = mapping;
+    gboolean is_current =
+        compiled->magic == COMPILED_CONFIG_MAGIC &&
+        compiled->version == COMPILED_CONFIG_VERSION &&
+        compiled->record_size == sizeof(CompiledConfig) &&
+        compiled->strings_size == file_length - sizeof(CompiledConfig) &&
+        compiled->source_mtime == source->mtime &&
+        compiled->source_size == source->size &&
+        memcmp(compiled->source_hash, source->hash, sizeof(source->hash)) == 0;
+    if (!is_current) {
+        munmap(mapping, file_length);
+        return NULL;
+    }
+
+    // Point a Config into the mapping, then pack it into its own block
+    Config mapped_config;
+    Config *config = &mapped_config;
+    const gchar *strings = (const gchar *) mapping + sizeof(CompiledConfig);
+    guint32 strings_size = compiled->strings_size;
+    gboolean valid = TRUE;
+
+    config->login_user =
+        get_string(strings, strings_size, compiled->login_user, &valid);
+    config->password_label_text =
+        get_string(strings, strings_size, compiled->password_label_text, &valid);
+    config->invalid_password_text =
+        get_string(strings, strings_size, compiled->invalid_password_text, &valid);
+    config->timing_report_file =
+        get_string(strings, strings_size, compiled->timing_report_file, &valid);
+    config->memory_report_file =
+        get_string(strings, strings_size, compiled->memory_report_file, &valid);
+    config->auth_metrics_file =
+        get_string(strings, strings_size, compiled->auth_metrics_file, &valid);
+    config->time_format =
+        get_string(strings, strings_size, compiled->time_format, &valid);
+    config->font = get_string(strings, strings_size, compiled->font, &valid);
+    config->font_size = get_string(strings, strings_size, compiled->font_size, &valid);
+    config->font_weight = get_string(strings, strings_size, compiled->font_weight, &valid);
+    config->font_style = get_string(strings, strings_size, compiled->font_style, &valid);
+    config->background_image =
+        get_string(strings, strings_size, compiled->background_image, &valid);
+    config->background_image_size =
+        get_string(strings, strings_size, compiled->background_image_size, &valid);
+    config->border_width =
+        get_string(strings, strings_size, compiled->border_width, &valid);
+    config->password_border_width =
+        get_string(strings, strings_size, compiled->password_border_width, &valid);
+    config->password_border_radius =
+        get_string(strings, strings_size, compiled->password_border_radius, &valid);
+    config->sys_info_font =
+        get_string(strings, strings_size, compiled->sys_info_font, &valid);
+    config->sys_info_font_size =
+        get_string(strings, strings_size, compiled->sys_info_font_size, &valid);
+    config->sys_info_margin =
+        get_string(strings, strings_size, compiled->sys_info_margin, &valid);
+
+    config->text_color = (GdkRGBA *) &compiled->text_color;
+    config->error_color = (GdkRGBA *) &compiled->error_color;
+    config->background_color = (GdkRGBA *) &compiled->background_color;
+    config->window_color = (GdkRGBA *) &compiled->window_color;
+    config->border_color = (GdkRGBA *) &compiled->border_color;
+    config->password_color = (GdkRGBA *) &compiled->password_color;
+    config->password_background_color = (GdkRGBA *) &compiled->password_background_color;
+    config->password_border_color = (GdkRGBA *) &compiled->password_border_color;
+    config->sys_info_color = (GdkRGBA *) &compiled->sys_info_color;
+
+    config->show_password_label = compiled->show_password_label != 0;
+    config->show_input_cursor = compiled->show_input_cursor != 0;
+    config->show_image_on_all_monitors = compiled->show_image_on_all_monitors != 0;
+    config->span_background = compiled->span_background != 0;
+    config->show_sys_info = compiled->show_sys_info != 0;
+    config->staged_startup = compiled->staged_startup != 0;
+    config->session_start_timeout = compiled->session_start_timeout;
+    config->idle_timeout = compiled->idle_timeout;
+    config->lock_memory = compiled->lock_memory != 0;
+    config->show_user_list = compiled->show_user_list != 0;
+    config->avatar_size = compiled->avatar_size;
+    config->password_input_width = compiled->password_input_width;
+    config->password_alignment = compiled->password_alignment;
+    config->layout_spacing = compiled->layout_spacing;
+    config->background_blur = compiled->background_blur;
+    config->background_dim = compiled->background_dim;
+    gunichar password_char = compiled->password_char;
+    if (compiled->has_password_char != 0) {
+        config->password_char = &password_char;
+    } else {
+        config->password_char = NULL;
+    }
+    config->mod_bit = compiled->mod_bit;
+    config->shutdown_key = compiled->shutdown_key;
+    config->restart_key = compiled->restart_key;
+    config->hibernate_key = compiled->hibernate_key;
+    config->suspend_key = compiled->suspend_key;
+    config->session_key = compiled->session_key;
+    config->user_key = compiled->user_key;
+
+    if (!valid || config->login_user == NULL) {
+        g_warning("Ignoring invalid compiled configuration: %s", compiled_path);
+        munmap(mapping, file_length);
+        return NULL;
+    }
+    Config *packed_config = pack_config(config);
+    munmap(mapping, file_length);
+    return packed_config;
+}
+
+
+/* Write a parsed config to a compiled config file.
+ *
+ * The file is replaced atomically, so a greeter starting at the same time
+ * never maps a partial file.
+ */
+gboolean write_compiled_config(const gchar *compiled_path, const ConfigSource *source,
+                               const Config *config)
+{
+    CompiledConfig compiled;
+    memset(&compiled, 0, sizeof(compiled));
+    compiled.magic = COMPILED_CONFIG_MAGIC;
+    compiled.version = COMPILED_CONFIG_VERSION;
+    compiled.source_mtime = source->mtime;
+    compiled.source_size = source->size;
+    memcpy(compiled.source_hash, source->hash, sizeof(compiled.source_hash));
+    compiled.record_size = sizeof(CompiledConfig);
+
+    compiled.text_color = *config->text_color;
+    compiled.error_color = *config->error_color;
+    compiled.background_color = *config->background_color;
+    compiled.window_color = *config->window_color;
+    compiled.border_color = *config->border_color;
+    compiled.password_color = *config->password_color;
+    compiled.password_background_color = *config->password_background_color;
+    compiled.password_border_color = *config->password_border_color;
+    compiled.sys_info_color = *config->sys_info_color;
+
+    GString *strings = g_string_new(NULL);
+    compiled.login_user = add_string(strings, config->login_user);
+    compiled.password_label_text = add_string(strings, config->password_label_text);
+    compiled.invalid_password_text = add_string(strings, config->invalid_password_text);
+    compiled.timing_report_file = add_string(strings, config->timing_report_file);
+    compiled.memory_report_file = add_string(strings, config->memory_report_file);
+    compiled.auth_metrics_file = add_string(strings, config->auth_metrics_file);
+    compiled.time_format = add_string(strings, config->time_format);
+    compiled.font = add_string(strings, config->font);
+    compiled.font_size = add_string(strings, config->font_size);
+    compiled.font_weight = add_string(strings, config->font_weight);
+    compiled.font_style = add_string(strings, config->font_style);
+    compiled.background_image = add_string(strings, config->background_image);
+    compiled.background_image_size = add_string(strings, config->background_image_size);
+    compiled.border_width = add_string(strings, config->border_width);
+    compiled.password_border_width = add_string(strings, config->password_border_width);
+    compiled.password_border_radius = add_string(strings, config->password_border_radius);
+    compiled.sys_info_font = add_string(strings, config->sys_info_font);
+    compiled.sys_info_font_size = add_string(strings, config->sys_info_font_size);
+    compiled.sys_info_margin = add_string(strings, config->sys_info_margin);
+    compiled.strings_size = (guint32) strings->len;
+
+    compiled.show_password_label = config->show_password_label ? 1 : 0;
+    compiled.show_input_cursor = config->show_input_cursor ? 1 : 0;
+    compiled.show_image_on_all_monitors = config->show_image_on_all_monitors ? 1 : 0;
+    compiled.span_background = config->span_background ? 1 : 0;
+    compiled.show_sys_info = config->show_sys_info ? 1 : 0;
+    compiled.staged_startup = config->staged_startup ? 1 : 0;
+    compiled.session_start_timeout = config->session_start_timeout;
+    compiled.idle_timeout = config->idle_timeout;
+    compiled.lock_memory = config->lock_memory ? 1 : 0;
+    compiled.show_user_list = config->show_user_list ? 1 : 0;
+    compiled.avatar_size = config->avatar_size;
+    compiled.password_input_width = config->password_input_width;
+    compiled.password_alignment = config->password_alignment;
+    compiled.layout_spacing = config->layout_spacing;
+    compiled.background_blur = config->background_blur;
+    compiled.background_dim = config->background_dim;
+    if (config->password_char != NULL) {
+        compiled.has_password_char = 1;
+        compiled.password_char = *config->password_char;
+    }
+    compiled.mod_bit = config->mod_bit;
+    compiled.shutdown_key = config->shutdown_key;
+    compiled.restart_key = config->restart_key;
+    compiled.hibernate_key = config->hibernate_key;
+    compiled.suspend_key = config->suspend_key;
+    compiled.session_key = config->session_key;
+    compiled.user_key = config->user_key;
+
+    g_string_prepend_len(strings, (const gchar *) &compiled, sizeof(compiled));
+
+    gboolean written = FALSE;
+    gchar *compiled_dir = g_path_get_dirname(compiled_path);
+    GError *write_error = NULL;
+    if (g_mkdir_with_parents(compiled_dir, 0700) != 0) {
+        g_warning("Could not create compiled configuration directory: %s",
+                  compiled_dir);
+    } else if (!g_file_set_contents(compiled_path, strings->str,
+                                    (gssize) strings->len, &write_error)) {
+        g_warning("Could not write compiled configuration to %s: %s",
+                  compiled_path, write_error->message);
+        g_error_free(write_error);
+    } else {
+        written = TRUE;
+    }
+
+    g_free(compiled_dir);
+    g_string_free(strings, TRUE);
+    return written;
+}
+
+
+/* Append a string to the string table, returning its offset */
+static guint32 add_string(GString *strings, const gchar *value)
+{
+    if (value == NULL) {
+        return COMPILED_CONFIG_NULL;
+    }
+    guint32 offset = (guint32) strings->len;
+    g_string_append_len(strings, value, (gssize) strlen(value) + 1);
+    return offset;
+}
+
+
+/* Find a string in the mapped string table.
+ *
+ * The string is not copied, so it's only valid while the table is mapped.
+ * `valid` is cleared if the offset is out of bounds or the string isn't
+ * terminated within the table.
+ */
+static gchar *get_string(const gchar *strings, guint32 strings_size, guint32 offset,
+                         gboolean *valid)
+{
+    if (offset == COMPILED_CONFIG_NULL) {
+        return NULL;
+    }
+    if (offset >= strings_size ||
+            memchr(strings + offset, '\0', strings_size - offset) == NULL) {
+        *valid = FALSE;
+        return NULL;
+    }
+    return (gchar *) strings + offset;
+}
+
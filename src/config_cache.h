@@ -0,0 +1,26 @@
+#ifndef CONFIG_CACHE_H
+#define CONFIG_CACHE_H
+
+#include <glib.h>
+
+#include "config.h"
+
+
+// Identifies the exact contents of a configuration file
+typedef struct ConfigSource_ {
+    gint64  mtime;
+    gint64  size;
+    // Hex SHA-256 of the file's contents, without a terminating NUL
+    gchar   hash[64];
+} ConfigSource;
+
+
+void identify_config_source(ConfigSource *source, const gchar *config_path,
+                            const gchar *contents, gsize length);
+gchar *get_compiled_config_path(const gchar *config_path);
+gchar *get_user_compiled_config_path(const gchar *config_path);
+Config *load_compiled_config(const gchar *compiled_path, const ConfigSource *source);
+gboolean write_compiled_config(const gchar *compiled_path, const ConfigSource *source,
+                               const Config *config);
+
+#endif
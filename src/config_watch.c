@@ -0,0 +1,109 @@
+/* Configuration File Watching
+ *
+ * The configuration file is watched for changes, & re-loaded once a burst of
+ * changes settles, since editors often write a file in several steps. A file
+ * that can't be parsed is ignored, leaving the current Config in place.
+ */
+#include <stdlib.h>
+
+#include <gio/gio.h>
+#include <glib.h>
+
+#include "config.h"
+#include "config_watch.h"
+
+
+// Let a burst of writes to the file settle before reloading it
+#define CONFIG_RELOAD_DELAY_MS 250
+
+static void handle_config_file_change(GFileMonitor *monitor, GFile *file,
+                                      GFile *other_file, GFileMonitorEvent event,
+                                      gpointer user_data);
+static gboolean handle_config_reload(gpointer user_data);
+
+
+/* Watch the configuration file, calling the changed function with each newly
+ * loaded Config.
+ */
+ConfigWatch *initialize_config_watch(ConfigChangedFunc changed_func,
+                                     gpointer user_data)
+{
+    ConfigWatch *watch = malloc(sizeof(ConfigWatch));
+    if (watch == NULL) {
+        g_error("Could not allocate memory for ConfigWatch");
+    }
+    watch->reload_timeout_id = 0;
+    watch->changed_func = changed_func;
+    watch->user_data = user_data;
+
+    const gchar *config_path = get_config_file_path();
+    GFile *config_file = g_file_new_for_path(config_path);
+    GError *monitor_error = NULL;
+    // Editors that save by renaming a new file over the old one are followed
+    watch->monitor = g_file_monitor_file(
+        config_file, G_FILE_MONITOR_WATCH_MOVES, NULL, &monitor_error);
+    if (watch->monitor == NULL) {
+        g_warning("Could not watch %s for changes: %s",
+                  config_path, monitor_error->message);
+        g_error_free(monitor_error);
+    } else {
+        g_signal_connect(watch->monitor, "changed",
+                         G_CALLBACK(handle_config_file_change), watch);
+    }
+    g_object_unref(config_file);
+
+    return watch;
+}
+
+
+/* Stop watching the configuration file */
+void destroy_config_watch(ConfigWatch *watch)
+{
+    if (watch->reload_timeout_id != 0) {
+        g_source_remove(watch->reload_timeout_id);
+    }
+    if (watch->monitor != NULL) {
+        g_file_monitor_cancel(watch->monitor);
+        g_object_unref(watch->monitor);
+    }
+    free(watch);
+}
+
+
+/* Schedule a reload when the configuration file changes */
+static void handle_config_file_change(GFileMonitor *monitor, GFile *file,
+                                      GFile *other_file, GFileMonitorEvent event,
+                                      gpointer user_data)
+{
+    ConfigWatch *watch = user_data;
+    if (event == G_FILE_MONITOR_EVENT_DELETED ||
+            event == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED) {
+        return;
+    }
+    if (watch->reload_timeout_id != 0) {
+        g_source_remove(watch->reload_timeout_id);
+    }
+    watch->reload_timeout_id =
+        g_timeout_add(CONFIG_RELOAD_DELAY_MS, handle_config_reload, watch);
+}
+
+
+/* Load the changed configuration file & pass it on */
+static gboolean handle_config_reload(gpointer user_data)
+{
+    ConfigWatch *watch = user_data;
+    watch->reload_timeout_id = 0;
+
+    GError *load_error = NULL;
+    Config *config = load_config(&load_error);
+    if (config == NULL) {
+        g_warning("Keeping the current configuration, could not load the new one: %s",
+                  load_error->message);
+        g_error_free(load_error);
+    } else {
+        g_message("Reloading the configuration");
+        watch->changed_func(config, watch->user_data);
+    }
+
+    return G_SOURCE_REMOVE;
+}
@@ -0,0 +1,26 @@
+#ifndef CONFIG_WATCH_H
+#define CONFIG_WATCH_H
+
+#include <gio/gio.h>
+#include <glib.h>
+
+#include "config.h"
+
+
+// Called with a newly loaded Config, which the function takes ownership of
+typedef void (*ConfigChangedFunc)(Config *config, gpointer user_data);
+
+// Reloads the configuration file whenever it changes
+typedef struct ConfigWatch_ {
+    GFileMonitor      *monitor;
+    guint              reload_timeout_id;
+    ConfigChangedFunc  changed_func;
+    gpointer           user_data;
+} ConfigWatch;
+
+
+ConfigWatch *initialize_config_watch(ConfigChangedFunc changed_func,
+                                     gpointer user_data);
+void destroy_config_watch(ConfigWatch *watch);
+
+#endif
@@ -1,105 +1,164 @@
 /* Functions related to a ring of focusable items */
+#include <stdlib.h>
 
 #include "focus_ring.h"
 
-static gint find_by_value(gconstpointer data, gconstpointer user_data);
 
-
-/* Initialize the FocusRing with the given options, value getter, & label
+/* Initialize an empty FocusRing with the given value getter, item destructor,
+ * & label. Items are added with `focus_ring_append`.
  *
- * Returns NULL if the passed GList is NULL.
  * Throws an error if cannot allocate memory for the FocusRing.
  */
-FocusRing *initialize_focus_ring(const GList *options, gchar *(*getter_function)(gconstpointer), const gchar *const label)
+FocusRing *initialize_focus_ring(FocusRingValueFunc value_function,
+                                 GDestroyNotify item_free_function,
+                                 const gchar *const label)
 {
-    if (options == NULL) {
-        return NULL;
-    }
-
     FocusRing *ring = malloc(sizeof(FocusRing));
     if (ring == NULL) {
         g_error("Could not allocate memory for FocusRing: %s", label);
     }
 
-    ring->selected = options;
-    ring->beginning = options;
-    ring->end = g_list_last((GList *) options);
-
-    ring->getter_function = getter_function;
+    ring->entries = g_array_new(FALSE, FALSE, sizeof(FocusRingEntry));
+    ring->selected = 0;
+    ring->index = g_hash_table_new(g_str_hash, g_str_equal);
+    ring->value_function = value_function;
+    ring->item_free_function = item_free_function;
+    ring->label = g_strdup(label);
 
     return ring;
 }
 
-/* Free only the FocusRing & not the underlying GList */
+/* Free the FocusRing, along with every item it holds */
 void destroy_focus_ring(FocusRing *ring)
 {
+    focus_ring_clear(ring);
+    g_hash_table_destroy(ring->index);
+    g_array_free(ring->entries, TRUE);
+    g_free(ring->label);
     free(ring);
 }
 
+/* Remove & free every item, keeping the ring so it can be refilled in place */
+void focus_ring_clear(FocusRing *ring)
+{
+    g_hash_table_remove_all(ring->index);
+    for (guint i = 0; i < ring->entries->len; i++) {
+        FocusRingEntry *entry = &g_array_index(ring->entries, FocusRingEntry, i);
+        if (ring->item_free_function != NULL) {
+            ring->item_free_function(entry->item);
+        }
+        g_free(entry->value);
+    }
+    g_array_set_size(ring->entries, 0);
+    ring->selected = 0;
+}
+
+/* Add an item to the end of the ring, which takes ownership of it.
+ *
+ * If another item has the same value, lookups by value still find the first.
+ */
+void focus_ring_append(FocusRing *ring, gpointer item)
+{
+    FocusRingEntry entry;
+    entry.item = item;
+    entry.value = g_strdup(ring->value_function(item));
+    g_array_append_val(ring->entries, entry);
+
+    if (entry.value == NULL) {
+        g_warning("Ignoring %s item without a value", ring->label);
+    } else if (!g_hash_table_contains(ring->index, entry.value)) {
+        g_hash_table_insert(ring->index, entry.value,
+                            GUINT_TO_POINTER(ring->entries->len));
+    }
+}
+
+/* Get the number of items in the ring. */
+guint focus_ring_get_length(const FocusRing *ring)
+{
+    return ring->entries->len;
+}
+
 /* Focus the next item in the ring, or loop back to the first item. */
-gchar *focus_ring_next(FocusRing *ring)
+const gchar *focus_ring_next(FocusRing *ring)
 {
-    if (ring->selected->next == NULL) {
-        ring->selected = ring->beginning;
-    } else {
-        ring->selected = ring->selected->next;
+    if (ring->entries->len == 0) {
+        return NULL;
     }
+    ring->selected = (ring->selected + 1) % ring->entries->len;
     return focus_ring_get_value(ring);
 }
 
 /* Focus the previous item in the ring, or loop back to the last item. */
-gchar *focus_ring_prev(FocusRing *ring)
+const gchar *focus_ring_prev(FocusRing *ring)
 {
-    if (ring->selected->prev == NULL) {
-        ring->selected = ring->end;
+    if (ring->entries->len == 0) {
+        return NULL;
+    }
+    if (ring->selected == 0) {
+        ring->selected = ring->entries->len - 1;
     } else {
-        ring->selected = ring->selected->prev;
+        ring->selected--;
     }
     return focus_ring_get_value(ring);
 }
 
-/* Get the currently selected data. */
-gconstpointer focus_ring_get_selected(FocusRing *ring)
+/* Get the position of the currently selected item. */
+guint focus_ring_get_index(const FocusRing *ring)
 {
-    return ring->selected->data;
+    return ring->selected;
 }
 
-/* Get the inner value of the currently selected item. */
-gchar *focus_ring_get_value(FocusRing *ring)
+/* Focus the item at the given position.
+ *
+ * Does nothing if the position is out of bounds.
+ */
+const gchar *focus_ring_select_index(FocusRing *ring, guint index)
 {
-    return ring->getter_function(focus_ring_get_selected(ring));
+    if (index < ring->entries->len) {
+        ring->selected = index;
+    }
+    return focus_ring_get_value(ring);
 }
 
+/* Get the currently selected item, or NULL if the ring is empty. */
+gpointer focus_ring_get_selected(const FocusRing *ring)
+{
+    if (ring->entries->len == 0) {
+        return NULL;
+    }
+    return g_array_index(ring->entries, FocusRingEntry, ring->selected).item;
+}
 
-/* Internal data used by the find_by_value & focus_ring_scroll_to_value
- * functions.
- */
-struct FindByValueData {
-    FocusRing *ring;
-    const gchar *target_value;
-};
+/* Get the item at the given position, or NULL if it's out of bounds. */
+gpointer focus_ring_get_item(const FocusRing *ring, guint index)
+{
+    if (index >= ring->entries->len) {
+        return NULL;
+    }
+    return g_array_index(ring->entries, FocusRingEntry, index).item;
+}
 
-/* Attempt to scroll the ring to the item with the matching inner value.
- *
- * Does nothing if the item cannot be found.
- */
-gchar *focus_ring_scroll_to_value(FocusRing *ring, const gchar *target_value)
+/* Get the inner value of the currently selected item. */
+const gchar *focus_ring_get_value(const FocusRing *ring)
 {
-    struct FindByValueData user_data = { .ring = ring, .target_value = target_value };
-    GList *find_result = g_list_find_custom((GList *) ring->beginning, (void *) &user_data, &find_by_value);
-    if (find_result != NULL) {
-        ring->selected = find_result;
+    if (ring->entries->len == 0) {
+        return NULL;
     }
-    return focus_ring_get_value(ring);
+    return g_array_index(ring->entries, FocusRingEntry, ring->selected).value;
 }
 
-/* Determine if the given data's inner value matches what we're looking for.
+/* Attempt to scroll the ring to the item with the matching inner value.
  *
- * Used as callback to the g_list_find_custom function.
+ * Does nothing if the item cannot be found.
  */
-static gint find_by_value(gconstpointer data, gconstpointer user_data)
+const gchar *focus_ring_scroll_to_value(FocusRing *ring, const gchar *target_value)
 {
-    struct FindByValueData *local_user_data = (struct FindByValueData *) user_data;
-
-    return g_strcmp0(local_user_data->ring->getter_function(data), local_user_data->target_value);
+    if (target_value != NULL) {
+        guint position =
+            GPOINTER_TO_UINT(g_hash_table_lookup(ring->index, target_value));
+        if (position != 0) {
+            ring->selected = position - 1;
+        }
+    }
+    return focus_ring_get_value(ring);
 }
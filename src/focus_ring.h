@@ -4,28 +4,53 @@
 #include <gdk/gdk.h>
 
 
+// Returns the "inner value" of an item, used to look items up & display them
+typedef const gchar *(*FocusRingValueFunc)(gconstpointer item);
+
+// An item in a FocusRing, along with its cached inner value
+typedef struct FocusRingEntry_ {
+    gpointer  item;
+    gchar    *value;
+} FocusRingEntry;
+
 /* A FocusRing is an scrollable list that wraps around to the beginning/end
  * when the selection is moved out-of-bounds.
+ *
+ * The ring owns its items, which are stored in a contiguous array with their
+ * values, so moving the selection is O(1) & looking up an item by its value
+ * is a single hash table lookup.
  */
 typedef struct FocusRing_ {
-    /* Points to current selection */
-    const GList *selected;
-    /* Points to beginning of list */
-    const GList *beginning;
-    /* Points to end of list */
-    const GList *end;
-
-    /* Function to retrieve the target "inner value" from the GList's data */
-    gchar *(*getter_function)(gconstpointer);
+    /* The FocusRingEntry of every item, in order */
+    GArray             *entries;
+    /* Index of the current selection */
+    guint               selected;
+    /* Maps an item's value to its index + 1 */
+    GHashTable         *index;
+
+    /* Function to retrieve the "inner value" of an item */
+    FocusRingValueFunc  value_function;
+    /* Frees an item when it's removed from the ring, may be NULL */
+    GDestroyNotify      item_free_function;
+    /* Names the ring's items in log messages */
+    gchar              *label;
 } FocusRing;
 
-FocusRing *initialize_focus_ring(const GList *options, gchar *(*getter_function)(gconstpointer), const gchar *const label);
+FocusRing *initialize_focus_ring(FocusRingValueFunc value_function,
+                                 GDestroyNotify item_free_function,
+                                 const gchar *const label);
 void destroy_focus_ring(FocusRing *ring);
 
-gchar *focus_ring_next(FocusRing *ring);
-gchar *focus_ring_prev(FocusRing *ring);
-gconstpointer focus_ring_get_selected(FocusRing *ring);
-gchar *focus_ring_get_value(FocusRing *ring);
-gchar *focus_ring_scroll_to_value(FocusRing *ring, const gchar *target_value);
+void focus_ring_clear(FocusRing *ring);
+void focus_ring_append(FocusRing *ring, gpointer item);
+guint focus_ring_get_length(const FocusRing *ring);
+const gchar *focus_ring_next(FocusRing *ring);
+const gchar *focus_ring_prev(FocusRing *ring);
+guint focus_ring_get_index(const FocusRing *ring);
+const gchar *focus_ring_select_index(FocusRing *ring, guint index);
+gpointer focus_ring_get_selected(const FocusRing *ring);
+gpointer focus_ring_get_item(const FocusRing *ring, guint index);
+const gchar *focus_ring_get_value(const FocusRing *ring);
+const gchar *focus_ring_scroll_to_value(FocusRing *ring, const gchar *target_value);
 
 #endif
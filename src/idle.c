@@ -0,0 +1,183 @@
+/* Idle Power Mode
+ *
+ * When no keys have been pressed for the `idle_timeout`, the greeter blanks
+ * its windows, powers off the displays with DPMS when available & stops the
+ * clock, leaving nothing that wakes it periodically. The next key press
+ * restores everything before the key is handled, so it isn't lost.
+ */
+#include <gtk/gtk.h>
+#include <glib.h>
+
+#include "defines.h"
+#ifdef GDK_WINDOWING_X11
+#include <gdk/gdkx.h>
+#endif
+#ifdef HAVE_DPMS
+#include <X11/extensions/dpms.h>
+#endif
+
+#include "app.h"
+#include "clock.h"
+#include "idle.h"
+
+
+static gboolean handle_idle_timeout(App *app);
+static void restart_idle_timer(App *app);
+static void set_windows_blank(App *app, gboolean blank);
+static void set_window_blank(GtkWidget *window, gboolean blank);
+static void set_displays_powered(gboolean powered);
+
+#ifdef HAVE_DPMS
+// Whether we enabled DPMS ourselves & should disable it again on waking
+static gboolean dpms_enabled_by_idle = FALSE;
+#endif
+
+
+/* Start counting down to idle mode, if an idle timeout is configured */
+void initialize_idle_timer(App *app)
+{
+    app->idle_timeout_id = 0;
+    app->is_idle = FALSE;
+    restart_idle_timer(app);
+}
+
+
+/* Note that the user is active, leaving idle mode if we are in it.
+ *
+ * Returns TRUE if the greeter was idle.
+ */
+gboolean wake_from_idle(App *app)
+{
+    gboolean was_idle = app->is_idle;
+    if (was_idle) {
+        g_message("Waking from idle mode");
+        app->is_idle = FALSE;
+        set_displays_powered(TRUE);
+        set_windows_blank(app, FALSE);
+        if (app->clock != NULL) {
+            clock_start(app->clock);
+        }
+    }
+    restart_idle_timer(app);
+
+    return was_idle;
+}
+
+
+/* Restart the countdown with the current `idle_timeout`, e.g. after the
+ * config is reloaded. Does nothing while idle, the next key press restarts it.
+ */
+void reset_idle_timer(App *app)
+{
+    if (!app->is_idle) {
+        restart_idle_timer(app);
+    }
+}
+
+
+/* Enter idle mode once the timeout expires without any key presses */
+static gboolean handle_idle_timeout(App *app)
+{
+    g_message("Entering idle mode");
+    app->idle_timeout_id = 0;
+    app->is_idle = TRUE;
+    if (app->clock != NULL) {
+        clock_stop(app->clock);
+    }
+    set_windows_blank(app, TRUE);
+    set_displays_powered(FALSE);
+
+    return G_SOURCE_REMOVE;
+}
+
+
+/* Reset the countdown to idle mode */
+static void restart_idle_timer(App *app)
+{
+    if (app->idle_timeout_id != 0) {
+        g_source_remove(app->idle_timeout_id);
+        app->idle_timeout_id = 0;
+    }
+    if (app->config->idle_timeout > 0) {
+        app->idle_timeout_id = g_timeout_add_seconds(
+            app->config->idle_timeout, G_SOURCE_FUNC(handle_idle_timeout), app);
+    }
+}
+
+
+/* Blank or restore the background & main windows.
+ *
+ * The main window stays mapped & focused, so the key press that wakes us
+ * still reaches the password input.
+ */
+static void set_windows_blank(App *app, gboolean blank)
+{
+    for (int m = 0; m < APP_MONITOR_COUNT(app); m++) {
+        GtkWidget *background_window = GTK_WIDGET(APP_BACKGROUND_WINDOWS(app)[m]);
+        set_window_blank(background_window, blank);
+        gtk_widget_queue_draw(background_window);
+    }
+    set_window_blank(GTK_WIDGET(APP_MAIN_WINDOW(app)), blank);
+}
+
+
+/* Blank a window created after entering idle mode, e.g. for a new monitor */
+void set_window_idle_state(App *app, GtkWidget *window)
+{
+    set_window_blank(window, app->is_idle);
+}
+
+
+/* Add or remove the `idle` class that hides a window's contents */
+static void set_window_blank(GtkWidget *window, gboolean blank)
+{
+    GtkStyleContext *style_context = gtk_widget_get_style_context(window);
+    if (blank) {
+        gtk_style_context_add_class(style_context, "idle");
+    } else {
+        gtk_style_context_remove_class(style_context, "idle");
+    }
+}
+
+
+/* Turn the displays off or back on using the X11 DPMS extension.
+ *
+ * Does nothing if DPMS isn't supported, leaving the displays blanked.
+ */
+static void set_displays_powered(gboolean powered)
+{
+#if defined(HAVE_DPMS) && defined(GDK_WINDOWING_X11)
+    GdkDisplay *display = gdk_display_get_default();
+    if (!GDK_IS_X11_DISPLAY(display)) {
+        return;
+    }
+    Display *xdisplay = gdk_x11_display_get_xdisplay(display);
+    int event_base, error_base;
+    if (!DPMSQueryExtension(xdisplay, &event_base, &error_base) ||
+            !DPMSCapable(xdisplay)) {
+        return;
+    }
+
+    gdk_x11_display_error_trap_push(display);
+    if (powered) {
+        DPMSForceLevel(xdisplay, DPMSModeOn);
+        if (dpms_enabled_by_idle) {
+            DPMSDisable(xdisplay);
+            dpms_enabled_by_idle = FALSE;
+        }
+    } else {
+        // Forcing a power level fails unless DPMS is enabled
+        CARD16 power_level;
+        BOOL dpms_enabled;
+        DPMSInfo(xdisplay, &power_level, &dpms_enabled);
+        if (!dpms_enabled) {
+            DPMSEnable(xdisplay);
+            dpms_enabled_by_idle = TRUE;
+        }
+        DPMSForceLevel(xdisplay, DPMSModeOff);
+    }
+    gdk_x11_display_error_trap_pop_ignored(display);
+#else
+    (void) powered;
+#endif
+}
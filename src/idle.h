@@ -0,0 +1,15 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+#include "app.h"
+
+
+void initialize_idle_timer(App *app);
+gboolean wake_from_idle(App *app);
+void reset_idle_timer(App *app);
+void set_window_idle_state(App *app, GtkWidget *window);
+
+#endif
@@ -0,0 +1,1015 @@
+/* Background Image Scaling & Effects
+ *
+ * Scales an 8-bit RGB or RGBA image onto a cairo ARGB32 surface, converting
+ * it to premultiplied alpha on the way. This replaces painting the pixbuf
+ * through cairo, which converts the whole source image & then filters it on
+ * a single core.
+ *
+ * Scaling is separable: each source row is premultiplied & filtered
+ * horizontally into a row of 16-bit values, then the destination rows are
+ * blended from those. Downscaling averages the area each destination pixel
+ * covers, upscaling is bilinear. Every kernel uses the same fixed-point math,
+ * so the SSE2 & AVX2 versions give exactly the same pixels as the scalar
+ * ones. The kernels are picked at runtime, & the destination can be split
+ * into bands of rows that are scaled on separate threads.
+ *
+ * Scaled images can then be blurred, with three passes of a box blur in each
+ * direction approximating a gaussian one, & dimmed.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "image_scale.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IMAGE_SCALE_X86 1
+#include <immintrin.h>
+#endif
+
+
+// Weights are fixed-point, with 14 fractional bits
+#define WEIGHT_BITS         14
+#define WEIGHT_ONE          (1 << WEIGHT_BITS)
+// Filtered rows keep 7 fractional bits, so an 8-bit channel fits in a gint16
+#define ROW_FRACTION_BITS   7
+#define ROW_SHIFT           (WEIGHT_BITS - ROW_FRACTION_BITS)
+#define BLEND_SHIFT         (WEIGHT_BITS + ROW_FRACTION_BITS)
+// Don't start a thread for fewer rows or columns than this
+#define MIN_BAND_ROWS       64
+#define MIN_BAND_COLUMNS    64
+#define MAX_THREADS         8
+// Three box blurs are close to a gaussian one
+#define BLUR_PASSES         3
+
+// The source pixels & weights that make up each destination pixel on an axis
+typedef struct Contributions_ {
+    /* The destination pixels covered by the image */
+    gint    start;
+    gint    count;
+    /* The number of source pixels, & weights, for every destination pixel */
+    gint    taps;
+    /* The first source pixel of each destination pixel. There are always
+     * `taps` source pixels after it, the unused ones are weighted zero */
+    gint   *first;
+    gint16 *weights;
+} Contributions;
+
+// The kernels for one instruction set
+typedef struct KernelTable_ {
+    void (*convert_row)(const guint8 *source, gint channels, gint width,
+                        guint8 *bgra);
+    void (*filter_row)(const guint8 *bgra, const Contributions *columns,
+                       gint16 *filtered);
+    void (*blend_rows)(const gint16 *const *rows, const gint16 *weights,
+                       gint row_count, gint width, guint32 *destination);
+    void (*blur_row)(guint8 *row, guint8 *original, gint width, gint radius);
+    void (*accumulate_row)(guint16 *sums, const guint8 *added,
+                           const guint8 *removed, gint length);
+    void (*average_row)(const guint16 *sums, gint length, gint radius,
+                        guint8 *row);
+} KernelTable;
+
+// The destination rows scaled by one thread
+typedef struct ScaleBand_ {
+    const ImageSource   *source;
+    const Contributions *columns;
+    const Contributions *rows;
+    const KernelTable   *kernels;
+    guint8              *destination;
+    gint                 stride;
+    /* Indexes into `rows`, the last is exclusive */
+    gint                 first_row;
+    gint                 last_row;
+} ScaleBand;
+
+// The rows or columns of an image blurred by one thread
+typedef struct BlurBand_ {
+    guint8            *pixels;
+    gint               width;
+    gint               height;
+    gint               stride;
+    gint               radius;
+    const KernelTable *kernels;
+    /* Rows for horizontal passes, columns for vertical ones. The last is
+     * exclusive */
+    gint               first;
+    gint               last;
+} BlurBand;
+
+static void compute_contributions(Contributions *contributions, gint source_size,
+                                  gint destination_size, gdouble scale,
+                                  gdouble offset);
+static void free_contributions(Contributions *contributions);
+static guint count_bands(guint thread_count, gint length, gint min_band_length);
+static void run_bands(GThreadFunc band_func, gpointer bands, gsize band_size,
+                      guint band_count);
+static gpointer scale_band(gpointer data);
+static gpointer blur_rows_band(gpointer data);
+static gpointer blur_columns_band(gpointer data);
+static guint32 get_box_reciprocal(gint radius);
+static guint8 premultiply(guint32 channel, guint32 alpha);
+static void convert_row_scalar(const guint8 *source, gint channels, gint width,
+                               guint8 *bgra);
+static void filter_row_scalar(const guint8 *bgra, const Contributions *columns,
+                              gint16 *filtered);
+static void blend_rows_scalar(const gint16 *const *rows, const gint16 *weights,
+                              gint row_count, gint width, guint32 *destination);
+static guint32 blend_pixel(const gint16 *const *rows, const gint16 *weights,
+                           gint row_count, gint x);
+static void blur_row_scalar(guint8 *row, guint8 *original, gint width, gint radius);
+static void accumulate_row_scalar(guint16 *sums, const guint8 *added,
+                                  const guint8 *removed, gint length);
+static void average_row_scalar(const guint16 *sums, gint length, gint radius,
+                               guint8 *row);
+#ifdef IMAGE_SCALE_X86
+static void convert_row_sse2(const guint8 *source, gint channels, gint width,
+                             guint8 *bgra);
+static void filter_row_sse2(const guint8 *bgra, const Contributions *columns,
+                            gint16 *filtered);
+static void blend_rows_sse2(const gint16 *const *rows, const gint16 *weights,
+                            gint row_count, gint width, guint32 *destination);
+static void blur_row_sse2(guint8 *row, guint8 *original, gint width, gint radius);
+static void accumulate_row_sse2(guint16 *sums, const guint8 *added,
+                                const guint8 *removed, gint length);
+static void average_row_sse2(const guint16 *sums, gint length, gint radius,
+                             guint8 *row);
+static void convert_row_avx2(const guint8 *source, gint channels, gint width,
+                             guint8 *bgra);
+static void blend_rows_avx2(const gint16 *const *rows, const gint16 *weights,
+                            gint row_count, gint width, guint32 *destination);
+static void accumulate_row_avx2(guint16 *sums, const guint8 *added,
+                                const guint8 *removed, gint length);
+static void average_row_avx2(const guint16 *sums, gint length, gint radius,
+                             guint8 *row);
+#endif
+
+static const KernelTable kernel_tables[IMAGE_KERNELS_COUNT] = {
+    [IMAGE_KERNELS_SCALAR] = {
+        convert_row_scalar, filter_row_scalar, blend_rows_scalar,
+        blur_row_scalar, accumulate_row_scalar, average_row_scalar },
+#ifdef IMAGE_SCALE_X86
+    [IMAGE_KERNELS_SSE2] = {
+        convert_row_sse2, filter_row_sse2, blend_rows_sse2,
+        blur_row_sse2, accumulate_row_sse2, average_row_sse2 },
+    // Kernels working a pixel at a time don't gain from wider registers
+    [IMAGE_KERNELS_AVX2] = {
+        convert_row_avx2, filter_row_sse2, blend_rows_avx2,
+        blur_row_sse2, accumulate_row_avx2, average_row_avx2 },
+#else
+    [IMAGE_KERNELS_SSE2] = {
+        convert_row_scalar, filter_row_scalar, blend_rows_scalar,
+        blur_row_scalar, accumulate_row_scalar, average_row_scalar },
+    [IMAGE_KERNELS_AVX2] = {
+        convert_row_scalar, filter_row_scalar, blend_rows_scalar,
+        blur_row_scalar, accumulate_row_scalar, average_row_scalar },
+#endif
+};
+
+static const gchar *kernel_names[IMAGE_KERNELS_COUNT] = {
+    [IMAGE_KERNELS_SCALAR] = "scalar",
+    [IMAGE_KERNELS_SSE2] = "sse2",
+    [IMAGE_KERNELS_AVX2] = "avx2",
+};
+
+
+/* Determine the fastest kernels this CPU can run */
+ImageKernels image_kernels_detect(void)
+{
+#ifdef IMAGE_SCALE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return IMAGE_KERNELS_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return IMAGE_KERNELS_SSE2;
+    }
+#endif
+    return IMAGE_KERNELS_SCALAR;
+}
+
+
+/* Determine if this CPU can run the given kernels. Every instruction set
+ * includes the ones before it.
+ */
+gboolean image_kernels_supported(ImageKernels kernels)
+{
+    return kernels <= image_kernels_detect();
+}
+
+
+/* Get the name of an instruction set, e.g. for logging */
+const gchar *image_kernels_name(ImageKernels kernels)
+{
+    return kernel_names[kernels];
+}
+
+
+/* Scale an image onto a cairo ARGB32 surface's pixels.
+ *
+ * Destination pixels outside the placed image are left untouched, so start
+ * with a cleared surface. A `thread_count` of 0 uses a thread per processor.
+ */
+void image_scale_to_argb(const ImageSource *source, const ImagePlacement *placement,
+                         guint8 *destination, gint width, gint height, gint stride,
+                         ImageKernels kernels, guint thread_count)
+{
+    if (source->width <= 0 || source->height <= 0 || placement->scale <= 0) {
+        return;
+    }
+    Contributions columns, rows;
+    compute_contributions(&columns, source->width, width, placement->scale,
+                          placement->x);
+    compute_contributions(&rows, source->height, height, placement->scale,
+                          placement->y);
+    if (columns.count == 0 || rows.count == 0) {
+        free_contributions(&columns);
+        free_contributions(&rows);
+        return;
+    }
+
+    guint band_count = count_bands(thread_count, rows.count, MIN_BAND_ROWS);
+    ScaleBand bands[MAX_THREADS];
+    for (guint b = 0; b < band_count; b++) {
+        bands[b].source = source;
+        bands[b].columns = &columns;
+        bands[b].rows = &rows;
+        bands[b].kernels = &kernel_tables[kernels];
+        bands[b].destination = destination;
+        bands[b].stride = stride;
+        bands[b].first_row = (gint) ((guint) rows.count * b / band_count);
+        bands[b].last_row = (gint) ((guint) rows.count * (b + 1) / band_count);
+    }
+    run_bands(scale_band, bands, sizeof(ScaleBand), band_count);
+
+    free_contributions(&columns);
+    free_contributions(&rows);
+}
+
+
+/* Blur a cairo ARGB32 surface's pixels in place.
+ *
+ * The radius is that of each box blur pass, & may be at most
+ * `IMAGE_BLUR_MAX_RADIUS`. A `thread_count` of 0 uses a thread per processor.
+ */
+void image_blur_argb(guint8 *pixels, gint width, gint height, gint stride,
+                     gint radius, ImageKernels kernels, guint thread_count)
+{
+    radius = MIN(radius, IMAGE_BLUR_MAX_RADIUS);
+    if (radius <= 0 || width <= 0 || height <= 0) {
+        return;
+    }
+    BlurBand bands[MAX_THREADS];
+    BlurBand blur = {
+        pixels, width, height, stride, radius, &kernel_tables[kernels], 0, 0
+    };
+
+    // Rows are blurred horizontally, then columns vertically
+    guint band_count = count_bands(thread_count, height, MIN_BAND_ROWS);
+    for (guint b = 0; b < band_count; b++) {
+        bands[b] = blur;
+        bands[b].first = (gint) ((guint) height * b / band_count);
+        bands[b].last = (gint) ((guint) height * (b + 1) / band_count);
+    }
+    run_bands(blur_rows_band, bands, sizeof(BlurBand), band_count);
+
+    band_count = count_bands(thread_count, width, MIN_BAND_COLUMNS);
+    for (guint b = 0; b < band_count; b++) {
+        bands[b] = blur;
+        bands[b].first = (gint) ((guint) width * b / band_count);
+        bands[b].last = (gint) ((guint) width * (b + 1) / band_count);
+    }
+    run_bands(blur_columns_band, bands, sizeof(BlurBand), band_count);
+}
+
+
+/* Darken a cairo ARGB32 surface's pixels in place, keeping their alpha.
+ *
+ * A brightness of 255 leaves the pixels unchanged & 0 makes them black.
+ */
+void image_dim_argb(guint8 *pixels, gint width, gint height, gint stride,
+                    guint8 brightness)
+{
+    for (gint y = 0; y < height; y++) {
+        guint32 *row = (guint32 *) (void *) &pixels[(gsize) y * (gsize) stride];
+        for (gint x = 0; x < width; x++) {
+            guint32 pixel = row[x];
+            guint32 dimmed = pixel & 0xff000000U;
+            for (gint c = 0; c < 24; c += 8) {
+                dimmed |= (guint32) premultiply((pixel >> c) & 0xff, brightness) << c;
+            }
+            row[x] = dimmed;
+        }
+    }
+}
+
+
+/* Split work of the given length into bands for up to `thread_count`
+ * threads, or a thread per processor if it's 0.
+ */
+static guint count_bands(guint thread_count, gint length, gint min_band_length)
+{
+    if (thread_count == 0) {
+        thread_count = g_get_num_processors();
+    }
+    guint band_count = MIN(thread_count, MAX_THREADS);
+    band_count = MIN(band_count, (guint) (length / min_band_length));
+    return MAX(band_count, 1);
+}
+
+
+/* Run a function on every band, each on its own thread.
+ *
+ * The first band runs on this thread while the others do, & this returns
+ * once they've all finished.
+ */
+static void run_bands(GThreadFunc band_func, gpointer bands, gsize band_size,
+                      guint band_count)
+{
+    GThread *threads[MAX_THREADS];
+    for (guint b = 1; b < band_count; b++) {
+        gpointer band = (guint8 *) bands + band_size * b;
+        threads[b] = g_thread_try_new("background-image", band_func, band, NULL);
+        if (threads[b] == NULL) {
+            // e.g. locked memory has no room for another stack
+            band_func(band);
+        }
+    }
+    band_func(bands);
+    for (guint b = 1; b < band_count; b++) {
+        if (threads[b] != NULL) {
+            g_thread_join(threads[b]);
+        }
+    }
+}
+
+
+/* Work out which source pixels make up each destination pixel along an axis.
+ *
+ * A destination pixel is covered if its center lands on the scaled image.
+ * Downscaled pixels average the source area they cover, upscaled pixels
+ * interpolate between the two nearest source pixels.
+ */
+static void compute_contributions(Contributions *contributions, gint source_size,
+                                  gint destination_size, gdouble scale,
+                                  gdouble offset)
+{
+    gdouble start = ceil(offset - 0.5);
+    gdouble end = ceil(offset + source_size * scale - 0.5);
+    contributions->start = (gint) CLAMP(start, 0, destination_size);
+    contributions->count =
+        (gint) CLAMP(end, 0, destination_size) - contributions->start;
+    contributions->count = MAX(contributions->count, 0);
+
+    gboolean downscaling = scale < 1.0;
+    gdouble support = downscaling ? 0.5 / scale : 1.0;
+    gint taps = downscaling ? (gint) ceil(support * 2) + 1 : 2;
+    taps = MIN(taps, source_size);
+    contributions->taps = taps;
+    contributions->first = g_new(gint, (gsize) MAX(contributions->count, 1));
+    contributions->weights = g_new0(
+        gint16, (gsize) MAX(contributions->count, 1) * (gsize) taps);
+
+    gdouble *tap_weights = g_new(gdouble, (gsize) taps);
+    for (gint d = 0; d < contributions->count; d++) {
+        gdouble center =
+            (contributions->start + d + 0.5 - offset) / scale;
+        gint low, high;
+        if (downscaling) {
+            low = (gint) floor(center - support);
+            high = (gint) ceil(center + support) - 1;
+        } else {
+            low = (gint) floor(center - 0.5);
+            high = low + 1;
+        }
+        gint last = source_size - 1;
+        low = MIN(MAX(low, 0), last);
+        high = MIN(MAX(high, 0), last);
+        // Keep every tap inside the image, so kernels never check bounds
+        gint first = MIN(low, source_size - taps);
+        contributions->first[d] = first;
+
+        gdouble total = 0;
+        for (gint t = 0; t < taps; t++) {
+            tap_weights[t] = 0;
+        }
+        for (gint s = low; s <= high; s++) {
+            gdouble weight;
+            if (downscaling) {
+                weight = MIN(s + 1, center + support) - MAX(s, center - support);
+            } else {
+                weight = 1.0 - fabs(center - 0.5 - s);
+            }
+            if (weight > 0) {
+                tap_weights[s - first] += weight;
+                total += weight;
+            }
+        }
+
+        // Round to fixed-point, giving any rounding error to the heaviest tap
+        gint16 *weights = &contributions->weights[d * taps];
+        gint fixed_total = 0;
+        gint heaviest = 0;
+        for (gint t = 0; t < taps; t++) {
+            gint weight = total > 0
+                ? (gint) lround(tap_weights[t] / total * WEIGHT_ONE)
+                : (t == 0 ? WEIGHT_ONE : 0);
+            weights[t] = (gint16) weight;
+            fixed_total += weight;
+            if (weights[t] > weights[heaviest]) {
+                heaviest = t;
+            }
+        }
+        weights[heaviest] = (gint16) (weights[heaviest] + WEIGHT_ONE - fixed_total);
+    }
+    g_free(tap_weights);
+}
+
+
+/* Free the arrays of an axis' contributions */
+static void free_contributions(Contributions *contributions)
+{
+    g_free(contributions->first);
+    g_free(contributions->weights);
+}
+
+
+/* Scale a band of destination rows.
+ *
+ * Neighbouring destination rows share most of their source rows, so the
+ * filtered source rows are kept in a ring with a slot for every tap.
+ */
+static gpointer scale_band(gpointer data)
+{
+    const ScaleBand *band = data;
+    const ImageSource *source = band->source;
+    const Contributions *columns = band->columns;
+    const Contributions *rows = band->rows;
+    gint taps = rows->taps;
+    gsize filtered_length = (gsize) columns->count * 4;
+
+    // One spare pixel lets the kernels read taps in pairs
+    guint8 *bgra = g_malloc0(((gsize) source->width + 1) * 4);
+    gint16 *ring = g_new(gint16, filtered_length * (gsize) taps);
+    gint *ring_rows = g_new(gint, (gsize) taps);
+    const gint16 **row_pointers = g_new(const gint16 *, (gsize) taps);
+    for (gint t = 0; t < taps; t++) {
+        ring_rows[t] = -1;
+    }
+
+    for (gint r = band->first_row; r < band->last_row; r++) {
+        for (gint t = 0; t < taps; t++) {
+            gint source_row = rows->first[r] + t;
+            gint slot = source_row % taps;
+            gint16 *filtered = &ring[filtered_length * (gsize) slot];
+            if (ring_rows[slot] != source_row) {
+                band->kernels->convert_row(
+                    &source->pixels[(gsize) source_row * (gsize) source->rowstride],
+                    source->channels, source->width, bgra);
+                band->kernels->filter_row(bgra, columns, filtered);
+                ring_rows[slot] = source_row;
+            }
+            row_pointers[t] = filtered;
+        }
+        guint8 *destination_row = band->destination +
+            (gsize) (rows->start + r) * (gsize) band->stride +
+            (gsize) columns->start * 4;
+        band->kernels->blend_rows(row_pointers, &rows->weights[r * taps], taps,
+                                  columns->count,
+                                  (guint32 *) (void *) destination_row);
+    }
+
+    g_free(row_pointers);
+    g_free(ring_rows);
+    g_free(ring);
+    g_free(bgra);
+    return NULL;
+}
+
+
+/* Blur a band of rows horizontally, with every pass */
+static gpointer blur_rows_band(gpointer data)
+{
+    const BlurBand *band = data;
+    guint8 *original = g_malloc((gsize) band->width * 4);
+    for (gint y = band->first; y < band->last; y++) {
+        guint8 *row = &band->pixels[(gsize) y * (gsize) band->stride];
+        for (gint pass = 0; pass < BLUR_PASSES; pass++) {
+            band->kernels->blur_row(row, original, band->width, band->radius);
+        }
+    }
+    g_free(original);
+    return NULL;
+}
+
+
+/* Blur a band of columns vertically, with every pass.
+ *
+ * Each column's sliding sum is kept for the whole band, so a pass is one
+ * addition & subtraction per pixel. Rows are blurred in place, so the
+ * original rows still leaving the window are kept in a ring.
+ */
+static gpointer blur_columns_band(gpointer data)
+{
+    const BlurBand *band = data;
+    gint radius = band->radius;
+    gint length = (band->last - band->first) * 4;
+    guint16 *sums = g_new(guint16, (gsize) length);
+    guint8 *ring = g_malloc((gsize) (radius + 1) * (gsize) length);
+    guint8 *band_start = &band->pixels[(gsize) band->first * 4];
+    gsize stride = (gsize) band->stride;
+    gint last_row = band->height - 1;
+
+    for (gint pass = 0; pass < BLUR_PASSES; pass++) {
+        // The window starts centered on the first row, repeating it above
+        for (gint i = 0; i < length; i++) {
+            gint sum = (radius + 1) * band_start[i];
+            for (gint k = 1; k <= radius; k++) {
+                sum += band_start[(gsize) MIN(k, last_row) * stride + (gsize) i];
+            }
+            sums[i] = (guint16) sum;
+        }
+        for (gint y = 0; y <= last_row; y++) {
+            guint8 *row = &band_start[(gsize) y * stride];
+            memcpy(&ring[(gsize) (y % (radius + 1)) * (gsize) length], row,
+                   (gsize) length);
+            band->kernels->average_row(sums, length, radius, row);
+            if (y < last_row) {
+                const guint8 *added =
+                    &band_start[(gsize) MIN(y + radius + 1, last_row) * stride];
+                const guint8 *removed =
+                    &ring[(gsize) (MAX(y - radius, 0) % (radius + 1)) * (gsize) length];
+                band->kernels->accumulate_row(sums, added, removed, length);
+            }
+        }
+    }
+
+    g_free(ring);
+    g_free(sums);
+    return NULL;
+}
+
+
+/* Get the fixed-point reciprocal of a box's size, rounded up so a box of
+ * full channels averages to a full channel.
+ */
+static guint32 get_box_reciprocal(gint radius)
+{
+    guint32 size = (guint32) (radius * 2 + 1);
+    return (65536 + size - 1) / size;
+}
+
+
+/* Premultiply an 8-bit channel by an 8-bit alpha, rounding to nearest */
+static guint8 premultiply(guint32 channel, guint32 alpha)
+{
+    guint32 product = channel * alpha + 128;
+    return (guint8) ((product + (product >> 8)) >> 8);
+}
+
+
+/* Convert a row of RGB or RGBA pixels to premultiplied BGRA */
+static void convert_row_scalar(const guint8 *source, gint channels, gint width,
+                               guint8 *bgra)
+{
+    for (gint x = 0; x < width; x++) {
+        const guint8 *pixel = &source[x * channels];
+        guint8 *converted = &bgra[x * 4];
+        if (channels == 4) {
+            converted[0] = premultiply(pixel[2], pixel[3]);
+            converted[1] = premultiply(pixel[1], pixel[3]);
+            converted[2] = premultiply(pixel[0], pixel[3]);
+            converted[3] = pixel[3];
+        } else {
+            converted[0] = pixel[2];
+            converted[1] = pixel[1];
+            converted[2] = pixel[0];
+            converted[3] = 255;
+        }
+    }
+}
+
+
+/* Filter a premultiplied row down or up to the destination's width */
+static void filter_row_scalar(const guint8 *bgra, const Contributions *columns,
+                              gint16 *filtered)
+{
+    for (gint d = 0; d < columns->count; d++) {
+        const guint8 *pixels = &bgra[columns->first[d] * 4];
+        const gint16 *weights = &columns->weights[d * columns->taps];
+        for (gint c = 0; c < 4; c++) {
+            gint32 sum = 0;
+            for (gint t = 0; t < columns->taps; t++) {
+                sum += pixels[t * 4 + c] * weights[t];
+            }
+            filtered[d * 4 + c] =
+                (gint16) ((sum + (1 << (ROW_SHIFT - 1))) >> ROW_SHIFT);
+        }
+    }
+}
+
+
+/* Blend filtered rows into a row of cairo ARGB32 pixels */
+static void blend_rows_scalar(const gint16 *const *rows, const gint16 *weights,
+                              gint row_count, gint width, guint32 *destination)
+{
+    for (gint x = 0; x < width; x++) {
+        destination[x] = blend_pixel(rows, weights, row_count, x);
+    }
+}
+
+
+/* Blend a single pixel of the filtered rows, also used for SIMD tails */
+static guint32 blend_pixel(const gint16 *const *rows, const gint16 *weights,
+                           gint row_count, gint x)
+{
+    guint32 pixel = 0;
+    for (gint c = 0; c < 4; c++) {
+        gint32 sum = 0;
+        for (gint t = 0; t < row_count; t++) {
+            sum += rows[t][x * 4 + c] * weights[t];
+        }
+        gint32 channel = (sum + (1 << (BLEND_SHIFT - 1))) >> BLEND_SHIFT;
+        pixel |= (guint32) CLAMP(channel, 0, 255) << (c * 8);
+    }
+    return pixel;
+}
+
+
+/* Box blur a row of premultiplied pixels in place */
+static void blur_row_scalar(guint8 *row, guint8 *original, gint width, gint radius)
+{
+    memcpy(original, row, (gsize) width * 4);
+    guint32 reciprocal = get_box_reciprocal(radius);
+    gint last = width - 1;
+    for (gint c = 0; c < 4; c++) {
+        // The window starts centered on the first pixel, repeating it
+        guint32 sum = (guint32) (radius + 1) * original[c];
+        for (gint k = 1; k <= radius; k++) {
+            sum += original[MIN(k, last) * 4 + c];
+        }
+        for (gint x = 0; x < width; x++) {
+            guint32 average = ((sum + (guint32) radius) * reciprocal) >> 16;
+            row[x * 4 + c] = (guint8) MIN(average, 255);
+            sum += original[MIN(x + radius + 1, last) * 4 + c];
+            sum -= original[MAX(x - radius, 0) * 4 + c];
+        }
+    }
+}
+
+
+/* Slide a row of sums down, adding a row's channels & removing another's */
+static void accumulate_row_scalar(guint16 *sums, const guint8 *added,
+                                  const guint8 *removed, gint length)
+{
+    for (gint i = 0; i < length; i++) {
+        sums[i] = (guint16) (sums[i] + added[i] - removed[i]);
+    }
+}
+
+
+/* Average a row of box sums into channels */
+static void average_row_scalar(const guint16 *sums, gint length, gint radius,
+                               guint8 *row)
+{
+    guint32 reciprocal = get_box_reciprocal(radius);
+    for (gint i = 0; i < length; i++) {
+        guint32 average = ((sums[i] + (guint32) radius) * reciprocal) >> 16;
+        row[i] = (guint8) MIN(average, 255);
+    }
+}
+
+
+#ifdef IMAGE_SCALE_X86
+
+/* Pack two weights for `madd`, which multiplies & sums interleaved pairs */
+#define WEIGHT_PAIR(first, second) \
+    ((gint32) (((guint32) (guint16) (second) << 16) | (guint16) (first)))
+
+
+/* Premultiply two RGBA pixels of 16-bit lanes & swap them to BGRA */
+__attribute__((target("sse2")))
+static inline __m128i premultiply_pair_sse2(__m128i rgba)
+{
+    const __m128i alpha_lanes = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    const __m128i color_lanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    // Alpha is multiplied by 255, which the division by 255 undoes
+    __m128i alpha = _mm_shufflehi_epi16(
+        _mm_shufflelo_epi16(rgba, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm_or_si128(_mm_and_si128(alpha, color_lanes), alpha_lanes);
+    __m128i bgra = _mm_shufflehi_epi16(
+        _mm_shufflelo_epi16(rgba, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+    __m128i product = _mm_add_epi16(_mm_mullo_epi16(bgra, alpha), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+}
+
+
+/* Convert a row to premultiplied BGRA, four RGBA pixels at a time */
+__attribute__((target("sse2")))
+static void convert_row_sse2(const guint8 *source, gint channels, gint width,
+                             guint8 *bgra)
+{
+    if (channels != 4) {
+        // Opaque pixels only need their bytes swapped
+        convert_row_scalar(source, channels, width, bgra);
+        return;
+    }
+    const __m128i zero = _mm_setzero_si128();
+    gint vector_width = width - width % 4;
+    gint x = 0;
+    for (; x < vector_width; x += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *) (const void *) &source[x * 4]);
+        __m128i low = premultiply_pair_sse2(_mm_unpacklo_epi8(pixels, zero));
+        __m128i high = premultiply_pair_sse2(_mm_unpackhi_epi8(pixels, zero));
+        _mm_storeu_si128((__m128i *) (void *) &bgra[x * 4], _mm_packus_epi16(low, high));
+    }
+    convert_row_scalar(&source[x * 4], channels, width - x, &bgra[x * 4]);
+}
+
+
+/* Filter a row, two taps of all four channels at a time */
+__attribute__((target("sse2")))
+static void filter_row_sse2(const guint8 *bgra, const Contributions *columns,
+                            gint16 *filtered)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi32(1 << (ROW_SHIFT - 1));
+    gint taps = columns->taps;
+    for (gint d = 0; d < columns->count; d++) {
+        const guint8 *pixels = &bgra[columns->first[d] * 4];
+        const gint16 *weights = &columns->weights[d * taps];
+        __m128i sum = zero;
+        for (gint t = 0; t < taps; t += 2) {
+            // An odd last tap reads one pixel past it, with a zero weight
+            __m128i pair = _mm_unpacklo_epi8(
+                _mm_loadl_epi64((const __m128i *) (const void *) &pixels[t * 4]), zero);
+            pair = _mm_unpacklo_epi16(pair, _mm_srli_si128(pair, 8));
+            gint16 second = t + 1 < taps ? weights[t + 1] : 0;
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(
+                pair, _mm_set1_epi32(WEIGHT_PAIR(weights[t], second))));
+        }
+        sum = _mm_srai_epi32(_mm_add_epi32(sum, rounding), ROW_SHIFT);
+        _mm_storel_epi64((__m128i *) (void *) &filtered[d * 4], _mm_packs_epi32(sum, sum));
+    }
+}
+
+
+/* Blend filtered rows, two rows of four pixels at a time */
+__attribute__((target("sse2")))
+static void blend_rows_sse2(const gint16 *const *rows, const gint16 *weights,
+                            gint row_count, gint width, guint32 *destination)
+{
+    const __m128i rounding = _mm_set1_epi32(1 << (BLEND_SHIFT - 1));
+    gint vector_width = width - width % 4;
+    gint x = 0;
+    for (; x < vector_width; x += 4) {
+        __m128i sums[4] = {
+            _mm_setzero_si128(), _mm_setzero_si128(),
+            _mm_setzero_si128(), _mm_setzero_si128()
+        };
+        for (gint t = 0; t < row_count; t += 2) {
+            // An odd last row is paired with itself, with a zero weight
+            const gint16 *first = &rows[t][x * 4];
+            const gint16 *second = t + 1 < row_count ? &rows[t + 1][x * 4] : first;
+            __m128i weight_pair = _mm_set1_epi32(WEIGHT_PAIR(
+                weights[t], t + 1 < row_count ? weights[t + 1] : 0));
+            for (gint half = 0; half < 2; half++) {
+                __m128i a = _mm_loadu_si128(
+                    (const __m128i *) (const void *) &first[half * 8]);
+                __m128i b = _mm_loadu_si128(
+                    (const __m128i *) (const void *) &second[half * 8]);
+                sums[half * 2] = _mm_add_epi32(sums[half * 2],
+                    _mm_madd_epi16(_mm_unpacklo_epi16(a, b), weight_pair));
+                sums[half * 2 + 1] = _mm_add_epi32(sums[half * 2 + 1],
+                    _mm_madd_epi16(_mm_unpackhi_epi16(a, b), weight_pair));
+            }
+        }
+        for (gint p = 0; p < 4; p++) {
+            sums[p] = _mm_srai_epi32(_mm_add_epi32(sums[p], rounding), BLEND_SHIFT);
+        }
+        __m128i pixels = _mm_packus_epi16(_mm_packs_epi32(sums[0], sums[1]),
+                                          _mm_packs_epi32(sums[2], sums[3]));
+        _mm_storeu_si128((__m128i *) (void *) &destination[x], pixels);
+    }
+    for (; x < width; x++) {
+        destination[x] = blend_pixel(rows, weights, row_count, x);
+    }
+}
+
+
+/* Load a pixel's channels into the low 16-bit lanes */
+__attribute__((target("sse2")))
+static inline __m128i load_pixel_sse2(const guint8 *pixel)
+{
+    gint32 channels;
+    memcpy(&channels, pixel, sizeof(channels));
+    return _mm_unpacklo_epi8(_mm_cvtsi32_si128(channels), _mm_setzero_si128());
+}
+
+
+/* Box blur a row, all four channels of a pixel at a time */
+__attribute__((target("sse2")))
+static void blur_row_sse2(guint8 *row, guint8 *original, gint width, gint radius)
+{
+    memcpy(original, row, (gsize) width * 4);
+    const __m128i reciprocal = _mm_set1_epi16((gint16) get_box_reciprocal(radius));
+    const __m128i rounding = _mm_set1_epi16((gint16) radius);
+    gint last = width - 1;
+
+    __m128i sum = _mm_mullo_epi16(load_pixel_sse2(original),
+                                  _mm_set1_epi16((gint16) (radius + 1)));
+    for (gint k = 1; k <= radius; k++) {
+        sum = _mm_add_epi16(sum, load_pixel_sse2(&original[MIN(k, last) * 4]));
+    }
+    for (gint x = 0; x < width; x++) {
+        __m128i average = _mm_mulhi_epu16(_mm_add_epi16(sum, rounding), reciprocal);
+        gint32 channels = _mm_cvtsi128_si32(_mm_packus_epi16(average, average));
+        memcpy(&row[x * 4], &channels, sizeof(channels));
+        sum = _mm_add_epi16(sum, load_pixel_sse2(&original[MIN(x + radius + 1, last) * 4]));
+        sum = _mm_sub_epi16(sum, load_pixel_sse2(&original[MAX(x - radius, 0) * 4]));
+    }
+}
+
+
+/* Slide a row of sums down, sixteen channels at a time */
+__attribute__((target("sse2")))
+static void accumulate_row_sse2(guint16 *sums, const guint8 *added,
+                                const guint8 *removed, gint length)
+{
+    const __m128i zero = _mm_setzero_si128();
+    gint vector_length = length - length % 16;
+    gint i = 0;
+    for (; i < vector_length; i += 16) {
+        __m128i add = _mm_loadu_si128((const __m128i *) (const void *) &added[i]);
+        __m128i remove = _mm_loadu_si128((const __m128i *) (const void *) &removed[i]);
+        for (gint half = 0; half < 2; half++) {
+            __m128i *sum = (__m128i *) (void *) &sums[i + half * 8];
+            __m128i add_half = half == 0 ? _mm_unpacklo_epi8(add, zero)
+                                         : _mm_unpackhi_epi8(add, zero);
+            __m128i remove_half = half == 0 ? _mm_unpacklo_epi8(remove, zero)
+                                            : _mm_unpackhi_epi8(remove, zero);
+            _mm_storeu_si128(sum, _mm_sub_epi16(
+                _mm_add_epi16(_mm_loadu_si128(sum), add_half), remove_half));
+        }
+    }
+    accumulate_row_scalar(&sums[i], &added[i], &removed[i], length - i);
+}
+
+
+/* Average a row of box sums, sixteen channels at a time */
+__attribute__((target("sse2")))
+static void average_row_sse2(const guint16 *sums, gint length, gint radius,
+                             guint8 *row)
+{
+    const __m128i reciprocal = _mm_set1_epi16((gint16) get_box_reciprocal(radius));
+    const __m128i rounding = _mm_set1_epi16((gint16) radius);
+    gint vector_length = length - length % 16;
+    gint i = 0;
+    for (; i < vector_length; i += 16) {
+        __m128i low = _mm_loadu_si128((const __m128i *) (const void *) &sums[i]);
+        __m128i high = _mm_loadu_si128((const __m128i *) (const void *) &sums[i + 8]);
+        low = _mm_mulhi_epu16(_mm_add_epi16(low, rounding), reciprocal);
+        high = _mm_mulhi_epu16(_mm_add_epi16(high, rounding), reciprocal);
+        _mm_storeu_si128((__m128i *) (void *) &row[i], _mm_packus_epi16(low, high));
+    }
+    average_row_scalar(&sums[i], length - i, radius, &row[i]);
+}
+
+
+/* Premultiply four RGBA pixels of 16-bit lanes & swap them to BGRA */
+__attribute__((target("avx2")))
+static inline __m256i premultiply_pair_avx2(__m256i rgba)
+{
+    const __m256i alpha_lanes = _mm256_set_epi16(
+        255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+    const __m256i color_lanes = _mm256_set_epi16(
+        0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1);
+    __m256i alpha = _mm256_shufflehi_epi16(
+        _mm256_shufflelo_epi16(rgba, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm256_or_si256(_mm256_and_si256(alpha, color_lanes), alpha_lanes);
+    __m256i bgra = _mm256_shufflehi_epi16(
+        _mm256_shufflelo_epi16(rgba, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+    __m256i product = _mm256_add_epi16(_mm256_mullo_epi16(bgra, alpha),
+                                       _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(
+        _mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+}
+
+
+/* Convert a row to premultiplied BGRA, eight RGBA pixels at a time */
+__attribute__((target("avx2")))
+static void convert_row_avx2(const guint8 *source, gint channels, gint width,
+                             guint8 *bgra)
+{
+    if (channels != 4) {
+        convert_row_scalar(source, channels, width, bgra);
+        return;
+    }
+    const __m256i zero = _mm256_setzero_si256();
+    gint vector_width = width - width % 8;
+    gint x = 0;
+    for (; x < vector_width; x += 8) {
+        __m256i pixels = _mm256_loadu_si256(
+            (const __m256i *) (const void *) &source[x * 4]);
+        // Unpacking & packing both work within 128-bit lanes, so they cancel out
+        __m256i low = premultiply_pair_avx2(_mm256_unpacklo_epi8(pixels, zero));
+        __m256i high = premultiply_pair_avx2(_mm256_unpackhi_epi8(pixels, zero));
+        _mm256_storeu_si256((__m256i *) (void *) &bgra[x * 4],
+                            _mm256_packus_epi16(low, high));
+    }
+    convert_row_scalar(&source[x * 4], channels, width - x, &bgra[x * 4]);
+}
+
+
+/* Blend filtered rows, two rows of eight pixels at a time */
+__attribute__((target("avx2")))
+static void blend_rows_avx2(const gint16 *const *rows, const gint16 *weights,
+                            gint row_count, gint width, guint32 *destination)
+{
+    const __m256i rounding = _mm256_set1_epi32(1 << (BLEND_SHIFT - 1));
+    gint vector_width = width - width % 8;
+    gint x = 0;
+    for (; x < vector_width; x += 8) {
+        // Each sum holds a pixel from both 128-bit lanes: 0 & 2, 1 & 3, ...
+        __m256i sums[4] = {
+            _mm256_setzero_si256(), _mm256_setzero_si256(),
+            _mm256_setzero_si256(), _mm256_setzero_si256()
+        };
+        for (gint t = 0; t < row_count; t += 2) {
+            const gint16 *first = &rows[t][x * 4];
+            const gint16 *second = t + 1 < row_count ? &rows[t + 1][x * 4] : first;
+            __m256i weight_pair = _mm256_set1_epi32(WEIGHT_PAIR(
+                weights[t], t + 1 < row_count ? weights[t + 1] : 0));
+            for (gint half = 0; half < 2; half++) {
+                __m256i a = _mm256_loadu_si256(
+                    (const __m256i *) (const void *) &first[half * 16]);
+                __m256i b = _mm256_loadu_si256(
+                    (const __m256i *) (const void *) &second[half * 16]);
+                sums[half * 2] = _mm256_add_epi32(sums[half * 2],
+                    _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), weight_pair));
+                sums[half * 2 + 1] = _mm256_add_epi32(sums[half * 2 + 1],
+                    _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), weight_pair));
+            }
+        }
+        for (gint p = 0; p < 4; p++) {
+            sums[p] = _mm256_srai_epi32(_mm256_add_epi32(sums[p], rounding),
+                                        BLEND_SHIFT);
+        }
+        // Packing leaves the pixels in the order 0-1, 4-5, 2-3, 6-7
+        __m256i pixels = _mm256_packus_epi16(_mm256_packs_epi32(sums[0], sums[1]),
+                                             _mm256_packs_epi32(sums[2], sums[3]));
+        pixels = _mm256_permute4x64_epi64(pixels, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *) (void *) &destination[x], pixels);
+    }
+    for (; x < width; x++) {
+        destination[x] = blend_pixel(rows, weights, row_count, x);
+    }
+}
+
+/* Slide a row of sums down, sixteen channels at a time */
+__attribute__((target("avx2")))
+static void accumulate_row_avx2(guint16 *sums, const guint8 *added,
+                                const guint8 *removed, gint length)
+{
+    gint vector_length = length - length % 16;
+    gint i = 0;
+    for (; i < vector_length; i += 16) {
+        __m256i *sum = (__m256i *) (void *) &sums[i];
+        __m256i add = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128((const __m128i *) (const void *) &added[i]));
+        __m256i remove = _mm256_cvtepu8_epi16(
+            _mm_loadu_si128((const __m128i *) (const void *) &removed[i]));
+        _mm256_storeu_si256(sum, _mm256_sub_epi16(
+            _mm256_add_epi16(_mm256_loadu_si256(sum), add), remove));
+    }
+    accumulate_row_scalar(&sums[i], &added[i], &removed[i], length - i);
+}
+
+
+/* Average a row of box sums, thirty-two channels at a time */
+__attribute__((target("avx2")))
+static void average_row_avx2(const guint16 *sums, gint length, gint radius,
+                             guint8 *row)
+{
+    const __m256i reciprocal =
+        _mm256_set1_epi16((gint16) get_box_reciprocal(radius));
+    const __m256i rounding = _mm256_set1_epi16((gint16) radius);
+    gint vector_length = length - length % 32;
+    gint i = 0;
+    for (; i < vector_length; i += 32) {
+        __m256i low = _mm256_loadu_si256((const __m256i *) (const void *) &sums[i]);
+        __m256i high = _mm256_loadu_si256(
+            (const __m256i *) (const void *) &sums[i + 16]);
+        low = _mm256_mulhi_epu16(_mm256_add_epi16(low, rounding), reciprocal);
+        high = _mm256_mulhi_epu16(_mm256_add_epi16(high, rounding), reciprocal);
+        // Packing interleaves the 128-bit lanes, so put them back in order
+        __m256i averages = _mm256_permute4x64_epi64(
+            _mm256_packus_epi16(low, high), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *) (void *) &row[i], averages);
+    }
+    average_row_scalar(&sums[i], length - i, radius, &row[i]);
+}
+
+#endif
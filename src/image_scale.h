@@ -0,0 +1,48 @@
+#ifndef IMAGE_SCALE_H
+#define IMAGE_SCALE_H
+
+#include <glib.h>
+
+// The largest box radius `image_blur_argb` uses, so box sums fit in 16 bits
+#define IMAGE_BLUR_MAX_RADIUS 127
+
+
+// The instruction sets the scaling kernels are built for
+typedef enum {
+    IMAGE_KERNELS_SCALAR,
+    IMAGE_KERNELS_SSE2,
+    IMAGE_KERNELS_AVX2,
+    IMAGE_KERNELS_COUNT
+} ImageKernels;
+
+// An 8-bit RGB or non-premultiplied RGBA image, like a GdkPixbuf's pixels
+typedef struct ImageSource_ {
+    const guint8 *pixels;
+    gint          width;
+    gint          height;
+    gint          rowstride;
+    /* 3 for RGB, 4 for RGBA */
+    gint          channels;
+} ImageSource;
+
+// Where & how large the scaled image is drawn on a cairo ARGB32 surface
+typedef struct ImagePlacement_ {
+    gdouble scale;
+    /* The position of the scaled image's top-left corner, in device pixels */
+    gdouble x;
+    gdouble y;
+} ImagePlacement;
+
+
+ImageKernels image_kernels_detect(void);
+gboolean image_kernels_supported(ImageKernels kernels);
+const gchar *image_kernels_name(ImageKernels kernels);
+void image_scale_to_argb(const ImageSource *source, const ImagePlacement *placement,
+                         guint8 *destination, gint width, gint height, gint stride,
+                         ImageKernels kernels, guint thread_count);
+void image_blur_argb(guint8 *pixels, gint width, gint height, gint stride,
+                     gint radius, ImageKernels kernels, guint thread_count);
+void image_dim_argb(guint8 *pixels, gint width, gint height, gint stride,
+                    guint8 brightness);
+
+#endif
@@ -0,0 +1,91 @@
+/* Wayland Layer Shell Windows
+ *
+ * Under a Wayland compositor that supports wlr-layer-shell, e.g. cage or
+ * sway, the windows are layer surfaces instead of X11 toplevels, so the
+ * greeter runs without an X server. The compositor sizes the background
+ * surfaces to their monitors & centers the unanchored main surface, which
+ * replaces the moving & pointer warping the X11 windows need.
+ *
+ * Without gtk-layer-shell, or under X11, nothing here is active.
+ */
+#include <gtk/gtk.h>
+
+#include "defines.h"
+#ifdef HAVE_GTK_LAYER_SHELL
+#include <gtk-layer-shell.h>
+#endif
+
+#include "layer_shell.h"
+
+
+/* Determine if the windows are layer surfaces. Must be called after
+ * `gtk_init` & before any window is realized.
+ */
+gboolean layer_shell_is_active(void)
+{
+#ifdef HAVE_GTK_LAYER_SHELL
+    static gint is_active = -1;
+    if (is_active < 0) {
+        is_active = gtk_layer_is_supported() ? 1 : 0;
+        if (is_active) {
+            g_message("Using Wayland layer shell surfaces");
+        }
+    }
+    return is_active == 1;
+#else
+    return FALSE;
+#endif
+}
+
+
+/* Make a background window a surface below everything else that fills its
+ * monitor.
+ */
+void layer_shell_setup_background_window(GtkWindow *window, GdkMonitor *monitor)
+{
+#ifdef HAVE_GTK_LAYER_SHELL
+    gtk_layer_init_for_window(window);
+    gtk_layer_set_namespace(window, "lightdm-mini-greeter-background");
+    gtk_layer_set_layer(window, GTK_LAYER_SHELL_LAYER_BACKGROUND);
+    gtk_layer_set_anchor(window, GTK_LAYER_SHELL_EDGE_TOP, TRUE);
+    gtk_layer_set_anchor(window, GTK_LAYER_SHELL_EDGE_BOTTOM, TRUE);
+    gtk_layer_set_anchor(window, GTK_LAYER_SHELL_EDGE_LEFT, TRUE);
+    gtk_layer_set_anchor(window, GTK_LAYER_SHELL_EDGE_RIGHT, TRUE);
+    // Cover any panels' exclusive zones too
+    gtk_layer_set_exclusive_zone(window, -1);
+    gtk_layer_set_monitor(window, monitor);
+#else
+    (void) window;
+    (void) monitor;
+#endif
+}
+
+
+/* Make the main window a centered surface above everything else that
+ * always has the keyboard.
+ */
+void layer_shell_setup_main_window(GtkWindow *window)
+{
+#ifdef HAVE_GTK_LAYER_SHELL
+    gtk_layer_init_for_window(window);
+    gtk_layer_set_namespace(window, "lightdm-mini-greeter");
+    gtk_layer_set_layer(window, GTK_LAYER_SHELL_LAYER_OVERLAY);
+    gtk_layer_set_keyboard_mode(window, GTK_LAYER_SHELL_KEYBOARD_MODE_EXCLUSIVE);
+#else
+    (void) window;
+#endif
+}
+
+
+/* Move a surface to another monitor, or let the compositor pick one if the
+ * monitor is NULL.
+ */
+void layer_shell_set_monitor(GtkWindow *window, GdkMonitor *monitor)
+{
+#ifdef HAVE_GTK_LAYER_SHELL
+    gtk_layer_set_monitor(window, monitor);
+#else
+    (void) window;
+    (void) monitor;
+#endif
+}
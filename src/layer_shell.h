@@ -0,0 +1,12 @@
+#ifndef LAYER_SHELL_H
+#define LAYER_SHELL_H
+
+#include <gtk/gtk.h>
+
+
+gboolean layer_shell_is_active(void);
+void layer_shell_setup_background_window(GtkWindow *window, GdkMonitor *monitor);
+void layer_shell_setup_main_window(GtkWindow *window);
+void layer_shell_set_monitor(GtkWindow *window, GdkMonitor *monitor);
+
+#endif
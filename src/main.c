@@ -1,22 +1,32 @@
 /* lightdm-mini-greeter - A minimal GTK LightDM Greeter */
-#include <sys/mman.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <gtk/gtk.h>
 
 #include "app.h"
+#include "config.h"
+#include "memory_report.h"
+#include "timing.h"
 #include "utils.h"
 
 
 int main(int argc, char **argv)
 {
-    mlockall(MCL_CURRENT | MCL_FUTURE);  // Keep data out of any swap devices
+    // Pre-build the compiled config for packaging, without starting the UI
+    if (argc > 1 && strcmp(argv[1], "--compile-config") == 0) {
+        return compile_config_file() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    initialize_timing();
+    initialize_memory_report();
 
     App *app = initialize_app(argc, argv);
 
-    connect_to_lightdm_daemon(app->greeter);
-    begin_authentication_as_default_user(app);
-    make_session_focus_ring(app);
+    // Authentication begins once connected, the windows don't wait for it
+    connect_to_lightdm_daemon(app);
 
+    timing_phase_begin(TIMING_FIRST_FRAME);
     for (int m = 0; m < APP_MONITOR_COUNT(app); m++) {
         gtk_widget_show_all(GTK_WIDGET(APP_BACKGROUND_WINDOWS(app)[m]));
     }
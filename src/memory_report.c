@@ -0,0 +1,225 @@
+/* Memory Footprint Diagnostics
+ *
+ * Samples the resident & locked memory, heap usage & number of mapped shared
+ * libraries at points during startup, so growth can be attributed to the
+ * phase that caused it. The report is written as JSON on SIGUSR1 & at exit.
+ *
+ * Sampling reads /proc, so it only runs while a report file is set. Startup
+ * is only sampled from the start when `LIGHTDM_MINI_GREETER_MEMORY_FILE` is
+ * set, a `memory-report-file` in the configuration starts sampling once it's
+ * loaded.
+ */
+#define _GNU_SOURCE
+#include <malloc.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "defines.h"
+#include "memory_report.h"
+
+
+typedef struct MemorySample_ {
+    gchar   *label;
+    gint64   time;
+    guint64  rss_kb;
+    guint64  locked_kb;
+    guint64  heap_bytes;
+    guint    shared_libraries;
+} MemorySample;
+
+static gint64 process_start = 0;
+static GArray *samples = NULL;
+static gchar *report_path = NULL;
+static gboolean sampling = FALSE;
+
+static void clear_sample(gpointer data);
+static void read_proc_status(MemorySample *sample);
+static guint count_shared_libraries(void);
+static guint64 get_heap_bytes(void);
+static gboolean handle_report_signal(gpointer user_data);
+static gboolean handle_terminate_signal(gpointer user_data);
+
+
+/* Start sampling if the environment asks for a report, taking the first
+ * sample.
+ */
+void initialize_memory_report(void)
+{
+    const gchar *report_file = g_getenv("LIGHTDM_MINI_GREETER_MEMORY_FILE");
+    sampling = report_file != NULL && report_file[0] != '\0';
+    process_start = g_get_monotonic_time();
+    samples = g_array_new(FALSE, FALSE, sizeof(MemorySample));
+    g_array_set_clear_func(samples, clear_sample);
+    memory_report_sample("start");
+}
+
+
+/* Set the path the JSON report is written to.
+ *
+ * A NULL or empty path disables sampling & drops any samples taken so far.
+ * Otherwise the report is also written on SIGUSR1 & when LightDM stops us.
+ */
+void memory_report_set_file(const gchar *report_file)
+{
+    g_free(report_path);
+    if (report_file == NULL || report_file[0] == '\0') {
+        report_path = NULL;
+        sampling = FALSE;
+        g_array_set_size(samples, 0);
+        return;
+    }
+    report_path = g_strdup(report_file);
+    sampling = TRUE;
+    g_unix_signal_add(SIGUSR1, handle_report_signal, NULL);
+    g_unix_signal_add(SIGTERM, handle_terminate_signal, NULL);
+}
+
+
+/* Record the process's current memory usage */
+void memory_report_sample(const gchar *label)
+{
+    if (!sampling) {
+        return;
+    }
+    MemorySample sample;
+    sample.label = g_strdup(label);
+    sample.time = g_get_monotonic_time() - process_start;
+    sample.rss_kb = 0;
+    sample.locked_kb = 0;
+    read_proc_status(&sample);
+    sample.heap_bytes = get_heap_bytes();
+    sample.shared_libraries = count_shared_libraries();
+    g_array_append_val(samples, sample);
+}
+
+
+/* Get the number of samples taken so far */
+guint memory_report_get_sample_count(void)
+{
+    return samples->len;
+}
+
+
+/* Take a final sample & write every sample to the report file */
+void memory_report_write(const gchar *label)
+{
+    if (report_path == NULL) {
+        return;
+    }
+    memory_report_sample(label);
+
+    GString *json = g_string_new("{\n");
+    g_string_append_printf(json, "  \"pid\": %d,\n", (int) getpid());
+    g_string_append(json, "  \"samples\": [\n");
+    for (guint s = 0; s < samples->len; s++) {
+        const MemorySample *sample = &g_array_index(samples, MemorySample, s);
+        g_string_append_printf(
+            json,
+            "    {\"label\": \"%s\", \"time\": %" G_GINT64_FORMAT
+            ", \"rss_kb\": %" G_GUINT64_FORMAT ", \"locked_kb\": %" G_GUINT64_FORMAT
+            ", \"heap_bytes\": %" G_GUINT64_FORMAT ", \"shared_libraries\": %u}%s\n",
+            sample->label, sample->time, sample->rss_kb, sample->locked_kb,
+            sample->heap_bytes, sample->shared_libraries,
+            s < samples->len - 1 ? "," : "");
+    }
+    g_string_append(json, "  ]\n}\n");
+
+    GError *write_error = NULL;
+    if (!g_file_set_contents(report_path, json->str, (gssize) json->len, &write_error)) {
+        g_warning("Could not write memory report to %s: %s",
+                  report_path, write_error->message);
+        g_error_free(write_error);
+    } else {
+        g_message("Wrote memory report to %s", report_path);
+    }
+
+    g_string_free(json, TRUE);
+}
+
+
+static void clear_sample(gpointer data)
+{
+    g_free(((MemorySample *) data)->label);
+}
+
+
+/* Read the resident & locked sizes from /proc/self/status */
+static void read_proc_status(MemorySample *sample)
+{
+    FILE *status = fopen("/proc/self/status", "re");
+    if (status == NULL) {
+        return;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), status) != NULL) {
+        guint64 value;
+        if (sscanf(line, "VmRSS: %" G_GUINT64_FORMAT " kB", &value) == 1) {
+            sample->rss_kb = value;
+        } else if (sscanf(line, "VmLck: %" G_GUINT64_FORMAT " kB", &value) == 1) {
+            sample->locked_kb = value;
+        }
+    }
+    fclose(status);
+}
+
+
+/* Count the distinct shared libraries in /proc/self/maps */
+static guint count_shared_libraries(void)
+{
+    FILE *maps = fopen("/proc/self/maps", "re");
+    if (maps == NULL) {
+        return 0;
+    }
+    GHashTable *libraries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    char line[4096];
+    while (fgets(line, sizeof(line), maps) != NULL) {
+        char *path = strchr(line, '/');
+        if (path == NULL || strstr(path, ".so") == NULL) {
+            continue;
+        }
+        path[strcspn(path, "\n")] = '\0';
+        g_hash_table_add(libraries, g_strdup(path));
+    }
+    fclose(maps);
+
+    guint library_count = g_hash_table_size(libraries);
+    g_hash_table_destroy(libraries);
+    return library_count;
+}
+
+
+/* Get the bytes allocated by malloc, including large mmap'd allocations */
+static guint64 get_heap_bytes(void)
+{
+#ifdef HAVE_MALLINFO2
+    struct mallinfo2 info = mallinfo2();
+    return (guint64) info.uordblks + (guint64) info.hblkhd;
+#else
+    struct mallinfo info = mallinfo();
+    return (guint64) (unsigned int) info.uordblks + (guint64) (unsigned int) info.hblkhd;
+#endif
+}
+
+
+static gboolean handle_report_signal(gpointer user_data)
+{
+    memory_report_write("SIGUSR1");
+
+    return G_SOURCE_CONTINUE;
+}
+
+
+/* Write the report before LightDM stops us, then terminate as usual */
+static gboolean handle_terminate_signal(gpointer user_data)
+{
+    memory_report_write("exit");
+    signal(SIGTERM, SIG_DFL);
+    raise(SIGTERM);
+
+    return G_SOURCE_REMOVE;
+}
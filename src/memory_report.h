@@ -0,0 +1,13 @@
+#ifndef MEMORY_REPORT_H
+#define MEMORY_REPORT_H
+
+#include <glib.h>
+
+
+void initialize_memory_report(void);
+void memory_report_set_file(const gchar *report_file);
+void memory_report_sample(const gchar *label);
+guint memory_report_get_sample_count(void);
+void memory_report_write(const gchar *label);
+
+#endif
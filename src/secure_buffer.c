@@ -0,0 +1,211 @@
+/* A GtkEntryBuffer for Passwords
+ *
+ * The default GtkEntryBuffer stores its text on the glib heap, so keeping the
+ * password out of swap meant locking the whole process with `mlockall`. This
+ * buffer instead keeps its text in a single page of its own that is locked
+ * into RAM & excluded from core dumps. Deleted text is zeroed immediately &
+ * the page is wiped when the buffer is freed.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <gtk/gtk.h>
+
+#include "secure_buffer.h"
+
+
+// The size of the locked region, including the terminating NUL
+#define SECURE_BUFFER_SIZE 4096
+
+struct _SecureEntryBuffer {
+    GtkEntryBuffer parent_instance;
+
+    gchar *text;
+    gsize  text_bytes;
+    guint  text_chars;
+};
+
+G_DEFINE_TYPE(SecureEntryBuffer, secure_entry_buffer, GTK_TYPE_ENTRY_BUFFER)
+
+static void secure_entry_buffer_finalize(GObject *object);
+static const gchar *secure_entry_buffer_get_text(GtkEntryBuffer *entry_buffer,
+                                                 gsize *n_bytes);
+static guint secure_entry_buffer_get_length(GtkEntryBuffer *entry_buffer);
+static guint secure_entry_buffer_insert_text(GtkEntryBuffer *entry_buffer,
+                                             guint position, const gchar *chars,
+                                             guint n_chars);
+static guint secure_entry_buffer_delete_text(GtkEntryBuffer *entry_buffer,
+                                             guint position, guint n_chars);
+
+
+/* Create an empty secure buffer */
+GtkEntryBuffer *secure_entry_buffer_new(void)
+{
+    return g_object_new(SECURE_TYPE_ENTRY_BUFFER, NULL);
+}
+
+
+/* Remove all text from the buffer & zero the whole locked region */
+void secure_entry_buffer_wipe(SecureEntryBuffer *buffer)
+{
+    if (buffer->text_chars > 0) {
+        gtk_entry_buffer_delete_text(GTK_ENTRY_BUFFER(buffer), 0, -1);
+    }
+    explicit_bzero(buffer->text, SECURE_BUFFER_SIZE);
+}
+
+
+static void secure_entry_buffer_class_init(SecureEntryBufferClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    GtkEntryBufferClass *buffer_class = GTK_ENTRY_BUFFER_CLASS(klass);
+
+    object_class->finalize = secure_entry_buffer_finalize;
+    buffer_class->get_text = secure_entry_buffer_get_text;
+    buffer_class->get_length = secure_entry_buffer_get_length;
+    buffer_class->insert_text = secure_entry_buffer_insert_text;
+    buffer_class->delete_text = secure_entry_buffer_delete_text;
+}
+
+
+/* Map a zeroed region that's locked into RAM & excluded from core dumps.
+ *
+ * Failing to lock the region is only a warning, since RLIMIT_MEMLOCK may be
+ * too low, but we can't run without somewhere to store secrets.
+ */
+gpointer secure_memory_alloc(gsize size, const gchar *description)
+{
+    void *region = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        g_error("Could not allocate memory for the %s", description);
+    }
+    if (mlock(region, size) != 0) {
+        g_warning("Could not lock the %s into memory: %s", description,
+                  g_strerror(errno));
+    }
+    if (madvise(region, size, MADV_DONTDUMP) != 0) {
+        g_warning("Could not exclude the %s from core dumps: %s", description,
+                  g_strerror(errno));
+    }
+    return region;
+}
+
+
+/* Wipe & release a region from `secure_memory_alloc` */
+void secure_memory_free(gpointer memory, gsize size)
+{
+    explicit_bzero(memory, size);
+    munlock(memory, size);
+    munmap(memory, size);
+}
+
+
+/* Allocate the text's locked page */
+static void secure_entry_buffer_init(SecureEntryBuffer *buffer)
+{
+    gchar *region = secure_memory_alloc(SECURE_BUFFER_SIZE, "password buffer");
+
+    buffer->text = region;
+    buffer->text[0] = '\0';
+    buffer->text_bytes = 0;
+    buffer->text_chars = 0;
+}
+
+
+/* Wipe & release the locked region */
+static void secure_entry_buffer_finalize(GObject *object)
+{
+    SecureEntryBuffer *buffer = SECURE_ENTRY_BUFFER(object);
+    secure_memory_free(buffer->text, SECURE_BUFFER_SIZE);
+    buffer->text = NULL;
+
+    G_OBJECT_CLASS(secure_entry_buffer_parent_class)->finalize(object);
+}
+
+
+static const gchar *secure_entry_buffer_get_text(GtkEntryBuffer *entry_buffer,
+                                                 gsize *n_bytes)
+{
+    SecureEntryBuffer *buffer = SECURE_ENTRY_BUFFER(entry_buffer);
+    if (n_bytes != NULL) {
+        *n_bytes = buffer->text_bytes;
+    }
+    return buffer->text;
+}
+
+
+static guint secure_entry_buffer_get_length(GtkEntryBuffer *entry_buffer)
+{
+    return SECURE_ENTRY_BUFFER(entry_buffer)->text_chars;
+}
+
+
+/* Insert text at a character position, dropping any characters that don't
+ * fit in the locked region.
+ */
+static guint secure_entry_buffer_insert_text(GtkEntryBuffer *entry_buffer,
+                                             guint position, const gchar *chars,
+                                             guint n_chars)
+{
+    SecureEntryBuffer *buffer = SECURE_ENTRY_BUFFER(entry_buffer);
+
+    // Count the characters & bytes that fit
+    const gsize available_bytes = SECURE_BUFFER_SIZE - 1 - buffer->text_bytes;
+    gsize insert_bytes = 0;
+    guint insert_chars = 0;
+    while (insert_chars < n_chars) {
+        const gchar *next_char = g_utf8_next_char(chars + insert_bytes);
+        gsize char_bytes = (gsize) (next_char - (chars + insert_bytes));
+        if (insert_bytes + char_bytes > available_bytes) {
+            break;
+        }
+        insert_bytes += char_bytes;
+        insert_chars++;
+    }
+    if (insert_chars == 0) {
+        return 0;
+    }
+
+    gsize offset = (gsize) (g_utf8_offset_to_pointer(buffer->text, position) -
+                            buffer->text);
+    memmove(buffer->text + offset + insert_bytes, buffer->text + offset,
+            buffer->text_bytes - offset + 1);
+    memcpy(buffer->text + offset, chars, insert_bytes);
+    buffer->text_bytes += insert_bytes;
+    buffer->text_chars += insert_chars;
+
+    gtk_entry_buffer_emit_inserted_text(entry_buffer, position, chars, insert_chars);
+    return insert_chars;
+}
+
+
+/* Delete characters starting at a position, zeroing the bytes they leave */
+static guint secure_entry_buffer_delete_text(GtkEntryBuffer *entry_buffer,
+                                             guint position, guint n_chars)
+{
+    SecureEntryBuffer *buffer = SECURE_ENTRY_BUFFER(entry_buffer);
+    if (position > buffer->text_chars) {
+        position = buffer->text_chars;
+    }
+    if (n_chars > buffer->text_chars - position) {
+        n_chars = buffer->text_chars - position;
+    }
+    if (n_chars == 0) {
+        return 0;
+    }
+
+    gchar *start = g_utf8_offset_to_pointer(buffer->text, position);
+    gchar *end = g_utf8_offset_to_pointer(start, n_chars);
+    gsize delete_bytes = (gsize) (end - start);
+    gsize tail_bytes = buffer->text_bytes - (gsize) (end - buffer->text) + 1;
+    memmove(start, end, tail_bytes);
+    buffer->text_bytes -= delete_bytes;
+    buffer->text_chars -= n_chars;
+    explicit_bzero(buffer->text + buffer->text_bytes + 1, delete_bytes);
+
+    gtk_entry_buffer_emit_deleted_text(entry_buffer, position, n_chars);
+    return n_chars;
+}
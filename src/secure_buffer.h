@@ -0,0 +1,20 @@
+#ifndef SECURE_BUFFER_H
+#define SECURE_BUFFER_H
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define SECURE_TYPE_ENTRY_BUFFER (secure_entry_buffer_get_type())
+G_DECLARE_FINAL_TYPE(SecureEntryBuffer, secure_entry_buffer, SECURE, ENTRY_BUFFER,
+                     GtkEntryBuffer)
+
+GtkEntryBuffer *secure_entry_buffer_new(void);
+void secure_entry_buffer_wipe(SecureEntryBuffer *buffer);
+
+gpointer secure_memory_alloc(gsize size, const gchar *description);
+void secure_memory_free(gpointer memory, gsize size);
+
+G_END_DECLS
+
+#endif
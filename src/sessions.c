@@ -0,0 +1,672 @@
+/* Cached Session Discovery
+ *
+ * Rather than re-parsing every session's .desktop file on every start, the
+ * parsed sessions are cached in the user's cache directory, along with the
+ * mtimes of the session directories & the mtime & size of every session file.
+ * The cache is used until a session file is added, removed, renamed or
+ * edited. Whether each session's `TryExec` program is installed is checked
+ * again every time, so installing one doesn't need a rescan.
+ *
+ * The directories are LightDM's `sessions-directory` setting, read from its
+ * configuration files like the daemon does, or LightDM's default directories
+ * when it's not set.
+ *
+ * While the greeter runs, the directories are watched & the session ring is
+ * refilled in place when they change.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <gio/gio.h>
+#include <glib.h>
+
+#include "sessions.h"
+
+
+#ifndef SESSION_DIRECTORIES
+#define SESSION_DIRECTORIES \
+    "/usr/share/lightdm/sessions:/usr/share/xsessions:/usr/share/wayland-sessions"
+#endif
+// Searched for `lightdm.conf.d/*.conf` & `lightdm.conf`, later files win
+#ifndef LIGHTDM_CONFIG_DIRECTORIES
+#define LIGHTDM_CONFIG_DIRECTORIES \
+    "/usr/share/lightdm:/usr/local/share/lightdm:/etc/xdg/lightdm:/etc/lightdm"
+#endif
+
+#define SESSION_CACHE_VERSION   2
+#define SESSION_CACHE_GROUP     "Cache"
+#define SESSION_DIRS_GROUP      "Directories"
+#define SESSION_FILES_GROUP     "Files"
+#define SESSION_GROUP_PREFIX    "Session "
+// Let a burst of directory changes settle before rescanning
+#define SESSION_RESCAN_DELAY_MS 500
+
+static gchar **get_session_directories(void);
+static gchar *get_configured_session_directories(void);
+static void read_configured_session_directories(const gchar *config_path,
+                                                gchar **directories);
+static gint compare_file_names(gconstpointer a, gconstpointer b);
+static gint64 get_directory_mtime(const gchar *directory);
+static gchar *get_session_cache_path(void);
+static GHashTable *get_session_file_stamps(gchar **directories);
+static GPtrArray *load_sessions(gchar **directories, gboolean use_cache);
+static GPtrArray *load_session_cache(gchar **directories);
+static gboolean session_files_match(GKeyFile *cache, gchar **directories);
+static void write_session_cache(gchar **directories, const gint64 *mtimes,
+                                GHashTable *file_stamps, const GPtrArray *sessions);
+static GPtrArray *scan_sessions(gchar **directories);
+static void scan_session_directory(const gchar *directory, GPtrArray *sessions);
+static void select_installed_sessions(GPtrArray *sessions);
+static Session *load_session_file(const gchar *path, const gchar *key,
+                                  const gchar *default_type);
+static gint compare_sessions(gconstpointer a, gconstpointer b);
+static void fill_session_ring(FocusRing *ring, GPtrArray *sessions);
+static void handle_session_directory_change(GFileMonitor *monitor, GFile *file,
+                                            GFile *other_file,
+                                            GFileMonitorEvent event,
+                                            gpointer user_data);
+static gboolean handle_session_rescan(gpointer user_data);
+static const gchar *get_session_key(gconstpointer data);
+static void destroy_session(gpointer data);
+
+
+/* Build a ring of the available sessions, from the cache if it's current.
+ *
+ * The ring is empty if there are no sessions.
+ */
+FocusRing *initialize_session_ring(void)
+{
+    FocusRing *ring =
+        initialize_focus_ring(&get_session_key, destroy_session, "sessions");
+    gchar **directories = get_session_directories();
+    fill_session_ring(ring, load_sessions(directories, TRUE));
+    g_strfreev(directories);
+    return ring;
+}
+
+
+/* Watch the session directories, refilling the ring when they change */
+SessionWatch *initialize_session_watch(FocusRing *ring)
+{
+    SessionWatch *watch = malloc(sizeof(SessionWatch));
+    if (watch == NULL) {
+        g_error("Could not allocate memory for SessionWatch");
+    }
+    watch->ring = ring;
+    watch->directories = get_session_directories();
+    watch->monitors = g_ptr_array_new_with_free_func(g_object_unref);
+    watch->rescan_timeout_id = 0;
+
+    for (gchar **directory = watch->directories; *directory != NULL; directory++) {
+        GFile *directory_file = g_file_new_for_path(*directory);
+        GError *monitor_error = NULL;
+        GFileMonitor *monitor = g_file_monitor_directory(
+            directory_file, G_FILE_MONITOR_NONE, NULL, &monitor_error);
+        if (monitor == NULL) {
+            g_warning("Could not watch %s for session changes: %s",
+                      *directory, monitor_error->message);
+            g_error_free(monitor_error);
+        } else {
+            g_signal_connect(monitor, "changed",
+                             G_CALLBACK(handle_session_directory_change), watch);
+            g_ptr_array_add(watch->monitors, monitor);
+        }
+        g_object_unref(directory_file);
+    }
+
+    return watch;
+}
+
+
+/* Stop watching the session directories. The ring is left alone. */
+void destroy_session_watch(SessionWatch *watch)
+{
+    if (watch->rescan_timeout_id != 0) {
+        g_source_remove(watch->rescan_timeout_id);
+    }
+    for (guint i = 0; i < watch->monitors->len; i++) {
+        g_file_monitor_cancel(g_ptr_array_index(watch->monitors, i));
+    }
+    g_ptr_array_free(watch->monitors, TRUE);
+    g_strfreev(watch->directories);
+    free(watch);
+}
+
+
+/* Get the directories to search for sessions, in order of precedence.
+ *
+ * The `LIGHTDM_MINI_GREETER_SESSION_DIRS` environment variable overrides
+ * LightDM's `sessions-directory` setting, which overrides the compiled-in
+ * `SESSION_DIRECTORIES`.
+ */
+static gchar **get_session_directories(void)
+{
+    const gchar *directories = g_getenv("LIGHTDM_MINI_GREETER_SESSION_DIRS");
+    if (directories != NULL && directories[0] != '\0') {
+        return g_strsplit(directories, ":", -1);
+    }
+    gchar *configured_directories = get_configured_session_directories();
+    if (configured_directories == NULL) {
+        return g_strsplit(SESSION_DIRECTORIES, ":", -1);
+    }
+    gchar **split_directories = g_strsplit(configured_directories, ":", -1);
+    g_free(configured_directories);
+    return split_directories;
+}
+
+
+/* Get LightDM's `sessions-directory` setting, or NULL if it's not set.
+ *
+ * Like the daemon, every LightDM configuration directory's `lightdm.conf.d`
+ * files are read in order of name, then its `lightdm.conf`, & the last file
+ * setting it wins. The `LIGHTDM_MINI_GREETER_LIGHTDM_CONFIG_DIRS`
+ * environment variable overrides the compiled-in
+ * `LIGHTDM_CONFIG_DIRECTORIES`.
+ */
+static gchar *get_configured_session_directories(void)
+{
+    const gchar *config_directories =
+        g_getenv("LIGHTDM_MINI_GREETER_LIGHTDM_CONFIG_DIRS");
+    if (config_directories == NULL || config_directories[0] == '\0') {
+        config_directories = LIGHTDM_CONFIG_DIRECTORIES;
+    }
+    gchar **config_directory_list = g_strsplit(config_directories, ":", -1);
+
+    gchar *directories = NULL;
+    for (gchar **config_directory = config_directory_list;
+            *config_directory != NULL; config_directory++) {
+        gchar *drop_in_path =
+            g_build_filename(*config_directory, "lightdm.conf.d", NULL);
+        GDir *drop_in_dir = g_dir_open(drop_in_path, 0, NULL);
+        if (drop_in_dir != NULL) {
+            GPtrArray *file_names = g_ptr_array_new_with_free_func(g_free);
+            const gchar *file_name;
+            while ((file_name = g_dir_read_name(drop_in_dir)) != NULL) {
+                if (g_str_has_suffix(file_name, ".conf")) {
+                    g_ptr_array_add(file_names, g_strdup(file_name));
+                }
+            }
+            g_dir_close(drop_in_dir);
+            g_ptr_array_sort(file_names, compare_file_names);
+            for (guint i = 0; i < file_names->len; i++) {
+                gchar *config_path = g_build_filename(
+                    drop_in_path, g_ptr_array_index(file_names, i), NULL);
+                read_configured_session_directories(config_path, &directories);
+                g_free(config_path);
+            }
+            g_ptr_array_free(file_names, TRUE);
+        }
+        g_free(drop_in_path);
+
+        gchar *config_path =
+            g_build_filename(*config_directory, "lightdm.conf", NULL);
+        read_configured_session_directories(config_path, &directories);
+        g_free(config_path);
+    }
+    g_strfreev(config_directory_list);
+
+    if (directories != NULL && directories[0] == '\0') {
+        g_free(directories);
+        directories = NULL;
+    }
+    return directories;
+}
+
+
+/* Replace the directories with a LightDM configuration file's
+ * `sessions-directory`, if it sets one.
+ */
+static void read_configured_session_directories(const gchar *config_path,
+                                                gchar **directories)
+{
+    GKeyFile *config = g_key_file_new();
+    if (g_key_file_load_from_file(config, config_path, G_KEY_FILE_NONE, NULL)) {
+        gchar *value = g_key_file_get_string(
+            config, "LightDM", "sessions-directory", NULL);
+        if (value != NULL) {
+            g_free(*directories);
+            *directories = g_strstrip(value);
+        }
+    }
+    g_key_file_free(config);
+}
+
+
+/* Order file names for g_ptr_array_sort */
+static gint compare_file_names(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(const gchar *const *) a, *(const gchar *const *) b);
+}
+
+
+/* Get the mtime of a directory in microseconds, or -1 if it doesn't exist */
+static gint64 get_directory_mtime(const gchar *directory)
+{
+    struct stat directory_stat;
+    if (stat(directory, &directory_stat) != 0) {
+        return -1;
+    }
+    return (gint64) directory_stat.st_mtim.tv_sec * G_USEC_PER_SEC +
+        directory_stat.st_mtim.tv_nsec / 1000;
+}
+
+
+/* Get the mtime & size of every session file, mapping their paths to a
+ * "<mtime>:<size>" stamp.
+ */
+static GHashTable *get_session_file_stamps(gchar **directories)
+{
+    GHashTable *file_stamps =
+        g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    for (gchar **directory = directories; *directory != NULL; directory++) {
+        GDir *dir = g_dir_open(*directory, 0, NULL);
+        if (dir == NULL) {
+            continue;
+        }
+        const gchar *file_name;
+        while ((file_name = g_dir_read_name(dir)) != NULL) {
+            if (!g_str_has_suffix(file_name, ".desktop")) {
+                continue;
+            }
+            gchar *path = g_build_filename(*directory, file_name, NULL);
+            struct stat file_stat;
+            if (stat(path, &file_stat) != 0) {
+                g_free(path);
+                continue;
+            }
+            gint64 mtime = (gint64) file_stat.st_mtim.tv_sec * G_USEC_PER_SEC +
+                file_stat.st_mtim.tv_nsec / 1000;
+            g_hash_table_replace(file_stamps, path, g_strdup_printf(
+                "%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT, mtime,
+                (gint64) file_stat.st_size));
+        }
+        g_dir_close(dir);
+    }
+    return file_stamps;
+}
+
+
+/* Get the path of the session cache in the user's cache directory */
+static gchar *get_session_cache_path(void)
+{
+    return g_build_filename(
+        g_get_user_cache_dir(), "lightdm-mini-greeter", "sessions", NULL);
+}
+
+
+/* Load the sorted, installed sessions from the cache, or scan the session
+ * directories & cache them if the cache is stale or shouldn't be used.
+ */
+static GPtrArray *load_sessions(gchar **directories, gboolean use_cache)
+{
+    GPtrArray *sessions = use_cache ? load_session_cache(directories) : NULL;
+    if (sessions == NULL) {
+        // Take the stamps first, so changes made during the scan aren't missed
+        guint directory_count = g_strv_length(directories);
+        gint64 *mtimes = g_new(gint64, directory_count);
+        for (guint i = 0; i < directory_count; i++) {
+            mtimes[i] = get_directory_mtime(directories[i]);
+        }
+        GHashTable *file_stamps = get_session_file_stamps(directories);
+        sessions = scan_sessions(directories);
+        write_session_cache(directories, mtimes, file_stamps, sessions);
+        g_hash_table_destroy(file_stamps);
+        g_free(mtimes);
+    }
+    select_installed_sessions(sessions);
+    return sessions;
+}
+
+
+/* Load the cached sessions, including those whose `TryExec` isn't installed.
+ *
+ * Returns NULL if there's no cache, or if any session directory, session
+ * file or the language has changed since it was written.
+ */
+static GPtrArray *load_session_cache(gchar **directories)
+{
+    gchar *cache_path = get_session_cache_path();
+    GKeyFile *cache = g_key_file_new();
+    gboolean cache_loaded =
+        g_key_file_load_from_file(cache, cache_path, G_KEY_FILE_NONE, NULL);
+    g_free(cache_path);
+
+    // Session names are localized, so the cache is only valid for one language
+    gchar *language =
+        g_key_file_get_string(cache, SESSION_CACHE_GROUP, "language", NULL);
+    gboolean is_current = cache_loaded &&
+        g_key_file_get_integer(cache, SESSION_CACHE_GROUP, "version", NULL)
+            == SESSION_CACHE_VERSION &&
+        g_strcmp0(language, g_get_language_names()[0]) == 0;
+    g_free(language);
+
+    gsize cached_directory_count = 0;
+    gchar **cached_directories = NULL;
+    if (is_current) {
+        cached_directories = g_key_file_get_keys(
+            cache, SESSION_DIRS_GROUP, &cached_directory_count, NULL);
+        is_current = cached_directories != NULL &&
+            cached_directory_count == g_strv_length(directories);
+        g_strfreev(cached_directories);
+    }
+    for (gchar **directory = directories; is_current && *directory != NULL;
+            directory++) {
+        GError *mtime_error = NULL;
+        gint64 cached_mtime = g_key_file_get_int64(
+            cache, SESSION_DIRS_GROUP, *directory, &mtime_error);
+        if (mtime_error != NULL) {
+            g_error_free(mtime_error);
+            is_current = FALSE;
+        } else {
+            is_current = cached_mtime == get_directory_mtime(*directory);
+        }
+    }
+    if (!is_current || !session_files_match(cache, directories)) {
+        g_key_file_free(cache);
+        return NULL;
+    }
+
+    GPtrArray *sessions = g_ptr_array_new_with_free_func(destroy_session);
+    gchar **groups = g_key_file_get_groups(cache, NULL);
+    for (gchar **group = groups; *group != NULL; group++) {
+        if (!g_str_has_prefix(*group, SESSION_GROUP_PREFIX)) {
+            continue;
+        }
+        Session *session = malloc(sizeof(Session));
+        if (session == NULL) {
+            g_error("Could not allocate memory for Session");
+        }
+        session->key = g_key_file_get_string(cache, *group, "key", NULL);
+        session->name = g_key_file_get_string(cache, *group, "name", NULL);
+        session->type = g_key_file_get_string(cache, *group, "type", NULL);
+        session->exec = g_key_file_get_string(cache, *group, "exec", NULL);
+        session->try_exec = g_key_file_get_string(cache, *group, "try-exec", NULL);
+        if (session->key == NULL || session->name == NULL || session->type == NULL) {
+            destroy_session(session);
+            continue;
+        }
+        g_ptr_array_add(sessions, session);
+    }
+    g_strfreev(groups);
+    g_key_file_free(cache);
+
+    return sessions;
+}
+
+
+/* Check the cached session files are exactly the ones there now, with the
+ * same mtimes & sizes.
+ */
+static gboolean session_files_match(GKeyFile *cache, gchar **directories)
+{
+    gsize cached_file_count = 0;
+    gchar **cached_files =
+        g_key_file_get_keys(cache, SESSION_FILES_GROUP, &cached_file_count, NULL);
+    g_strfreev(cached_files);
+    GHashTable *file_stamps = get_session_file_stamps(directories);
+    gboolean files_match = cached_file_count == g_hash_table_size(file_stamps);
+
+    GHashTableIter iter;
+    gpointer path, stamp;
+    g_hash_table_iter_init(&iter, file_stamps);
+    while (files_match && g_hash_table_iter_next(&iter, &path, &stamp)) {
+        gchar *cached_stamp =
+            g_key_file_get_string(cache, SESSION_FILES_GROUP, path, NULL);
+        files_match = g_strcmp0(cached_stamp, stamp) == 0;
+        g_free(cached_stamp);
+    }
+
+    g_hash_table_destroy(file_stamps);
+    return files_match;
+}
+
+
+/* Write the sessions & the stamps the directories & session files had
+ * before the scan.
+ */
+static void write_session_cache(gchar **directories, const gint64 *mtimes,
+                                GHashTable *file_stamps, const GPtrArray *sessions)
+{
+    GKeyFile *cache = g_key_file_new();
+    g_key_file_set_integer(cache, SESSION_CACHE_GROUP, "version",
+                           SESSION_CACHE_VERSION);
+    g_key_file_set_string(cache, SESSION_CACHE_GROUP, "language",
+                          g_get_language_names()[0]);
+    for (guint i = 0; directories[i] != NULL; i++) {
+        g_key_file_set_int64(cache, SESSION_DIRS_GROUP, directories[i], mtimes[i]);
+    }
+    GHashTableIter iter;
+    gpointer path, stamp;
+    g_hash_table_iter_init(&iter, file_stamps);
+    while (g_hash_table_iter_next(&iter, &path, &stamp)) {
+        g_key_file_set_string(cache, SESSION_FILES_GROUP, path, stamp);
+    }
+    // Numbered in scan order, since keys repeat across directories
+    for (guint i = 0; i < sessions->len; i++) {
+        const Session *session = g_ptr_array_index(sessions, i);
+        gchar *group = g_strdup_printf(SESSION_GROUP_PREFIX "%u", i);
+        g_key_file_set_string(cache, group, "key", session->key);
+        g_key_file_set_string(cache, group, "name", session->name);
+        g_key_file_set_string(cache, group, "type", session->type);
+        if (session->exec != NULL) {
+            g_key_file_set_string(cache, group, "exec", session->exec);
+        }
+        if (session->try_exec != NULL) {
+            g_key_file_set_string(cache, group, "try-exec", session->try_exec);
+        }
+        g_free(group);
+    }
+
+    gchar *cache_path = get_session_cache_path();
+    gchar *cache_dir = g_path_get_dirname(cache_path);
+    GError *write_error = NULL;
+    if (g_mkdir_with_parents(cache_dir, 0700) != 0 ||
+            !g_key_file_save_to_file(cache, cache_path, &write_error)) {
+        g_warning("Could not write the session cache %s: %s", cache_path,
+                  write_error != NULL ? write_error->message : g_strerror(errno));
+        if (write_error != NULL) {
+            g_error_free(write_error);
+        }
+    }
+
+    g_free(cache_dir);
+    g_free(cache_path);
+    g_key_file_free(cache);
+}
+
+
+/* Parse the session files in every directory, in directory order.
+ *
+ * Sessions whose `TryExec` isn't installed are kept, see
+ * `select_installed_sessions`.
+ */
+static GPtrArray *scan_sessions(gchar **directories)
+{
+    GPtrArray *sessions = g_ptr_array_new_with_free_func(destroy_session);
+    for (gchar **directory = directories; *directory != NULL; directory++) {
+        scan_session_directory(*directory, sessions);
+    }
+    return sessions;
+}
+
+
+/* Parse the .desktop files in a session directory */
+static void scan_session_directory(const gchar *directory, GPtrArray *sessions)
+{
+    GDir *dir = g_dir_open(directory, 0, NULL);
+    if (dir == NULL) {
+        return;
+    }
+    gchar *directory_name = g_path_get_basename(directory);
+    const gchar *default_type =
+        strcmp(directory_name, "wayland-sessions") == 0 ? "wayland" : "x";
+    g_free(directory_name);
+
+    const gchar *file_name;
+    while ((file_name = g_dir_read_name(dir)) != NULL) {
+        if (!g_str_has_suffix(file_name, ".desktop")) {
+            continue;
+        }
+        gchar *key =
+            g_strndup(file_name, strlen(file_name) - strlen(".desktop"));
+        gchar *path = g_build_filename(directory, file_name, NULL);
+        Session *session = load_session_file(path, key, default_type);
+        g_free(path);
+        g_free(key);
+        if (session != NULL) {
+            g_ptr_array_add(sessions, session);
+        }
+    }
+    g_dir_close(dir);
+}
+
+
+/* Parse a session's .desktop file.
+ *
+ * Returns NULL for hidden sessions.
+ */
+static Session *load_session_file(const gchar *path, const gchar *key,
+                                  const gchar *default_type)
+{
+    const gchar *const group = G_KEY_FILE_DESKTOP_GROUP;
+    GKeyFile *desktop_file = g_key_file_new();
+    if (!g_key_file_load_from_file(desktop_file, path, G_KEY_FILE_NONE, NULL) ||
+            g_key_file_get_boolean(desktop_file, group, "NoDisplay", NULL) ||
+            g_key_file_get_boolean(desktop_file, group, "Hidden", NULL)) {
+        g_key_file_free(desktop_file);
+        return NULL;
+    }
+
+    gchar *name = g_key_file_get_locale_string(desktop_file, group, "Name", NULL, NULL);
+    if (name == NULL) {
+        g_key_file_free(desktop_file);
+        return NULL;
+    }
+
+    Session *session = malloc(sizeof(Session));
+    if (session == NULL) {
+        g_error("Could not allocate memory for Session");
+    }
+    session->key = g_strdup(key);
+    session->name = name;
+    session->type = g_key_file_get_string(
+        desktop_file, group, "X-LightDM-Session-Type", NULL);
+    if (session->type == NULL) {
+        session->type = g_strdup(default_type);
+    }
+    session->exec = g_key_file_get_string(desktop_file, group, "Exec", NULL);
+    session->try_exec = g_key_file_get_string(desktop_file, group, "TryExec", NULL);
+
+    g_key_file_free(desktop_file);
+    return session;
+}
+
+
+/* Drop the sessions whose `TryExec` isn't installed, then the ones a
+ * session in an earlier directory has the key of, & sort the rest by name.
+ */
+static void select_installed_sessions(GPtrArray *sessions)
+{
+    GHashTable *seen_keys = g_hash_table_new(g_str_hash, g_str_equal);
+    guint i = 0;
+    while (i < sessions->len) {
+        const Session *session = g_ptr_array_index(sessions, i);
+        gboolean is_installed = TRUE;
+        if (session->try_exec != NULL) {
+            gchar *try_exec_path = g_find_program_in_path(session->try_exec);
+            is_installed = try_exec_path != NULL;
+            g_free(try_exec_path);
+        }
+        if (!is_installed || g_hash_table_contains(seen_keys, session->key)) {
+            g_ptr_array_remove_index(sessions, i);
+        } else {
+            g_hash_table_add(seen_keys, session->key);
+            i++;
+        }
+    }
+    g_hash_table_destroy(seen_keys);
+    g_ptr_array_sort(sessions, compare_sessions);
+}
+
+
+/* Order sessions by name, like liblightdm does */
+static gint compare_sessions(gconstpointer a, gconstpointer b)
+{
+    const Session *session_a = *(Session *const *) a;
+    const Session *session_b = *(Session *const *) b;
+    return g_strcmp0(session_a->name, session_b->name);
+}
+
+
+/* Move the sessions into the ring & free the emptied array */
+static void fill_session_ring(FocusRing *ring, GPtrArray *sessions)
+{
+    for (guint i = 0; i < sessions->len; i++) {
+        focus_ring_append(ring, g_ptr_array_index(sessions, i));
+    }
+    g_ptr_array_set_free_func(sessions, NULL);
+    g_ptr_array_free(sessions, TRUE);
+}
+
+
+/* Schedule a rescan when a session directory changes */
+static void handle_session_directory_change(GFileMonitor *monitor, GFile *file,
+                                            GFile *other_file,
+                                            GFileMonitorEvent event,
+                                            gpointer user_data)
+{
+    SessionWatch *watch = user_data;
+    if (watch->rescan_timeout_id == 0) {
+        watch->rescan_timeout_id = g_timeout_add(
+            SESSION_RESCAN_DELAY_MS, handle_session_rescan, watch);
+    }
+}
+
+
+/* Rescan the session directories & refill the ring in place, keeping the
+ * selected session if it still exists.
+ *
+ * Editing a session file doesn't change its directory's mtime, so the cache
+ * is always bypassed here.
+ */
+static gboolean handle_session_rescan(gpointer user_data)
+{
+    SessionWatch *watch = user_data;
+    watch->rescan_timeout_id = 0;
+
+    gchar *selected_key = g_strdup(focus_ring_get_value(watch->ring));
+    focus_ring_clear(watch->ring);
+    fill_session_ring(watch->ring, load_sessions(watch->directories, FALSE));
+    focus_ring_scroll_to_value(watch->ring, selected_key);
+    g_message("Session list changed, %u sessions found",
+              focus_ring_get_length(watch->ring));
+    g_free(selected_key);
+
+    return G_SOURCE_REMOVE;
+}
+
+
+/* Retrieves the `key` field of a session, used to pull current session out of
+ * a FocusRing.
+ */
+static const gchar *get_session_key(gconstpointer data)
+{
+    const Session *session = data;
+    return session->key;
+}
+
+
+/* Free a Session */
+static void destroy_session(gpointer data)
+{
+    Session *session = data;
+    g_free(session->key);
+    g_free(session->name);
+    g_free(session->type);
+    g_free(session->exec);
+    g_free(session->try_exec);
+    free(session);
+}
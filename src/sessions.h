@@ -0,0 +1,34 @@
+#ifndef SESSIONS_H
+#define SESSIONS_H
+
+#include <gio/gio.h>
+#include <glib.h>
+
+#include "focus_ring.h"
+
+
+// A session parsed from a .desktop file in one of the session directories
+typedef struct Session_ {
+    gchar *key;
+    gchar *name;
+    /* "x" or "wayland" */
+    gchar *type;
+    gchar *exec;
+    /* The program the session needs installed, may be NULL */
+    gchar *try_exec;
+} Session;
+
+// Keeps a session ring in sync with the session directories
+typedef struct SessionWatch_ {
+    FocusRing  *ring;
+    gchar     **directories;
+    GPtrArray  *monitors;
+    guint       rescan_timeout_id;
+} SessionWatch;
+
+
+FocusRing *initialize_session_ring(void);
+SessionWatch *initialize_session_watch(FocusRing *ring);
+void destroy_session_watch(SessionWatch *watch);
+
+#endif
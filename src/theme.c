@@ -0,0 +1,192 @@
+/* Functions for building the greeter's CSS from the Configuration.
+ *
+ * The CSS is split into components that each get their own style provider,
+ * so a config reload only re-parses the components whose CSS changed.
+ * Colors are rendered into temporary strings that are freed as soon as the
+ * CSS is built, so building the CSS doesn't leak.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <gdk/gdk.h>
+#include <glib.h>
+
+#include "theme.h"
+
+
+static char *build_password_css(const Config *config);
+
+
+/* Build the CSS for one theme component.
+ *
+ * Returns a string that must be freed with `free`, or NULL on failure.
+ */
+char *build_theme_css(const Config *config, ThemeComponent component)
+{
+    char *css = NULL;
+    gchar *first_color = NULL;
+    gchar *second_color = NULL;
+    int css_string_length = -1;
+
+    switch (component) {
+        case THEME_FONTS:
+            css_string_length = asprintf(&css,
+                "* {\n"
+                    "font-family: %s;\n"
+                    "font-size: %s;\n"
+                    "font-weight: %s;\n"
+                    "font-style: %s;\n"
+                "}\n"
+                , config->font
+                , config->font_size
+                , config->font_weight
+                , config->font_style
+            );
+            break;
+        case THEME_LABELS:
+            first_color = gdk_rgba_to_string(config->text_color);
+            css_string_length = asprintf(&css,
+                "label {\n"
+                    "color: %s;\n"
+                "}\n"
+                , first_color
+            );
+            break;
+        case THEME_BACKGROUND:
+            first_color = gdk_rgba_to_string(config->background_color);
+            css_string_length = asprintf(&css,
+                "#background {\n"
+                    "background-color: %s;\n"
+                "}\n"
+                , first_color
+            );
+            break;
+        case THEME_MAIN_WINDOW:
+            first_color = gdk_rgba_to_string(config->border_color);
+            second_color = gdk_rgba_to_string(config->window_color);
+            css_string_length = asprintf(&css,
+                "#main {\n"
+                    "border-width: %s;\n"
+                    "border-color: %s;\n"
+                    "border-style: solid;\n"
+                    "background-color: %s;\n"
+                "}\n"
+                , config->border_width
+                , first_color
+                , second_color
+            );
+            break;
+        case THEME_PASSWORD:
+            return build_password_css(config);
+        case THEME_IDLE:
+            css_string_length = asprintf(&css,
+                "window#background.idle, window#main.idle {\n"
+                    "background: black;\n"
+                    "border-color: black;\n"
+                "}\n"
+                "window#main.idle * {\n"
+                    "opacity: 0;\n"
+                "}\n"
+            );
+            break;
+        case THEME_ERROR:
+            first_color = gdk_rgba_to_string(config->error_color);
+            css_string_length = asprintf(&css,
+                "label#error {\n"
+                    "color: %s;\n"
+                "}\n"
+                , first_color
+            );
+            break;
+        case THEME_BACKGROUND_IMAGE:
+            first_color = gdk_rgba_to_string(config->background_color);
+            css_string_length = asprintf(&css,
+                "#background.with-image {\n"
+                    "background-image: image(url(%s), %s);\n"
+                    "background-repeat: no-repeat;\n"
+                    "background-size: %s;\n"
+                    "background-position: center;\n"
+                "}\n"
+                , config->background_image
+                , first_color
+                , config->background_image_size
+            );
+            break;
+        case THEME_SYS_INFO:
+            first_color = gdk_rgba_to_string(config->sys_info_color);
+            css_string_length = asprintf(&css,
+                "#info {\n"
+                    "margin: %s;\n"
+                "}\n"
+                "#info label {\n"
+                    "font-family: %s;\n"
+                    "font-size: %s;\n"
+                    "color: %s;\n"
+                "}\n"
+                , config->sys_info_margin
+                , config->sys_info_font
+                , config->sys_info_font_size
+                , first_color
+            );
+            break;
+        case THEME_COMPONENT_COUNT:
+        default:
+            break;
+    }
+
+    g_free(first_color);
+    g_free(second_color);
+
+    return css_string_length >= 0 ? css : NULL;
+}
+
+
+/* Build the CSS for the password input, which uses more colors than any
+ * other component.
+ */
+static char *build_password_css(const Config *config)
+{
+    const GdkRGBA *caret_color;
+    if (config->show_input_cursor) {
+        caret_color = config->password_color;
+    } else {
+        caret_color = config->password_background_color;
+    }
+
+    gchar *password_color = gdk_rgba_to_string(config->password_color);
+    gchar *password_caret_color = gdk_rgba_to_string(caret_color);
+    gchar *password_background_color =
+        gdk_rgba_to_string(config->password_background_color);
+    gchar *password_border_color =
+        gdk_rgba_to_string(config->password_border_color);
+
+    char *css;
+    int css_string_length = asprintf(&css,
+        "#password {\n"
+            "color: %s;\n"
+            "caret-color: %s;\n"
+            "background-color: %s;\n"
+            "border-width: %s;\n"
+            "border-color: %s;\n"
+            "border-style: solid;\n"
+            "border-radius: %s;\n"
+            "background-image: none;\n"
+            "box-shadow: none;\n"
+            "border-image-width: 0;\n"
+        "}\n"
+        , password_color
+        , password_caret_color
+        , password_background_color
+        , config->password_border_width
+        , password_border_color
+        , config->password_border_radius
+    );
+
+    g_free(password_color);
+    g_free(password_caret_color);
+    g_free(password_background_color);
+    g_free(password_border_color);
+
+    return css_string_length >= 0 ? css : NULL;
+}
@@ -0,0 +1,34 @@
+#ifndef THEME_H
+#define THEME_H
+
+#include "config.h"
+
+
+/* The independently reloadable parts of the greeter's CSS.
+ *
+ * Some components set the same property on a widget, e.g. the `*` font &
+ * the `#info label` font. Each component's provider has its own priority,
+ * rising in this order, so later components win no matter when their
+ * providers are added or reloaded.
+ */
+typedef enum {
+    /* Needed for the first frame */
+    THEME_FONTS,
+    THEME_LABELS,
+    THEME_BACKGROUND,
+    THEME_MAIN_WINDOW,
+    THEME_PASSWORD,
+    THEME_IDLE,
+    /* Loaded after the first frame by `staged_startup` */
+    THEME_ERROR,
+    THEME_BACKGROUND_IMAGE,
+    THEME_SYS_INFO,
+    THEME_COMPONENT_COUNT
+} ThemeComponent;
+
+#define THEME_FIRST_DEFERRED THEME_ERROR
+
+
+char *build_theme_css(const Config *config, ThemeComponent component);
+
+#endif
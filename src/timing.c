@@ -0,0 +1,129 @@
+/* Startup Phase Timing Instrumentation
+ *
+ * Every phase is timestamped with the monotonic clock, relative to the start
+ * of `main`. Recording is always on since it only costs a clock read, but the
+ * report is only written if a report file has been set.
+ */
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "timing.h"
+
+
+typedef struct PhaseTiming_ {
+    gint64 begin;
+    gint64 end;
+} PhaseTiming;
+
+static const gchar *const phase_names[TIMING_PHASE_COUNT] = {
+    [TIMING_GTK_INIT]             = "gtk_init",
+    [TIMING_INITIALIZE_CONFIG]    = "initialize_config",
+    [TIMING_INITIALIZE_UI]        = "initialize_ui",
+    [TIMING_ATTACH_CSS]           = "attach_config_colors_to_screen",
+    [TIMING_CONNECT_TO_DAEMON]    = "connect_to_lightdm_daemon",
+    [TIMING_BEGIN_AUTHENTICATION] = "begin_authentication_as_default_user",
+    [TIMING_SESSION_FOCUS_RING]   = "make_session_focus_ring",
+    [TIMING_FIRST_FRAME]          = "first_frame",
+};
+
+static gint64 process_start = 0;
+static PhaseTiming phases[TIMING_PHASE_COUNT];
+static gchar *report_path = NULL;
+static gboolean report_written = FALSE;
+
+static void write_timing_report(void);
+
+
+/* Record the reference time that all phases are measured against */
+void initialize_timing(void)
+{
+    process_start = g_get_monotonic_time();
+    for (int p = 0; p < TIMING_PHASE_COUNT; p++) {
+        phases[p].begin = -1;
+        phases[p].end = -1;
+    }
+}
+
+
+/* Set the path the JSON report is written to once every phase has ended.
+ *
+ * A NULL or empty path disables the report.
+ */
+void timing_set_report_file(const gchar *report_file)
+{
+    g_free(report_path);
+    if (report_file == NULL || report_file[0] == '\0') {
+        report_path = NULL;
+    } else {
+        report_path = g_strdup(report_file);
+    }
+}
+
+
+/* Mark the beginning of a phase */
+void timing_phase_begin(TimingPhase phase)
+{
+    phases[phase].begin = g_get_monotonic_time() - process_start;
+}
+
+
+/* Mark the end of a phase, writing the report if it was the last one */
+void timing_phase_end(TimingPhase phase)
+{
+    if (phases[phase].end >= 0) {
+        return;
+    }
+    phases[phase].end = g_get_monotonic_time() - process_start;
+
+    for (int p = 0; p < TIMING_PHASE_COUNT; p++) {
+        if (phases[p].end < 0) {
+            return;
+        }
+    }
+    write_timing_report();
+}
+
+
+/* Write the phase timings as a JSON object to the report file.
+ *
+ * All times are in microseconds since the start of `main`. The file is
+ * replaced atomically so readers never see a partial report.
+ */
+static void write_timing_report(void)
+{
+    if (report_path == NULL || report_written) {
+        return;
+    }
+
+    GString *json = g_string_new("{\n");
+    g_string_append_printf(json, "  \"pid\": %d,\n", (int) getpid());
+    g_string_append(json, "  \"clock\": \"monotonic\",\n");
+    g_string_append(json, "  \"unit\": \"us\",\n");
+    g_string_append(json, "  \"phases\": [\n");
+    gint64 total = 0;
+    for (int p = 0; p < TIMING_PHASE_COUNT; p++) {
+        gint64 begin = phases[p].begin < 0 ? 0 : phases[p].begin;
+        g_string_append_printf(
+            json,
+            "    {\"name\": \"%s\", \"begin\": %" G_GINT64_FORMAT
+            ", \"end\": %" G_GINT64_FORMAT ", \"duration\": %" G_GINT64_FORMAT "}%s\n",
+            phase_names[p], begin, phases[p].end, phases[p].end - begin,
+            p < TIMING_PHASE_COUNT - 1 ? "," : "");
+        total = MAX(total, phases[p].end);
+    }
+    g_string_append(json, "  ],\n");
+    g_string_append_printf(json, "  \"total\": %" G_GINT64_FORMAT "\n}\n", total);
+
+    GError *write_error = NULL;
+    if (!g_file_set_contents(report_path, json->str, (gssize) json->len, &write_error)) {
+        g_warning("Could not write startup timing report to %s: %s",
+                  report_path, write_error->message);
+        g_error_free(write_error);
+    } else {
+        g_message("Wrote startup timing report to %s", report_path);
+    }
+    report_written = TRUE;
+
+    g_string_free(json, TRUE);
+}
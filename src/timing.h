@@ -0,0 +1,26 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <glib.h>
+
+
+// The startup phases that are timed, in the order they normally run.
+typedef enum {
+    TIMING_GTK_INIT,
+    TIMING_INITIALIZE_CONFIG,
+    TIMING_INITIALIZE_UI,
+    TIMING_ATTACH_CSS,
+    TIMING_CONNECT_TO_DAEMON,
+    TIMING_BEGIN_AUTHENTICATION,
+    TIMING_SESSION_FOCUS_RING,
+    TIMING_FIRST_FRAME,
+    TIMING_PHASE_COUNT
+} TimingPhase;
+
+
+void initialize_timing(void);
+void timing_set_report_file(const gchar *report_file);
+void timing_phase_begin(TimingPhase phase);
+void timing_phase_end(TimingPhase phase);
+
+#endif
@@ -0,0 +1,176 @@
+/* Typeahead Buffering
+ *
+ * The keyboard is grabbed right after GTK connects to the display, before
+ * the configuration & windows are loaded, so keys typed during startup are
+ * queued for the greeter instead of being lost. Until the password input is
+ * on screen, key presses are kept in a locked region instead of being handed
+ * to GTK, then replayed into the input in the order they were typed. An
+ * Enter activates the input, submitting the password.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+
+#include "secure_buffer.h"
+#include "typeahead.h"
+
+
+// The size of the locked region, the same as the password buffer's
+#define TYPEAHEAD_BUFFER_SIZE 4096
+#define TYPEAHEAD_MAX_KEYS (TYPEAHEAD_BUFFER_SIZE / sizeof(gunichar))
+
+// Editing keys are stored as control characters
+#define TYPEAHEAD_BACKSPACE ((gunichar) '\b')
+#define TYPEAHEAD_ENTER     ((gunichar) '\n')
+
+static void handle_typeahead_event(GdkEvent *event, gpointer user_data);
+static void buffer_key_press(Typeahead *typeahead, const GdkEventKey *event);
+static void release_keyboard(Typeahead *typeahead);
+
+
+/* Grab the keyboard & start buffering key presses.
+ *
+ * The grab can fail, e.g. under Wayland or when another client holds it.
+ * Keys that reach our own windows are still buffered then.
+ */
+Typeahead *initialize_typeahead(void)
+{
+    Typeahead *typeahead = malloc(sizeof(Typeahead));
+    if (typeahead == NULL) {
+        g_error("Could not allocate memory for Typeahead");
+    }
+    typeahead->keys = secure_memory_alloc(TYPEAHEAD_BUFFER_SIZE, "typeahead buffer");
+    typeahead->key_count = 0;
+    typeahead->buffering = TRUE;
+    typeahead->hotkey_mask = GDK_CONTROL_MASK | GDK_MOD1_MASK;
+    typeahead->seat = gdk_display_get_default_seat(gdk_display_get_default());
+
+    GdkGrabStatus grab_status = gdk_seat_grab(
+        typeahead->seat, gdk_get_default_root_window(),
+        GDK_SEAT_CAPABILITY_KEYBOARD, FALSE, NULL, NULL, NULL, NULL);
+    typeahead->grabbed = grab_status == GDK_GRAB_SUCCESS;
+    if (!typeahead->grabbed) {
+        g_message("Could not grab the keyboard for typeahead, status %d",
+                  grab_status);
+    }
+    gdk_event_handler_set(handle_typeahead_event, typeahead, NULL);
+
+    return typeahead;
+}
+
+
+/* Stop buffering & free the buffer, without replaying it */
+void destroy_typeahead(Typeahead *typeahead)
+{
+    gdk_event_handler_set(handle_typeahead_event, NULL, NULL);
+    release_keyboard(typeahead);
+    secure_memory_free(typeahead->keys, TYPEAHEAD_BUFFER_SIZE);
+    free(typeahead);
+}
+
+
+/* Stop buffering key presses that use the configured hotkey modifier */
+void typeahead_set_hotkey_mask(Typeahead *typeahead, guint hotkey_mask)
+{
+    typeahead->hotkey_mask = GDK_CONTROL_MASK | GDK_MOD1_MASK | hotkey_mask;
+}
+
+
+/* Release the keyboard & type the buffered keys into the password input.
+ *
+ * Replaying stops at the first Enter, which activates the input. Anything
+ * typed after it was meant for a prompt that doesn't exist yet, so it's
+ * dropped. Later key presses are handed to GTK as usual.
+ */
+void typeahead_replay(Typeahead *typeahead, GtkEntry *password_input)
+{
+    if (!typeahead->buffering) {
+        return;
+    }
+    typeahead->buffering = FALSE;
+    release_keyboard(typeahead);
+    if (typeahead->key_count == 0) {
+        return;
+    }
+    g_message("Replaying %u keys typed during startup", typeahead->key_count);
+
+    GtkEditable *editable = GTK_EDITABLE(password_input);
+    gint position = gtk_editable_get_position(editable);
+    gchar utf8_char[6];
+    for (guint k = 0; k < typeahead->key_count; k++) {
+        const gunichar key = typeahead->keys[k];
+        if (key == TYPEAHEAD_ENTER) {
+            gtk_editable_set_position(editable, position);
+            gtk_widget_activate(GTK_WIDGET(password_input));
+            break;
+        } else if (key == TYPEAHEAD_BACKSPACE) {
+            if (position > 0) {
+                gtk_editable_delete_text(editable, position - 1, position);
+                position--;
+            }
+        } else {
+            gint char_length = g_unichar_to_utf8(key, utf8_char);
+            gtk_editable_insert_text(editable, utf8_char, char_length, &position);
+        }
+    }
+    gtk_editable_set_position(editable, position);
+
+    explicit_bzero(utf8_char, sizeof(utf8_char));
+    explicit_bzero(typeahead->keys, typeahead->key_count * sizeof(gunichar));
+    typeahead->key_count = 0;
+}
+
+
+/* Keep key presses out of GTK while buffering, passing everything else on */
+static void handle_typeahead_event(GdkEvent *event, gpointer user_data)
+{
+    Typeahead *typeahead = user_data;
+    if (typeahead != NULL && typeahead->buffering) {
+        if (event->type == GDK_KEY_PRESS) {
+            buffer_key_press(typeahead, &event->key);
+            return;
+        } else if (event->type == GDK_KEY_RELEASE) {
+            return;
+        }
+    }
+    gtk_main_do_event(event);
+}
+
+
+/* Store a typed character, Backspace or Enter. Other keys are dropped. */
+static void buffer_key_press(Typeahead *typeahead, const GdkEventKey *event)
+{
+    if (event->state & typeahead->hotkey_mask ||
+            typeahead->key_count >= TYPEAHEAD_MAX_KEYS) {
+        return;
+    }
+    gunichar key;
+    switch (event->keyval) {
+        case GDK_KEY_Return:
+        case GDK_KEY_KP_Enter:
+        case GDK_KEY_ISO_Enter:
+            key = TYPEAHEAD_ENTER;
+            break;
+        case GDK_KEY_BackSpace:
+            key = TYPEAHEAD_BACKSPACE;
+            break;
+        default:
+            key = gdk_keyval_to_unicode(event->keyval);
+            if (key == 0 || !g_unichar_isprint(key)) {
+                return;
+            }
+    }
+    typeahead->keys[typeahead->key_count++] = key;
+}
+
+
+/* Let other clients have the keyboard again */
+static void release_keyboard(Typeahead *typeahead)
+{
+    if (typeahead->grabbed) {
+        gdk_seat_ungrab(typeahead->seat);
+        typeahead->grabbed = FALSE;
+    }
+}
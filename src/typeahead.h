@@ -0,0 +1,25 @@
+#ifndef TYPEAHEAD_H
+#define TYPEAHEAD_H
+
+#include <gtk/gtk.h>
+
+
+// Buffers the keys typed before the password input is ready for them
+typedef struct Typeahead_ {
+    GdkSeat  *seat;
+    gboolean  grabbed;
+    gboolean  buffering;
+    /* Characters & editing keys in a locked region, see `typeahead.c` */
+    gunichar *keys;
+    guint     key_count;
+    // Keys with these modifiers are hotkeys, so they aren't buffered
+    guint     hotkey_mask;
+} Typeahead;
+
+
+Typeahead *initialize_typeahead(void);
+void destroy_typeahead(Typeahead *typeahead);
+void typeahead_set_hotkey_mask(Typeahead *typeahead, guint hotkey_mask);
+void typeahead_replay(Typeahead *typeahead, GtkEntry *password_input);
+
+#endif
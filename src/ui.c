@@ -8,44 +8,143 @@
 #include <glib.h>
 #include <lightdm.h>
 
+#include "background.h"
 #include "callbacks.h"
+#include "layer_shell.h"
+#include "memory_report.h"
+#include "secure_buffer.h"
+#include "theme.h"
+#include "timing.h"
 #include "ui.h"
 #include "utils.h"
 
 
+// A monitor's part of the spanning background window
+typedef struct BackgroundRegion_ {
+    /* Relative to the spanning window */
+    gint             x;
+    gint             y;
+    cairo_surface_t *image;
+} BackgroundRegion;
+
+
 static UI *new_ui(void);
 static void setup_background_windows(Config *config, UI *ui);
+static void setup_spanning_background_window(Config *config, UI *ui);
+static void update_spanning_background_window(Config *config, UI *ui,
+                                              GdkMonitor *removed_monitor);
+static void clear_background_region(BackgroundRegion *region);
+static gboolean draw_background_regions(GtkWidget *background_window, cairo_t *cr,
+                                        UI *ui);
+static gboolean background_image_is_shown(Config *config, GdkMonitor *monitor);
+static void attach_background_images(Config *config, UI *ui);
+static void attach_background_image_if_shown(Config *config, UI *ui,
+                                             GdkMonitor *monitor,
+                                             GtkWindow *background_window);
+static void detach_background_image(GtkWindow *background_window);
+static int find_background_window(UI *ui, GdkMonitor *monitor);
+static void attach_background_image(UI *ui, GdkMonitor *monitor,
+                                    GtkWindow *background_window);
+static gboolean draw_background_image(GtkWidget *background_window, cairo_t *cr,
+                                      cairo_surface_t *image);
 static GtkWindow *new_background_window(GdkMonitor *monitor);
 static void set_window_to_monitor_size(GdkMonitor *monitor, GtkWindow *window);
+static void set_window_to_area(const GdkRectangle *area, GtkWindow *window);
 static void hide_mouse_cursor(GtkWidget *window, gpointer user_data);
 static void move_mouse_to_background_window(void);
 static void setup_main_window(Config *config, UI *ui);
 static void place_main_window(GtkWidget *main_window, gpointer user_data);
+static void recenter_main_window(GtkWidget *main_window, GdkRectangle *allocation,
+                                 gpointer user_data);
+static void center_window_on_primary_monitor(GtkWindow *window, gint width,
+                                             gint height);
 static void create_and_attach_layout_container(UI *ui);
 static void create_and_attach_sys_info_label(Config *config, UI *ui);
+static void create_and_attach_user_label(Config *config, UI *ui);
 static void create_and_attach_password_field(Config *config, UI *ui);
 static void create_and_attach_feedback_label(UI *ui);
-static void attach_config_colors_to_screen(Config *config);
+static void attach_theme_components(Config *config, UI *ui,
+                                    ThemeComponent first, ThemeComponent last);
+static gboolean attach_theme_component(Config *config, UI *ui,
+                                       ThemeComponent component);
 
 
-/* Initialize the Main Window & it's Children */
+/* Initialize the Main Window & it's Children
+ *
+ * With `staged_startup` enabled, only the background colors & the password
+ * input are built here. The rest is added by `load_next_deferred_ui_stage`
+ * once the first frame is on screen.
+ */
 UI *initialize_ui(Config *config)
 {
+    timing_phase_begin(TIMING_INITIALIZE_UI);
     UI *ui = new_ui();
 
     setup_background_windows(config, ui);
+    memory_report_sample("setup_background_windows");
     move_mouse_to_background_window();
     setup_main_window(config, ui);
     create_and_attach_layout_container(ui);
-    create_and_attach_sys_info_label(config, ui);
+    if (!config->staged_startup) {
+        attach_background_images(config, ui);
+        memory_report_sample("attach_background_images");
+        create_and_attach_sys_info_label(config, ui);
+    }
+    create_and_attach_user_label(config, ui);
     create_and_attach_password_field(config, ui);
     create_and_attach_feedback_label(ui);
-    attach_config_colors_to_screen(config);
+    gtk_widget_grab_focus(ui->password_input);
+    memory_report_sample("setup_main_window");
+    timing_phase_end(TIMING_INITIALIZE_UI);
+
+    timing_phase_begin(TIMING_ATTACH_CSS);
+    if (config->staged_startup) {
+        attach_theme_components(config, ui, 0, THEME_FIRST_DEFERRED);
+    } else {
+        attach_theme_components(config, ui, 0, THEME_COMPONENT_COUNT);
+    }
+    memory_report_sample("attach_css");
+    timing_phase_end(TIMING_ATTACH_CSS);
 
     return ui;
 }
 
 
+/* Build the next part of the UI that `staged_startup` held back.
+ *
+ * Each stage is small enough to run between frames, so input keeps being
+ * handled while the rest of the greeter loads. Returns FALSE once every stage
+ * has been loaded.
+ */
+gboolean load_next_deferred_ui_stage(Config *config, UI *ui)
+{
+    switch (ui->deferred_stage) {
+        case DEFERRED_UI_THEME:
+            attach_theme_components(config, ui, THEME_FIRST_DEFERRED,
+                                    THEME_COMPONENT_COUNT);
+            memory_report_sample("attach_deferred_css");
+            break;
+        case DEFERRED_UI_BACKGROUND_IMAGE:
+            attach_background_images(config, ui);
+            memory_report_sample("attach_background_images");
+            break;
+        case DEFERRED_UI_SYS_INFO:
+            create_and_attach_sys_info_label(config, ui);
+            if (ui->info_container != NULL) {
+                gtk_widget_show_all(GTK_WIDGET(ui->info_container));
+            }
+            memory_report_sample("create_sys_info");
+            break;
+        case DEFERRED_UI_DONE:
+        default:
+            return FALSE;
+    }
+    ui->deferred_stage++;
+
+    return ui->deferred_stage < DEFERRED_UI_DONE;
+}
+
+
 /* Create a new UI with all values initialized to NULL */
 static UI *new_ui(void)
 {
@@ -55,76 +154,447 @@ static UI *new_ui(void)
     }
     ui->background_windows = NULL;
     ui->monitor_count = 0;
+    ui->spans_monitors = FALSE;
+    ui->background_regions = NULL;
     ui->main_window = NULL;
     ui->layout_container = NULL;
+    ui->info_container = NULL;
+    ui->sys_info_label = NULL;
+    ui->time_label = NULL;
+    ui->user_container = NULL;
+    ui->user_avatar = NULL;
+    ui->user_label = NULL;
+    ui->user_name = NULL;
     ui->password_label = NULL;
     ui->password_input = NULL;
     ui->feedback_label = NULL;
+    ui->background_cache = NULL;
+    ui->deferred_stage = DEFERRED_UI_THEME;
+    for (int c = 0; c < THEME_COMPONENT_COUNT; c++) {
+        ui->theme_providers[c] = NULL;
+        ui->theme_css[c] = NULL;
+    }
 
     return ui;
 }
 
 
-/* Create a Background Window for Every Monitor */
+/* Destroy the UI's windows, then free it & its background cache */
+void destroy_ui(UI *ui)
+{
+    // The main loop has already quit, so don't quit it again
+    g_signal_handlers_disconnect_matched(
+        ui->main_window, G_SIGNAL_MATCH_ID,
+        g_signal_lookup("destroy", GTK_TYPE_WIDGET), 0, NULL, NULL, NULL);
+    gtk_widget_destroy(GTK_WIDGET(ui->main_window));
+    for (int m = 0; m < ui->monitor_count; m++) {
+        gtk_widget_destroy(GTK_WIDGET(ui->background_windows[m]));
+    }
+    GdkScreen *screen = gdk_screen_get_default();
+    for (int c = 0; c < THEME_COMPONENT_COUNT; c++) {
+        if (ui->theme_providers[c] != NULL) {
+            gtk_style_context_remove_provider_for_screen(
+                screen, GTK_STYLE_PROVIDER(ui->theme_providers[c]));
+            g_object_unref(ui->theme_providers[c]);
+        }
+        free(ui->theme_css[c]);
+    }
+    if (ui->background_cache != NULL) {
+        destroy_background_cache(ui->background_cache);
+    }
+    if (ui->background_regions != NULL) {
+        g_array_unref(ui->background_regions);
+    }
+    free(ui->background_windows);
+    g_free(ui->user_name);
+    free(ui);
+}
+
+
+/* Create a Background Window for Every Monitor, or One Spanning Them All */
 static void setup_background_windows(Config *config, UI *ui)
 {
+    if (config->span_background) {
+        if (!layer_shell_is_active()) {
+            setup_spanning_background_window(config, ui);
+            return;
+        }
+        g_message("Layer surfaces can't span monitors, "
+                  "using a background window per monitor");
+    }
     GdkDisplay *display = gdk_display_get_default();
-    ui->monitor_count = gdk_display_get_n_monitors(display);
-    ui->background_windows = malloc((uint) ui->monitor_count * sizeof (GtkWindow *));
-    for (int m = 0; m < ui->monitor_count; m++) {
+    int monitor_count = gdk_display_get_n_monitors(display);
+    for (int m = 0; m < monitor_count; m++) {
         GdkMonitor *monitor = gdk_display_get_monitor(display, m);
-        if (monitor == NULL) {
-            break;
+        if (monitor != NULL) {
+            add_background_window(config, ui, monitor);
         }
+    }
+}
+
+
+/* Create a single background window covering every monitor.
+ *
+ * Each monitor's image is painted into its part of the window by one draw
+ * handler, so there's only one X window to realize, style & stack no matter
+ * how many monitors are connected.
+ */
+static void setup_spanning_background_window(Config *config, UI *ui)
+{
+    ui->background_windows = malloc(sizeof(GtkWindow *));
+    if (ui->background_windows == NULL) {
+        g_error("Could not allocate memory for background windows");
+    }
+    ui->background_regions = g_array_new(FALSE, FALSE, sizeof(BackgroundRegion));
+    g_array_set_clear_func(ui->background_regions,
+                           (GDestroyNotify) clear_background_region);
+
+    GtkWindow *background_window = new_background_window(NULL);
+    g_signal_connect_after(background_window, "draw",
+                           G_CALLBACK(draw_background_regions), ui);
+    ui->background_windows[0] = background_window;
+    ui->monitor_count = 1;
+    ui->spans_monitors = TRUE;
+
+    update_spanning_background_window(config, ui, NULL);
+}
+
+
+/* Fit the spanning background window to the monitors & fetch their images.
+ *
+ * The `removed_monitor` is skipped, in case the display still lists it while
+ * it's being disconnected.
+ */
+static void update_spanning_background_window(Config *config, UI *ui,
+                                              GdkMonitor *removed_monitor)
+{
+    GtkWindow *background_window = ui->background_windows[0];
+    GdkDisplay *display = gdk_display_get_default();
+    int monitor_count = gdk_display_get_n_monitors(display);
 
-        GtkWindow *background_window = new_background_window(monitor);
-        ui->background_windows[m] = background_window;
+    GdkRectangle area = { 0, 0, 0, 0 };
+    gboolean has_area = FALSE;
+    for (int m = 0; m < monitor_count; m++) {
+        GdkMonitor *monitor = gdk_display_get_monitor(display, m);
+        if (monitor == NULL || monitor == removed_monitor) {
+            continue;
+        }
+        GdkRectangle geometry;
+        gdk_monitor_get_geometry(monitor, &geometry);
+        if (has_area) {
+            gdk_rectangle_union(&area, &geometry, &area);
+        } else {
+            area = geometry;
+            has_area = TRUE;
+        }
+    }
+    if (has_area) {
+        set_window_to_area(&area, background_window);
+    }
 
-        gboolean show_background_image =
-            (gdk_monitor_is_primary(monitor) || config->show_image_on_all_monitors) &&
-            (strcmp(config->background_image, "\"\"") != 0);
-        if (show_background_image) {
-            GtkStyleContext *style_context =
-                gtk_widget_get_style_context(GTK_WIDGET(background_window));
-            gtk_style_context_add_class(style_context, "with-image");
+    detach_background_image(background_window);
+    g_array_set_size(ui->background_regions, 0);
+    if (ui->background_cache != NULL) {
+        for (int m = 0; m < monitor_count; m++) {
+            GdkMonitor *monitor = gdk_display_get_monitor(display, m);
+            if (monitor == NULL || monitor == removed_monitor ||
+                    !background_image_is_shown(config, monitor)) {
+                continue;
+            }
+            GdkRectangle geometry;
+            gdk_monitor_get_geometry(monitor, &geometry);
+            cairo_surface_t *image = background_cache_get_image(
+                ui->background_cache, &geometry, gdk_monitor_get_scale_factor(monitor));
+            if (image == NULL) {
+                // GTK scales the image across the whole window instead
+                gtk_style_context_add_class(
+                    gtk_widget_get_style_context(GTK_WIDGET(background_window)),
+                    "with-image");
+                break;
+            }
+            BackgroundRegion region = {
+                .x = geometry.x - area.x,
+                .y = geometry.y - area.y,
+                .image = image,
+            };
+            g_array_append_val(ui->background_regions, region);
         }
+        background_cache_release_source(ui->background_cache);
+    }
+    gtk_widget_queue_draw(GTK_WIDGET(background_window));
+}
+
+
+/* Release a spanning window region's reference to its image */
+static void clear_background_region(BackgroundRegion *region)
+{
+    cairo_surface_destroy(region->image);
+}
+
+
+/* Paint each monitor's image into its part of the spanning window */
+static gboolean draw_background_regions(GtkWidget *background_window, cairo_t *cr,
+                                        UI *ui)
+{
+    // Leave the window blank in idle mode
+    if (gtk_style_context_has_class(
+            gtk_widget_get_style_context(background_window), "idle")) {
+        return FALSE;
+    }
+    for (guint r = 0; r < ui->background_regions->len; r++) {
+        BackgroundRegion *region =
+            &g_array_index(ui->background_regions, BackgroundRegion, r);
+        cairo_set_source_surface(cr, region->image, region->x, region->y);
+        cairo_paint(cr);
+    }
+
+    return FALSE;
+}
+
+
+/* Create a background window for a newly connected monitor.
+ *
+ * The background image is attached right away, unless it hasn't been loaded
+ * yet. The caller is responsible for showing the window. Returns NULL when
+ * the spanning background window was resized to cover the monitor instead.
+ */
+GtkWindow *add_background_window(Config *config, UI *ui, GdkMonitor *monitor)
+{
+    if (ui->spans_monitors) {
+        update_spanning_background_window(config, ui, NULL);
+        return NULL;
+    }
+    GtkWindow **background_windows = realloc(
+        ui->background_windows, (size_t) (ui->monitor_count + 1) * sizeof(GtkWindow *));
+    if (background_windows == NULL) {
+        g_error("Could not allocate memory for background windows");
+    }
+    ui->background_windows = background_windows;
+
+    GtkWindow *background_window = new_background_window(monitor);
+    ui->background_windows[ui->monitor_count] = background_window;
+    ui->monitor_count++;
+
+    if (ui->background_cache != NULL) {
+        attach_background_image_if_shown(config, ui, monitor, background_window);
+        background_cache_release_source(ui->background_cache);
+    }
+    return background_window;
+}
+
+
+/* Destroy the background window of a disconnected monitor */
+void remove_background_window(Config *config, UI *ui, GdkMonitor *monitor)
+{
+    if (ui->spans_monitors) {
+        update_spanning_background_window(config, ui, monitor);
+        return;
+    }
+    int index = find_background_window(ui, monitor);
+    if (index < 0) {
+        return;
+    }
+    gtk_widget_destroy(GTK_WIDGET(ui->background_windows[index]));
+    ui->monitor_count--;
+    memmove(&ui->background_windows[index], &ui->background_windows[index + 1],
+            (size_t) (ui->monitor_count - index) * sizeof(GtkWindow *));
+}
+
+
+/* Resize a monitor's background window after its geometry or scale changed.
+ *
+ * Only the image for the new size is fetched from the background cache, any
+ * other monitors keep their images.
+ */
+void update_background_window(Config *config, UI *ui, GdkMonitor *monitor)
+{
+    if (ui->spans_monitors) {
+        update_spanning_background_window(config, ui, NULL);
+        return;
+    }
+    int index = find_background_window(ui, monitor);
+    if (index < 0) {
+        return;
+    }
+    GtkWindow *background_window = ui->background_windows[index];
+    // Layer surfaces are resized by the compositor
+    if (!layer_shell_is_active()) {
+        set_window_to_monitor_size(monitor, background_window);
+    }
+
+    if (ui->background_cache != NULL) {
+        detach_background_image(background_window);
+        attach_background_image_if_shown(config, ui, monitor, background_window);
+        background_cache_release_source(ui->background_cache);
+    }
+    gtk_widget_queue_draw(GTK_WIDGET(background_window));
+}
+
+
+/* Find the index of a monitor's background window, or -1 if it has none */
+static int find_background_window(UI *ui, GdkMonitor *monitor)
+{
+    for (int m = 0; m < ui->monitor_count; m++) {
+        GObject *background_window = G_OBJECT(ui->background_windows[m]);
+        if (g_object_get_data(background_window, "monitor") == monitor) {
+            return m;
+        }
+    }
+    return -1;
+}
+
+
+/* Show the Background Image on the Primary or Every Monitor */
+static void attach_background_images(Config *config, UI *ui)
+{
+    if (ui->background_cache == NULL) {
+        ui->background_cache = initialize_background_cache(config);
+    }
+    if (ui->spans_monitors) {
+        update_spanning_background_window(config, ui, NULL);
+        return;
+    }
+    for (int m = 0; m < ui->monitor_count; m++) {
+        GtkWindow *background_window = ui->background_windows[m];
+        GdkMonitor *monitor =
+            g_object_get_data(G_OBJECT(background_window), "monitor");
+        attach_background_image_if_shown(config, ui, monitor, background_window);
+    }
+    background_cache_release_source(ui->background_cache);
+}
+
+
+/* Attach the background image if the monitor should show it */
+static void attach_background_image_if_shown(Config *config, UI *ui,
+                                             GdkMonitor *monitor,
+                                             GtkWindow *background_window)
+{
+    if (background_image_is_shown(config, monitor)) {
+        attach_background_image(ui, monitor, background_window);
+    }
+}
+
+
+/* Determine if a monitor should show the background image */
+static gboolean background_image_is_shown(Config *config, GdkMonitor *monitor)
+{
+    return (gdk_monitor_is_primary(monitor) || config->show_image_on_all_monitors) &&
+        (strcmp(config->background_image, "\"\"") != 0);
+}
+
+
+/* Show the background image on a background window.
+ *
+ * The pre-scaled image from the background cache is painted by a draw
+ * handler when possible, sharing one surface between same-sized monitors.
+ * Otherwise we fall back to GTK's CSS image scaling via the `with-image`
+ * class.
+ */
+static void attach_background_image(UI *ui, GdkMonitor *monitor,
+                                    GtkWindow *background_window)
+{
+    GdkRectangle geometry;
+    gdk_monitor_get_geometry(monitor, &geometry);
+    cairo_surface_t *image = background_cache_get_image(
+        ui->background_cache, &geometry, gdk_monitor_get_scale_factor(monitor));
+
+    if (image == NULL) {
+        GtkStyleContext *style_context =
+            gtk_widget_get_style_context(GTK_WIDGET(background_window));
+        gtk_style_context_add_class(style_context, "with-image");
+        return;
     }
+    // The window owns its reference, so it is released with the window
+    g_object_set_data_full(G_OBJECT(background_window), "background-image",
+                           image, (GDestroyNotify) cairo_surface_destroy);
+    g_signal_connect_after(background_window, "draw",
+                           G_CALLBACK(draw_background_image), image);
+    gtk_widget_queue_draw(GTK_WIDGET(background_window));
 }
 
 
-/* Create & Configure a Background Window for a Monitor */
+/* Remove a background window's image, so one for a new size can be attached */
+static void detach_background_image(GtkWindow *background_window)
+{
+    cairo_surface_t *image =
+        g_object_get_data(G_OBJECT(background_window), "background-image");
+    if (image != NULL) {
+        g_signal_handlers_disconnect_matched(
+            background_window, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, image);
+        // Releases the window's reference to the image
+        g_object_set_data(G_OBJECT(background_window), "background-image", NULL);
+    }
+    gtk_style_context_remove_class(
+        gtk_widget_get_style_context(GTK_WIDGET(background_window)), "with-image");
+}
+
+
+/* Paint the pre-scaled background image over the window's CSS background */
+static gboolean draw_background_image(GtkWidget *background_window, cairo_t *cr,
+                                      cairo_surface_t *image)
+{
+    // Leave the window blank in idle mode
+    if (gtk_style_context_has_class(
+            gtk_widget_get_style_context(background_window), "idle")) {
+        return FALSE;
+    }
+    cairo_set_source_surface(cr, image, 0, 0);
+    cairo_paint(cr);
+
+    return FALSE;
+}
+
+
+/* Create & Configure a Background Window for a Monitor.
+ *
+ * A NULL monitor makes the spanning window, which is sized by
+ * `update_spanning_background_window`.
+ */
 static GtkWindow *new_background_window(GdkMonitor *monitor)
 {
     GtkWindow *background_window = GTK_WINDOW(gtk_window_new(
         GTK_WINDOW_TOPLEVEL));
-    gtk_window_set_type_hint(background_window, GDK_WINDOW_TYPE_HINT_DESKTOP);
-    gtk_window_set_keep_below(background_window, TRUE);
     gtk_widget_set_name(GTK_WIDGET(background_window), "background");
+    g_object_set_data(G_OBJECT(background_window), "monitor", monitor);
 
-    // Set Window Size to Monitor Size
-    set_window_to_monitor_size(monitor, background_window);
+    if (layer_shell_is_active()) {
+        layer_shell_setup_background_window(background_window, monitor);
+    } else {
+        gtk_window_set_type_hint(background_window, GDK_WINDOW_TYPE_HINT_DESKTOP);
+        gtk_window_set_keep_below(background_window, TRUE);
+        // Set Window Size to Monitor Size
+        if (monitor != NULL) {
+            set_window_to_monitor_size(monitor, background_window);
+        }
+    }
 
+    // Background windows are destroyed when their monitor is disconnected, so
+    // unlike the main window, they don't quit the greeter
     g_signal_connect(background_window, "realize", G_CALLBACK(hide_mouse_cursor),
                      NULL);
-    // TODO: is this needed?
-    g_signal_connect(background_window, "destroy", G_CALLBACK(gtk_main_quit),
-                     NULL);
 
     return background_window;
 }
 
 
-/* Set the Window's Minimum Size to the Default Screen's Size */
+/* Fix the Window's Size & Position to a Monitor */
 static void set_window_to_monitor_size(GdkMonitor *monitor, GtkWindow *window)
 {
     GdkRectangle geometry;
     gdk_monitor_get_geometry(monitor, &geometry);
+    set_window_to_area(&geometry, window);
+}
+
+
+/* Fix the Window's Size & Position to an Area of the Screen */
+static void set_window_to_area(const GdkRectangle *area, GtkWindow *window)
+{
     gtk_widget_set_size_request(
         GTK_WIDGET(window),
-        geometry.width,
-        geometry.height
+        area->width,
+        area->height
     );
-    gtk_window_move(window, geometry.x, geometry.y);
+    gtk_window_move(window, area->x, area->y);
     gtk_window_set_resizable(window, FALSE);
 }
 
@@ -154,6 +624,10 @@ static void hide_mouse_cursor(GtkWidget *widget, gpointer user_data)
  */
 static void move_mouse_to_background_window(void)
 {
+    // Wayland clients can't move the pointer
+    if (layer_shell_is_active()) {
+        return;
+    }
     GdkDisplay *display = gdk_display_get_default();
     GdkDevice *mouse = gdk_seat_get_pointer(gdk_display_get_default_seat(display));
     GdkScreen *screen = gdk_display_get_default_screen(display);
@@ -169,8 +643,16 @@ static void setup_main_window(Config *config, UI *ui)
 
     gtk_container_set_border_width(GTK_CONTAINER(main_window), config->layout_spacing);
     gtk_widget_set_name(GTK_WIDGET(main_window), "main");
+    if (layer_shell_is_active()) {
+        layer_shell_setup_main_window(main_window);
+    }
 
     g_signal_connect(main_window, "show", G_CALLBACK(place_main_window), NULL);
+    if (config->staged_startup) {
+        // The window grows when the deferred system info is added
+        g_signal_connect(main_window, "size-allocate",
+                         G_CALLBACK(recenter_main_window), NULL);
+    }
     g_signal_connect(main_window, "realize", G_CALLBACK(hide_mouse_cursor), NULL);
     g_signal_connect(main_window, "destroy", G_CALLBACK(gtk_main_quit), NULL);
 
@@ -186,20 +668,59 @@ static void setup_main_window(Config *config, UI *ui)
  */
 static void place_main_window(GtkWidget *main_window, gpointer user_data)
 {
-    // Get the Geometry of the Primary Monitor
+    // Get the Geometry of the Window
+    gint window_width, window_height;
+    gtk_window_get_size(GTK_WINDOW(main_window), &window_width, &window_height);
+
+    center_window_on_primary_monitor(GTK_WINDOW(main_window),
+                                     window_width, window_height);
+}
+
+
+/* Center the Main Window on the Primary Monitor, e.g. after monitors change */
+void center_main_window(UI *ui)
+{
+    gint window_width, window_height;
+    gtk_window_get_size(ui->main_window, &window_width, &window_height);
+
+    center_window_on_primary_monitor(ui->main_window, window_width, window_height);
+}
+
+
+/* Keep the Main Window Centered when its Size Changes */
+static void recenter_main_window(GtkWidget *main_window, GdkRectangle *allocation,
+                                 gpointer user_data)
+{
+    center_window_on_primary_monitor(GTK_WINDOW(main_window),
+                                     allocation->width, allocation->height);
+}
+
+
+/* Move a Window of the Given Size to the Center of the Primary Monitor */
+static void center_window_on_primary_monitor(GtkWindow *window, gint width,
+                                             gint height)
+{
     GdkDisplay *display = gdk_display_get_default();
     GdkMonitor *primary_monitor = gdk_display_get_primary_monitor(display);
+    if (primary_monitor == NULL) {
+        // No primary monitor is set, e.g. right after it was disconnected
+        primary_monitor = gdk_display_get_monitor(display, 0);
+        if (primary_monitor == NULL) {
+            return;
+        }
+    }
+    // Unanchored layer surfaces are centered by the compositor
+    if (layer_shell_is_active()) {
+        layer_shell_set_monitor(window, primary_monitor);
+        return;
+    }
     GdkRectangle primary_monitor_geometry;
     gdk_monitor_get_geometry(primary_monitor, &primary_monitor_geometry);
 
-    // Get the Geometry of the Window
-    gint window_width, window_height;
-    gtk_window_get_size(GTK_WINDOW(main_window), &window_width, &window_height);
-
     gtk_window_move(
-        GTK_WINDOW(main_window),
-        primary_monitor_geometry.x + primary_monitor_geometry.width / 2 - window_width / 2,
-        primary_monitor_geometry.y + primary_monitor_geometry.height / 2 - window_height / 2);
+        window,
+        primary_monitor_geometry.x + primary_monitor_geometry.width / 2 - width / 2,
+        primary_monitor_geometry.y + primary_monitor_geometry.height / 2 - height / 2);
 }
 
 
@@ -233,8 +754,10 @@ static void create_and_attach_sys_info_label(Config *config, UI *ui)
     // system info: <user>@<hostname>
     const gchar *hostname = lightdm_get_hostname();
     gchar *output_string;
+    const gchar *user_name =
+        ui->user_name != NULL ? ui->user_name : config->login_user;
     int output_string_length = asprintf(&output_string, "%s@%s",
-                                        config->login_user, hostname);
+                                        user_name, hostname);
     if (output_string_length >= 0) {
         ui->sys_info_label = gtk_label_new(output_string);
     } else {
@@ -260,6 +783,36 @@ static void create_and_attach_sys_info_label(Config *config, UI *ui)
 }
 
 
+/* Add a row showing the selected user's avatar & name.
+ *
+ * Only built when the user list is enabled. The avatar stays hidden until
+ * `show_selected_user` is given one, so nothing here touches the disk.
+ */
+static void create_and_attach_user_label(Config *config, UI *ui)
+{
+    if (!config->show_user_list) {
+        return;
+    }
+    ui->user_container = GTK_GRID(gtk_grid_new());
+    gtk_grid_set_column_spacing(ui->user_container, 5);
+    gtk_widget_set_halign(GTK_WIDGET(ui->user_container), GTK_ALIGN_CENTER);
+    gtk_widget_set_name(GTK_WIDGET(ui->user_container), "user");
+
+    ui->user_avatar = gtk_image_new();
+    gtk_widget_set_no_show_all(ui->user_avatar, TRUE);
+    gtk_widget_set_name(GTK_WIDGET(ui->user_avatar), "user-avatar");
+
+    ui->user_label = gtk_label_new(config->login_user);
+    gtk_widget_set_name(GTK_WIDGET(ui->user_label), "user-name");
+
+    gtk_grid_attach(ui->user_container, ui->user_avatar, 0, 0, 1, 1);
+    gtk_grid_attach(ui->user_container, ui->user_label, 1, 0, 1, 1);
+    const gint top = config->show_sys_info ? 1 : 0;
+    gtk_grid_attach(
+        ui->layout_container, GTK_WIDGET(ui->user_container), 0, top, 2, 1);
+}
+
+
 /* Add a label & entry field for the user's password.
  *
  * If the `show_password_label` member of `config` is FALSE,
@@ -267,7 +820,10 @@ static void create_and_attach_sys_info_label(Config *config, UI *ui)
  */
 static void create_and_attach_password_field(Config *config, UI *ui)
 {
-    ui->password_input = gtk_entry_new();
+    // The entry keeps its own reference to the buffer
+    GtkEntryBuffer *password_buffer = secure_entry_buffer_new();
+    ui->password_input = gtk_entry_new_with_buffer(password_buffer);
+    g_object_unref(password_buffer);
     gtk_entry_set_visibility(GTK_ENTRY(ui->password_input), FALSE);
     if (config->password_char != NULL) {
         gtk_entry_set_invisible_char(GTK_ENTRY(ui->password_input), *config->password_char);
@@ -280,7 +836,8 @@ static void create_and_attach_password_field(Config *config, UI *ui)
     gtk_entry_set_width_chars(GTK_ENTRY(ui->password_input),
                               config->password_input_width);
     gtk_widget_set_name(GTK_WIDGET(ui->password_input), "password");
-    const gint top = config->show_sys_info ? 1 : 0;
+    const gint top = (config->show_sys_info ? 1 : 0) +
+                     (config->show_user_list ? 1 : 0);
     gtk_grid_attach(ui->layout_container, ui->password_input, 1, top, 1, 1);
 
     if (config->show_password_label) {
@@ -314,113 +871,194 @@ static void create_and_attach_feedback_label(UI *ui)
                             attachment_point, GTK_POS_BOTTOM, width, 1);
 }
 
-/* Attach a style provider to the screen, using color options from config */
-static void attach_config_colors_to_screen(Config *config)
+/* Attach the theme components from `first` up to, but not including, `last` */
+static void attach_theme_components(Config *config, UI *ui,
+                                    ThemeComponent first, ThemeComponent last)
 {
-    GtkCssProvider* provider = gtk_css_provider_new();
+    for (ThemeComponent c = first; c < last; c++) {
+        attach_theme_component(config, ui, c);
+    }
+}
 
-    GdkRGBA *caret_color;
-    if (config->show_input_cursor) {
-        caret_color = config->password_color;
-    } else {
-        caret_color = config->password_background_color;
-    }
-
-    char *css;
-    int css_string_length = asprintf(&css,
-        "* {\n"
-            "font-family: %s;\n"
-            "font-size: %s;\n"
-            "font-weight: %s;\n"
-            "font-style: %s;\n"
-        "}\n"
-        "label {\n"
-            "color: %s;\n"
-        "}\n"
-        "label#error {\n"
-            "color: %s;\n"
-        "}\n"
-        "#background {\n"
-            "background-color: %s;\n"
-        "}\n"
-        "#background.with-image {\n"
-            "background-image: image(url(%s), %s);\n"
-            "background-repeat: no-repeat;\n"
-            "background-size: %s;\n"
-            "background-position: center;\n"
-        "}\n"
-        "#main, #password {\n"
-            "border-width: %s;\n"
-            "border-color: %s;\n"
-            "border-style: solid;\n"
-        "}\n"
-        "#main {\n"
-            "background-color: %s;\n"
-        "}\n"
-        "#password {\n"
-            "color: %s;\n"
-            "caret-color: %s;\n"
-            "background-color: %s;\n"
-            "border-width: %s;\n"
-            "border-color: %s;\n"
-            "border-radius: %s;\n"
-            "background-image: none;\n"
-            "box-shadow: none;\n"
-            "border-image-width: 0;\n"
-        "}\n"
-        "#info {\n"
-            "margin: %s;\n"
-        "}\n"
-        "#info label {\n"
-            "font-family: %s;\n"
-            "font-size: %s;\n"
-            "color: %s;\n"
-        "}\n"
-
-        // *
-        , config->font
-        , config->font_size
-        , config->font_weight
-        , config->font_style
-        // label
-        , gdk_rgba_to_string(config->text_color)
-        // label#error
-        , gdk_rgba_to_string(config->error_color)
-        // #background
-        , gdk_rgba_to_string(config->background_color)
-        // #background.image-background
-        , config->background_image
-        , gdk_rgba_to_string(config->background_color)
-        , config->background_image_size
-        // #main, #password
-        , config->border_width
-        , gdk_rgba_to_string(config->border_color)
-        // #main
-        , gdk_rgba_to_string(config->window_color)
-        // #password
-        , gdk_rgba_to_string(config->password_color)
-        , gdk_rgba_to_string(caret_color)
-        , gdk_rgba_to_string(config->password_background_color)
-        , config->password_border_width
-        , gdk_rgba_to_string(config->password_border_color)
-        , config->password_border_radius
-        // #info
-        , config->sys_info_margin
-        // #info label
-        , config->sys_info_font
-        , config->sys_info_font_size
-        , gdk_rgba_to_string(config->sys_info_color)
-    );
 
-    if (css_string_length >= 0) {
-        gtk_css_provider_load_from_data(provider, css, -1, NULL);
+/* Load a theme component's CSS into its style provider, adding the provider
+ * to the screen the first time, at the component's fixed priority.
+ *
+ * The provider is only reloaded if the CSS changed. Returns TRUE if it was.
+ */
+static gboolean attach_theme_component(Config *config, UI *ui,
+                                       ThemeComponent component)
+{
+    char *css = build_theme_css(config, component);
+    if (css == NULL) {
+        g_warning("Could not allocate memory for the theme's CSS");
+        return FALSE;
+    }
+    if (ui->theme_css[component] != NULL &&
+            strcmp(ui->theme_css[component], css) == 0) {
+        free(css);
+        return FALSE;
+    }
 
-        GdkScreen *screen = gdk_screen_get_default();
+    if (ui->theme_providers[component] == NULL) {
+        ui->theme_providers[component] = gtk_css_provider_new();
         gtk_style_context_add_provider_for_screen(
-            screen, GTK_STYLE_PROVIDER(provider),
-            GTK_STYLE_PROVIDER_PRIORITY_USER + 1);
+            gdk_screen_get_default(),
+            GTK_STYLE_PROVIDER(ui->theme_providers[component]),
+            GTK_STYLE_PROVIDER_PRIORITY_USER + 1 + (guint) component);
+    }
+    gtk_css_provider_load_from_data(ui->theme_providers[component], css, -1, NULL);
+
+    free(ui->theme_css[component]);
+    ui->theme_css[component] = css;
+    return TRUE;
+}
+
+
+/* Reload the theme components whose CSS changed with the config.
+ *
+ * Components that `staged_startup` hasn't attached yet are left for it.
+ */
+void update_ui_theme(Config *config, UI *ui)
+{
+    guint reloaded_count = 0;
+    for (int c = 0; c < THEME_COMPONENT_COUNT; c++) {
+        if (ui->theme_providers[c] != NULL &&
+                attach_theme_component(config, ui, (ThemeComponent) c)) {
+            reloaded_count++;
+        }
+    }
+    if (reloaded_count > 0) {
+        g_message("Reloaded %u of %d theme components", reloaded_count,
+                  THEME_COMPONENT_COUNT);
     }
+}
 
 
-    g_object_unref(provider);
+/* Apply the config changes that affect existing widgets */
+void update_ui_widgets(const Config *old_config, Config *config, UI *ui)
+{
+    GtkEntry *password_input = GTK_ENTRY(ui->password_input);
+    if (config->password_char == NULL) {
+        if (old_config->password_char != NULL) {
+            gtk_entry_unset_invisible_char(password_input);
+        }
+    } else if (old_config->password_char == NULL ||
+               *old_config->password_char != *config->password_char) {
+        gtk_entry_set_invisible_char(password_input, *config->password_char);
+    }
+    if (old_config->password_alignment < config->password_alignment ||
+            old_config->password_alignment > config->password_alignment) {
+        gtk_entry_set_alignment(password_input, config->password_alignment);
+    }
+    if (old_config->password_input_width != config->password_input_width) {
+        gtk_entry_set_width_chars(password_input, config->password_input_width);
+    }
+    if (ui->password_label != NULL &&
+            strcmp(old_config->password_label_text, config->password_label_text) != 0) {
+        gtk_label_set_text(GTK_LABEL(ui->password_label), config->password_label_text);
+    }
+    if (old_config->layout_spacing != config->layout_spacing) {
+        gtk_container_set_border_width(GTK_CONTAINER(ui->main_window),
+                                       config->layout_spacing);
+    }
+}
+
+
+/* Replace the background images after the image or its options changed.
+ *
+ * Does nothing if `staged_startup` hasn't loaded the images yet.
+ */
+void reload_background_images(Config *config, UI *ui)
+{
+    if (ui->background_cache == NULL) {
+        return;
+    }
+    for (int m = 0; m < ui->monitor_count; m++) {
+        detach_background_image(ui->background_windows[m]);
+        gtk_widget_queue_draw(GTK_WIDGET(ui->background_windows[m]));
+    }
+    destroy_background_cache(ui->background_cache);
+    ui->background_cache = NULL;
+    attach_background_images(config, ui);
+}
+
+
+/* Move the background image to the new primary monitor.
+ *
+ * Unlike `reload_background_images`, the background cache is kept, so only
+ * images for sizes that weren't shown before are scaled.
+ */
+void update_background_images(Config *config, UI *ui)
+{
+    if (ui->background_cache == NULL) {
+        return;
+    }
+    if (ui->spans_monitors) {
+        update_spanning_background_window(config, ui, NULL);
+        return;
+    }
+    for (int m = 0; m < ui->monitor_count; m++) {
+        GtkWindow *background_window = ui->background_windows[m];
+        GdkMonitor *monitor =
+            g_object_get_data(G_OBJECT(background_window), "monitor");
+        detach_background_image(background_window);
+        attach_background_image_if_shown(config, ui, monitor, background_window);
+        gtk_widget_queue_draw(GTK_WIDGET(background_window));
+    }
+    background_cache_release_source(ui->background_cache);
+}
+
+
+/* Label the password input with LightDM's prompt, e.g. for a one-time code.
+ *
+ * The prompt replaces the password label's text, or is shown as a
+ * placeholder when the label is hidden. Answers to questions are shown as
+ * they're typed. A NULL prompt restores the password prompt.
+ */
+void set_ui_prompt(Config *config, UI *ui, const gchar *prompt_text,
+                   gboolean is_secret)
+{
+    GtkEntry *password_input = GTK_ENTRY(ui->password_input);
+    gtk_entry_set_visibility(password_input, !is_secret);
+    if (ui->password_label != NULL) {
+        gtk_label_set_text(GTK_LABEL(ui->password_label),
+                           prompt_text != NULL
+                           ? prompt_text : config->password_label_text);
+    } else {
+        gtk_entry_set_placeholder_text(password_input, prompt_text);
+    }
+}
+
+
+/* Show a user in the user row & the system information.
+ *
+ * The avatar may be NULL, hiding it until the user's avatar has loaded.
+ */
+void show_selected_user(UI *ui, const gchar *user_name, const gchar *display_name,
+                        GdkPixbuf *avatar)
+{
+    if (g_strcmp0(ui->user_name, user_name) != 0) {
+        g_free(ui->user_name);
+        ui->user_name = g_strdup(user_name);
+        if (ui->sys_info_label != NULL) {
+            gchar *sys_info_text =
+                g_strdup_printf("%s@%s", user_name, lightdm_get_hostname());
+            gtk_label_set_text(GTK_LABEL(ui->sys_info_label), sys_info_text);
+            g_free(sys_info_text);
+        }
+    }
+    if (ui->user_container == NULL) {
+        return;
+    }
+    gtk_label_set_text(GTK_LABEL(ui->user_label),
+                       display_name != NULL && display_name[0] != '\0'
+                       ? display_name : user_name);
+    if (avatar == NULL) {
+        gtk_widget_hide(ui->user_avatar);
+        gtk_image_clear(GTK_IMAGE(ui->user_avatar));
+    } else {
+        gtk_image_set_from_pixbuf(GTK_IMAGE(ui->user_avatar), avatar);
+        gtk_widget_show(ui->user_avatar);
+    }
 }
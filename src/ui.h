@@ -2,23 +2,63 @@
 #define UI_H
 
 #include <gtk/gtk.h>
+#include "background.h"
 #include "config.h"
+#include "theme.h"
+
+
+// The parts of the UI that `staged_startup` loads after the first frame
+typedef enum {
+    DEFERRED_UI_THEME,
+    DEFERRED_UI_BACKGROUND_IMAGE,
+    DEFERRED_UI_SYS_INFO,
+    DEFERRED_UI_DONE
+} DeferredUIStage;
 
 
 typedef struct UI_ {
+    /* One window per monitor, or a single one when `spans_monitors` */
     GtkWindow   **background_windows;
     int         monitor_count;
+    gboolean    spans_monitors;
+    /* The monitors' images on the spanning window, NULL without it */
+    GArray      *background_regions;
     GtkWindow   *main_window;
     GtkGrid     *layout_container;
     GtkGrid     *info_container;
     GtkWidget   *sys_info_label;
     GtkWidget   *time_label;
+    GtkGrid     *user_container;
+    GtkWidget   *user_avatar;
+    GtkWidget   *user_label;
+    /* The selected user's name, NULL until one is shown */
+    gchar       *user_name;
     GtkWidget   *password_label;
     GtkWidget   *password_input;
     GtkWidget   *feedback_label;
+    BackgroundCache *background_cache;
+    DeferredUIStage deferred_stage;
+    /* A style provider for each theme component, NULL until it's attached */
+    GtkCssProvider *theme_providers[THEME_COMPONENT_COUNT];
+    /* The CSS each provider was last loaded with */
+    char        *theme_css[THEME_COMPONENT_COUNT];
 } UI;
 
 
 UI *initialize_ui(Config *config);
+void destroy_ui(UI *ui);
+gboolean load_next_deferred_ui_stage(Config *config, UI *ui);
+GtkWindow *add_background_window(Config *config, UI *ui, GdkMonitor *monitor);
+void remove_background_window(Config *config, UI *ui, GdkMonitor *monitor);
+void update_background_window(Config *config, UI *ui, GdkMonitor *monitor);
+void center_main_window(UI *ui);
+void update_ui_theme(Config *config, UI *ui);
+void update_ui_widgets(const Config *old_config, Config *config, UI *ui);
+void reload_background_images(Config *config, UI *ui);
+void update_background_images(Config *config, UI *ui);
+void set_ui_prompt(Config *config, UI *ui, const gchar *prompt_text,
+                   gboolean is_secret);
+void show_selected_user(UI *ui, const gchar *user_name, const gchar *display_name,
+                        GdkPixbuf *avatar);
 
 #endif
@@ -0,0 +1,199 @@
+/* Functions related to the User List
+ *
+ * Avatars can live in home directories on slow storage, so each one is
+ * decoded & scaled on a worker thread. The main thread is only handed the
+ * finished pixbuf, & nothing waits on an avatar before showing a user.
+ */
+#include <stdlib.h>
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <lightdm.h>
+
+#include "users.h"
+
+
+// What a worker thread needs to load an avatar, & who to hand it to
+typedef struct AvatarLoad_ {
+    gchar            *image_path;
+    gint              size;
+    User             *user;
+    AvatarLoadedFunc  loaded_func;
+    gpointer          user_data;
+} AvatarLoad;
+
+static void load_avatar_in_thread(GTask *task, gpointer source_object,
+                                  gpointer task_data, GCancellable *cancellable);
+static void handle_avatar_loaded(GObject *source_object, GAsyncResult *result,
+                                 gpointer user_data);
+static void destroy_avatar_load(gpointer data);
+static User *new_user(const gchar *name, const gchar *display_name,
+                      const gchar *session, const gchar *image_path);
+static const gchar *get_user_name(gconstpointer data);
+static void destroy_user(gpointer data);
+
+
+/* Build a ring of the local users LightDM knows about, with the default
+ * user selected.
+ *
+ * The default user is added even if LightDM hides them, so the ring always
+ * starts on the user being authenticated. Avatars aren't loaded, see
+ * `load_user_avatars`.
+ *
+ * Without AccountsService, liblightdm reads each user's ~/.dmrc & looks for
+ * their ~/.face, so this shouldn't run before the first prompt is shown.
+ */
+FocusRing *initialize_user_ring(const gchar *default_user)
+{
+    FocusRing *ring = initialize_focus_ring(&get_user_name, destroy_user, "users");
+    LightDMUserList *user_list = lightdm_user_list_get_instance();
+    for (GList *item = lightdm_user_list_get_users(user_list); item != NULL;
+            item = item->next) {
+        LightDMUser *lightdm_user = item->data;
+        focus_ring_append(ring, new_user(
+            lightdm_user_get_name(lightdm_user),
+            lightdm_user_get_display_name(lightdm_user),
+            lightdm_user_get_session(lightdm_user),
+            lightdm_user_get_image(lightdm_user)));
+    }
+    if (default_user != NULL &&
+            g_strcmp0(focus_ring_scroll_to_value(ring, default_user), default_user) != 0) {
+        focus_ring_append(ring, new_user(default_user, NULL, NULL, NULL));
+        focus_ring_scroll_to_value(ring, default_user);
+    }
+    return ring;
+}
+
+
+/* Start loading the avatar of every user that has one, scaled to fit a
+ * square of the given size.
+ *
+ * The loaded function is called as each avatar is ready. Cancelling stops
+ * any that haven't been handed over yet, & must be done before the ring is
+ * destroyed.
+ */
+void load_user_avatars(FocusRing *ring, gint size, GCancellable *cancellable,
+                       AvatarLoadedFunc loaded_func, gpointer user_data)
+{
+    if (size <= 0) {
+        return;
+    }
+    for (guint i = 0; i < focus_ring_get_length(ring); i++) {
+        User *user = focus_ring_get_item(ring, i);
+        if (user->image_path == NULL || user->image_path[0] == '\0') {
+            continue;
+        }
+        AvatarLoad *load = malloc(sizeof(AvatarLoad));
+        if (load == NULL) {
+            g_error("Could not allocate memory for AvatarLoad");
+        }
+        // The thread gets its own copy of everything it reads
+        load->image_path = g_strdup(user->image_path);
+        load->size = size;
+        load->user = user;
+        load->loaded_func = loaded_func;
+        load->user_data = user_data;
+
+        GTask *task = g_task_new(NULL, cancellable, handle_avatar_loaded, NULL);
+        g_task_set_task_data(task, load, destroy_avatar_load);
+        g_task_run_in_thread(task, load_avatar_in_thread);
+        g_object_unref(task);
+    }
+}
+
+
+/* Decode & scale an avatar. Runs on a worker thread. */
+static void load_avatar_in_thread(GTask *task, gpointer source_object,
+                                  gpointer task_data, GCancellable *cancellable)
+{
+    const AvatarLoad *load = task_data;
+    if (g_task_return_error_if_cancelled(task)) {
+        return;
+    }
+    GError *load_error = NULL;
+    GdkPixbuf *avatar = gdk_pixbuf_new_from_file_at_scale(
+        load->image_path, load->size, load->size, TRUE, &load_error);
+    if (avatar == NULL) {
+        g_task_return_error(task, load_error);
+    } else {
+        g_task_return_pointer(task, avatar, g_object_unref);
+    }
+}
+
+
+/* Hand a loaded avatar to its user, unless loading was cancelled, in which
+ * case the user may no longer exist.
+ */
+static void handle_avatar_loaded(GObject *source_object, GAsyncResult *result,
+                                 gpointer user_data)
+{
+    GTask *task = G_TASK(result);
+    GCancellable *cancellable = g_task_get_cancellable(task);
+    if (cancellable != NULL && g_cancellable_is_cancelled(cancellable)) {
+        return;
+    }
+
+    AvatarLoad *load = g_task_get_task_data(task);
+    GError *load_error = NULL;
+    GdkPixbuf *avatar = g_task_propagate_pointer(task, &load_error);
+    if (avatar == NULL) {
+        g_message("Could not load the avatar for %s: %s", load->user->name,
+                  load_error->message);
+        g_error_free(load_error);
+        return;
+    }
+    load->user->avatar = avatar;
+    load->loaded_func(load->user, load->user_data);
+}
+
+
+/* Free an AvatarLoad */
+static void destroy_avatar_load(gpointer data)
+{
+    AvatarLoad *load = data;
+    g_free(load->image_path);
+    free(load);
+}
+
+
+/* Create a User without an avatar, copying every string */
+static User *new_user(const gchar *name, const gchar *display_name,
+                      const gchar *session, const gchar *image_path)
+{
+    User *user = malloc(sizeof(User));
+    if (user == NULL) {
+        g_error("Could not allocate memory for User");
+    }
+    user->name = g_strdup(name);
+    user->display_name = g_strdup(display_name);
+    user->session = g_strdup(session);
+    user->image_path = g_strdup(image_path);
+    user->avatar = NULL;
+    return user;
+}
+
+
+/* Retrieves the `name` field of a user, used to pull the current user out of
+ * a FocusRing.
+ */
+static const gchar *get_user_name(gconstpointer data)
+{
+    const User *user = data;
+    return user->name;
+}
+
+
+/* Free a User & their avatar */
+static void destroy_user(gpointer data)
+{
+    User *user = data;
+    g_free(user->name);
+    g_free(user->display_name);
+    g_free(user->session);
+    g_free(user->image_path);
+    if (user->avatar != NULL) {
+        g_object_unref(user->avatar);
+    }
+    free(user);
+}
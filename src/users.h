@@ -0,0 +1,31 @@
+#ifndef USERS_H
+#define USERS_H
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gio/gio.h>
+#include <glib.h>
+
+#include "focus_ring.h"
+
+
+// A local user that can be selected for logging in
+typedef struct User_ {
+    gchar     *name;
+    gchar     *display_name;
+    /* The user's default session, may be NULL */
+    gchar     *session;
+    /* Path to the user's avatar image, may be NULL */
+    gchar     *image_path;
+    /* NULL until the avatar has been loaded, or if it can't be */
+    GdkPixbuf *avatar;
+} User;
+
+// Called in the main thread once a user's avatar has been loaded
+typedef void (*AvatarLoadedFunc)(User *user, gpointer user_data);
+
+
+FocusRing *initialize_user_ring(const gchar *default_user);
+void load_user_avatars(FocusRing *ring, gint size, GCancellable *cancellable,
+                       AvatarLoadedFunc loaded_func, gpointer user_data);
+
+#endif
@@ -2,33 +2,58 @@
 #include <lightdm.h>
 
 #include "app.h"
+#include "auth_metrics.h"
+#include "callbacks.h"
 #include "compat.h"
-#include "lightdm/session.h"
 #include "utils.h"
 #include "focus_ring.h"
+#include "sessions.h"
+#include "timing.h"
+#include "users.h"
 
-static gchar *get_session_key(gconstpointer data);
+
+/* Start connecting to the LightDM daemon without blocking.
+ *
+ * `daemon_connected_cb` finishes the connection & begins authentication, or
+ * exits with an error.
+ */
+void connect_to_lightdm_daemon(App *app)
+{
+    timing_phase_begin(TIMING_CONNECT_TO_DAEMON);
+    compat_greeter_connect_to_daemon(app->greeter, NULL, daemon_connected_cb, app);
+}
 
 
-/* Connect to the LightDM daemon or exit with an error */
-void connect_to_lightdm_daemon(LightDMGreeter *greeter)
+/* Get the name of the user to log in as.
+ *
+ * This is the user picked from the user list, or the default user if the
+ * list isn't shown or hasn't been built yet.
+ */
+const gchar *get_selected_user(App *app)
 {
-    if (!lightdm_greeter_connect_sync(greeter, NULL)) {
-        g_critical("Could not connect to the LightDM daemon");
+    if (app->user_ring != NULL && focus_ring_get_length(app->user_ring) > 0) {
+        return focus_ring_get_value(app->user_ring);
     }
+    return APP_LOGIN_USER(app);
 }
 
 
-/* Begin authentication as the default user, or exit with an error */
-void begin_authentication_as_default_user(App *app)
+/* Begin authentication as the selected user, or exit with an error */
+void begin_authentication_as_selected_user(App *app)
 {
-    const gchar *default_user = APP_LOGIN_USER(app);
-    if (g_strcmp0(default_user, NULL) == 0) {
+    const gchar *selected_user = get_selected_user(app);
+    if (g_strcmp0(selected_user, NULL) == 0) {
         g_critical("A default user has not been not set");
     } else {
-        g_message("Beginning authentication as the default user: %s",
-                  default_user);
-        compat_greeter_authenticate(app->greeter, default_user, NULL);
+        g_message("Beginning authentication as the selected user: %s",
+                  selected_user);
+        app->prompt_pending = FALSE;
+        app->prompts_answered = 0;
+        set_ui_prompt(app->config, app->ui, NULL, TRUE);
+        // Restarting abandons any response that's still being checked
+        auth_metric_cancel(AUTH_METRIC_RESPONSE);
+        auth_metric_begin(AUTH_METRIC_PROMPT);
+        compat_greeter_authenticate(app->greeter, selected_user, NULL);
     }
 }
 
@@ -45,26 +70,53 @@ void remove_char(char *str, char garbage) {
 }
 
 
-/* Get Sessions & Build the Focus Ring */
+/* Get Sessions & Build the Focus Ring.
+ *
+ * The ring is kept even if there are no sessions, since sessions installed
+ * while the greeter runs are added to it.
+ */
 void make_session_focus_ring(App *app)
 {
     const gchar *default_session =
             lightdm_greeter_get_default_session_hint(app->greeter);
-    const GList *sessions = lightdm_get_sessions();
-    FocusRing *session_ring = initialize_focus_ring(sessions, &get_session_key, "sessions");
-
-    if (default_session != NULL) {
-        focus_ring_scroll_to_value(session_ring, default_session);
+    FocusRing *session_ring = initialize_session_ring();
+    if (focus_ring_get_length(session_ring) == 0) {
+        g_warning("No sessions found, LightDM will choose the default session");
+    } else {
+        if (default_session != NULL) {
+            focus_ring_scroll_to_value(session_ring, default_session);
+        }
+        g_message("Initial session set to: %s", focus_ring_get_value(session_ring));
     }
-    g_message("Initial session set to: %s", focus_ring_get_value(session_ring));
 
     app->session_ring = session_ring;
+    app->session_watch = initialize_session_watch(session_ring);
 }
-/* Retrieves the `key` field of a session, used to pull current session out of
- * a FocusRing.
+
+
+/* Get Users & Build the User Focus Ring.
+ *
+ * The ring starts on the default user, who is already being authenticated.
+ * Avatars are loaded in the background & shown as they arrive.
  */
-static gchar *get_session_key(gconstpointer data)
+void make_user_focus_ring(App *app)
+{
+    FocusRing *user_ring = initialize_user_ring(APP_LOGIN_USER(app));
+    g_message("Found %u users", focus_ring_get_length(user_ring));
+
+    app->user_ring = user_ring;
+    app->avatar_cancellable = g_cancellable_new();
+    show_selected_user_in_ui(app);
+    load_user_avatars(user_ring, app->config->avatar_size,
+                      app->avatar_cancellable, handle_avatar_loaded, app);
+}
+
+
+/* Show the selected user & their avatar, if it has loaded */
+void show_selected_user_in_ui(App *app)
 {
-    LightDMSession *session = (LightDMSession *) data;
-    return (gchar *) lightdm_session_get_key(session);
+    const User *user = focus_ring_get_selected(app->user_ring);
+    if (user != NULL) {
+        show_selected_user(app->ui, user->name, user->display_name, user->avatar);
+    }
 }
@@ -6,9 +6,12 @@
 #include "app.h"
 
 
-void connect_to_lightdm_daemon(LightDMGreeter *greeter);
+void connect_to_lightdm_daemon(App *app);
 void make_session_focus_ring(App *app);
-void begin_authentication_as_default_user(App *app);
+void make_user_focus_ring(App *app);
+void show_selected_user_in_ui(App *app);
+const gchar *get_selected_user(App *app);
+void begin_authentication_as_selected_user(App *app);
 void remove_char(char *str, char garbage);
 
 #endif
@@ -0,0 +1,68 @@
+/* Authentication Metrics Check
+ *
+ * Times a few login steps & checks the written histograms count them in the
+ * right buckets, that abandoned steps aren't counted, & that a paused step is
+ * counted once without the time it was paused for.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "auth_metrics.h"
+
+#define PROMPT_METRIC "lightdm_mini_greeter_auth_prompt_seconds"
+#define RESPONSE_METRIC "lightdm_mini_greeter_auth_response_seconds"
+
+
+int main(void)
+{
+    gchar *test_dir = g_dir_make_tmp("mini-greeter-metrics-XXXXXX", NULL);
+    g_assert_nonnull(test_dir);
+    gchar *metrics_path = g_build_filename(test_dir, "greeter.prom", NULL);
+    auth_metrics_set_file(metrics_path);
+
+    auth_metric_begin(AUTH_METRIC_RESPONSE);
+    auth_metric_end(AUTH_METRIC_RESPONSE, TRUE);
+    auth_metric_begin(AUTH_METRIC_RESPONSE);
+    auth_metric_end(AUTH_METRIC_RESPONSE, FALSE);
+    // Neither a second end nor a cancelled step is counted
+    auth_metric_end(AUTH_METRIC_RESPONSE, FALSE);
+    auth_metric_begin(AUTH_METRIC_SESSION_START);
+    auth_metric_cancel(AUTH_METRIC_SESSION_START);
+    auth_metric_end(AUTH_METRIC_SESSION_START, TRUE);
+    // Two 6ms parts add up to more than 10ms, the 300ms pause isn't counted
+    auth_metric_begin(AUTH_METRIC_PROMPT);
+    g_usleep(6000);
+    auth_metric_pause(AUTH_METRIC_PROMPT);
+    g_usleep(300000);
+    auth_metric_resume(AUTH_METRIC_PROMPT);
+    g_usleep(6000);
+    auth_metric_end(AUTH_METRIC_PROMPT, TRUE);
+
+    gchar *metrics = NULL;
+    g_assert_true(g_file_get_contents(metrics_path, &metrics, NULL, NULL));
+    g_assert_nonnull(strstr(metrics, "# TYPE " RESPONSE_METRIC " histogram\n"));
+    g_assert_nonnull(strstr(metrics,
+        RESPONSE_METRIC "_bucket{result=\"success\",le=\"+Inf\"} 1\n"));
+    g_assert_nonnull(strstr(metrics,
+        RESPONSE_METRIC "_count{result=\"failure\"} 1\n"));
+    g_assert_nonnull(strstr(metrics,
+        "lightdm_mini_greeter_session_start_seconds_count{result=\"success\"} 0\n"));
+    g_assert_nonnull(strstr(metrics,
+        PROMPT_METRIC "_bucket{result=\"success\",le=\"0.01\"} 0\n"));
+    g_assert_nonnull(strstr(metrics,
+        PROMPT_METRIC "_bucket{result=\"success\",le=\"0.25\"} 1\n"));
+    g_assert_nonnull(strstr(metrics,
+        PROMPT_METRIC "_count{result=\"success\"} 1\n"));
+    g_free(metrics);
+
+    auth_metrics_set_file(NULL);
+    g_unlink(metrics_path);
+    g_free(metrics_path);
+    g_rmdir(test_dir);
+    g_free(test_dir);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""PAM conversation checks for lightdm-mini-greeter.
+
+Runs the greeter under Xvfb against the scripted stand-in daemon from
+`bench/mock_daemon.py` & checks message-only, racing & multi-prompt
+conversations end in a session start with the expected responses. Skipped
+when `Xvfb` or `xdotool` aren't installed.
+"""
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                os.pardir, "bench"))
+from mock_daemon import (PAM_PROMPT_ECHO_OFF, PAM_PROMPT_ECHO_ON, PAM_SUCCESS,
+                         PAM_TEXT_INFO, start_greeter, start_xvfb, stop_greeter,
+                         wait_for)
+
+# The exit code automake treats as a skipped test
+SKIP = 77
+TIMEOUT = 20.0
+PASSWORD = "hunter2"
+CODE = "123456"
+
+FINGER_PROMPT = ("message", PAM_TEXT_INFO, "Place your finger on the reader")
+PASSWORD_PROMPT = ("prompt", PAM_PROMPT_ECHO_OFF, "Password: ")
+
+
+def type_answer(env, text):
+    subprocess.run(["xdotool", "type", "--delay", "0", text], env=env, check=True)
+    subprocess.run(["xdotool", "key", "Return"], env=env, check=True)
+
+
+def fingerprint_only(daemon, env):
+    """A matching finger logs in without anything being typed."""
+    return []
+
+
+def password_during_scan(daemon, env):
+    """A password typed while the reader waits is sent once PAM asks for it."""
+    if not wait_for(lambda: daemon.prompt_batches >= 1, TIMEOUT):
+        raise RuntimeError("the daemon never started the conversation")
+    type_answer(env, PASSWORD)
+    return [PASSWORD]
+
+
+def password_then_code(daemon, env):
+    """A second prompt is answered separately, after the password."""
+    if not wait_for(lambda: daemon.prompt_batches >= 1, TIMEOUT):
+        raise RuntimeError("the greeter was never prompted for a password")
+    type_answer(env, PASSWORD)
+    if not wait_for(lambda: daemon.prompt_batches >= 2, TIMEOUT):
+        raise RuntimeError("the greeter was never prompted for a code")
+    type_answer(env, CODE)
+    return [PASSWORD, CODE]
+
+
+SCENARIOS = [
+    (fingerprint_only,
+     [FINGER_PROMPT, ("wait", 0.5), ("result", PAM_SUCCESS)]),
+    (password_during_scan,
+     [FINGER_PROMPT, ("wait", 1.0), PASSWORD_PROMPT]),
+    (password_then_code,
+     [PASSWORD_PROMPT, ("wait", 0.5), ("prompt", PAM_PROMPT_ECHO_ON, "Code: ")]),
+]
+
+
+def run_scenario(greeter_path, display, workdir, drive, script):
+    config_file = os.path.join(workdir, "lightdm-mini-greeter.conf")
+    with open(config_file, "w") as config:
+        config.write("[greeter]\nuser = %s\n" % os.environ.get("USER", "nobody"))
+
+    greeter, daemon, env = start_greeter(greeter_path, display, workdir,
+                                         config_file, script=script)
+    try:
+        expected_responses = drive(daemon, env)
+        if not daemon.session_started.wait(TIMEOUT):
+            raise RuntimeError("the greeter never requested a session start")
+    finally:
+        stop_greeter(greeter, daemon)
+    if daemon.responses != expected_responses:
+        raise RuntimeError("expected responses %r, got %r"
+                           % (expected_responses, daemon.responses))
+
+
+def main():
+    for tool in ("Xvfb", "xdotool"):
+        if shutil.which(tool) is None:
+            print("%s is required to run the conversation checks" % tool)
+            return SKIP
+    greeter_path = os.environ.get("GREETER", "./lightdm-mini-greeter")
+
+    xvfb, display = start_xvfb("1024x768x24")
+    failures = 0
+    try:
+        with tempfile.TemporaryDirectory(prefix="mini-greeter-conversation-") as workdir:
+            for drive, script in SCENARIOS:
+                try:
+                    run_scenario(greeter_path, display, workdir, drive, script)
+                    print("PASS: %s" % drive.__name__)
+                except RuntimeError as error:
+                    failures += 1
+                    print("FAIL: %s: %s" % (drive.__name__, error))
+                    with open(os.path.join(workdir, "greeter.log"), "rb") as log:
+                        sys.stdout.write(log.read().decode("utf-8", "replace"))
+    finally:
+        xvfb.terminate()
+        xvfb.wait()
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
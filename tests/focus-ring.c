@@ -0,0 +1,57 @@
+/* FocusRing Check
+ *
+ * Cycles & looks up items in a ring that owns them, checking that each item
+ * is freed exactly once when the ring is destroyed.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "focus_ring.h"
+
+
+static const gchar *get_item_value(gconstpointer item);
+
+
+int main(void)
+{
+    const gchar *const values[] = { "i3", "openbox", "xfce", "openbox" };
+    FocusRing *ring = initialize_focus_ring(&get_item_value, g_free, "items");
+    g_assert_null(focus_ring_get_value(ring));
+    g_assert_null(focus_ring_next(ring));
+
+    for (guint i = 0; i < G_N_ELEMENTS(values); i++) {
+        focus_ring_append(ring, g_strdup(values[i]));
+    }
+    g_assert_cmpuint(focus_ring_get_length(ring), ==, G_N_ELEMENTS(values));
+    g_assert_cmpstr(focus_ring_get_value(ring), ==, "i3");
+
+    g_assert_cmpstr(focus_ring_prev(ring), ==, "openbox");
+    g_assert_cmpuint(focus_ring_get_index(ring), ==, 3);
+    g_assert_cmpstr(focus_ring_next(ring), ==, "i3");
+    g_assert_cmpstr(focus_ring_next(ring), ==, "openbox");
+    g_assert_cmpuint(focus_ring_get_index(ring), ==, 1);
+
+    // Duplicate values resolve to the first matching item
+    g_assert_cmpstr(focus_ring_scroll_to_value(ring, "xfce"), ==, "xfce");
+    g_assert_cmpstr(focus_ring_scroll_to_value(ring, "openbox"), ==, "openbox");
+    g_assert_cmpuint(focus_ring_get_index(ring), ==, 1);
+    // Unknown values leave the selection alone
+    g_assert_cmpstr(focus_ring_scroll_to_value(ring, "gnome"), ==, "openbox");
+    g_assert_cmpstr(focus_ring_select_index(ring, 2), ==, "xfce");
+    g_assert_cmpstr(focus_ring_select_index(ring, 10), ==, "xfce");
+    g_assert_cmpstr(focus_ring_get_selected(ring), ==, "xfce");
+    g_assert_cmpstr(focus_ring_get_item(ring, 1), ==, "openbox");
+    g_assert_null(focus_ring_get_item(ring, 10));
+
+    destroy_focus_ring(ring);
+    return EXIT_SUCCESS;
+}
+
+
+/* Items are their own values */
+static const gchar *get_item_value(gconstpointer item)
+{
+    return item;
+}
@@ -0,0 +1,161 @@
+/* Background Image Scaling Check
+ *
+ * Scales & blurs random images with every kernel this CPU supports, on one
+ * & several threads, & checks they all give exactly the scalar kernels'
+ * pixels. Solid colors must keep their exact premultiplied value through
+ * scaling, blurring & dimming, & pixels outside the placed image must stay
+ * untouched.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "image_scale.h"
+
+#define SOURCE_WIDTH  301
+#define SOURCE_HEIGHT 173
+#define TARGET_WIDTH  211
+#define TARGET_HEIGHT 197
+
+
+static guint8 *scale_image(const ImageSource *source, const ImagePlacement *placement,
+                           ImageKernels kernels, guint thread_count);
+static guint8 *blur_image(const guint8 *pixels, gint radius, ImageKernels kernels,
+                          guint thread_count);
+static guint32 get_pixel(const guint8 *pixels, gint x, gint y);
+
+
+int main(void)
+{
+    GRand *random = g_rand_new_with_seed(2024);
+    const gint channel_counts[] = { 3, 4 };
+    const ImagePlacement placements[] = {
+        { 0.37, 12.25, -3.5 },
+        { 1.9, -40.5, 7.75 },
+        { 1.0, 0, 0 },
+    };
+
+    for (gsize c = 0; c < G_N_ELEMENTS(channel_counts); c++) {
+        gint channels = channel_counts[c];
+        gint rowstride = SOURCE_WIDTH * channels + 3;
+        guint8 *pixels = g_malloc((gsize) rowstride * SOURCE_HEIGHT);
+        for (gint i = 0; i < rowstride * SOURCE_HEIGHT; i++) {
+            pixels[i] = (guint8) g_rand_int_range(random, 0, 256);
+        }
+        ImageSource source = {
+            pixels, SOURCE_WIDTH, SOURCE_HEIGHT, rowstride, channels
+        };
+
+        for (gsize p = 0; p < G_N_ELEMENTS(placements); p++) {
+            guint8 *expected =
+                scale_image(&source, &placements[p], IMAGE_KERNELS_SCALAR, 1);
+            for (gint k = 0; k < IMAGE_KERNELS_COUNT; k++) {
+                if (!image_kernels_supported((ImageKernels) k)) {
+                    continue;
+                }
+                for (guint threads = 1; threads <= 3; threads += 2) {
+                    guint8 *scaled = scale_image(&source, &placements[p],
+                                                 (ImageKernels) k, threads);
+                    g_assert_cmpmem(scaled, TARGET_WIDTH * TARGET_HEIGHT * 4,
+                                    expected, TARGET_WIDTH * TARGET_HEIGHT * 4);
+                    g_free(scaled);
+                }
+            }
+            g_free(expected);
+        }
+        g_free(pixels);
+    }
+
+    // Blurs get 4 channels, but don't need to be premultiplied to compare
+    guint8 *noise = g_malloc(TARGET_WIDTH * TARGET_HEIGHT * 4);
+    for (gint i = 0; i < TARGET_WIDTH * TARGET_HEIGHT * 4; i++) {
+        noise[i] = (guint8) g_rand_int_range(random, 0, 256);
+    }
+    const gint radii[] = { 1, 6, IMAGE_BLUR_MAX_RADIUS + 20 };
+    for (gsize r = 0; r < G_N_ELEMENTS(radii); r++) {
+        guint8 *expected = blur_image(noise, radii[r], IMAGE_KERNELS_SCALAR, 1);
+        for (gint k = 0; k < IMAGE_KERNELS_COUNT; k++) {
+            if (!image_kernels_supported((ImageKernels) k)) {
+                continue;
+            }
+            for (guint threads = 1; threads <= 3; threads += 2) {
+                guint8 *blurred = blur_image(noise, radii[r], (ImageKernels) k, threads);
+                g_assert_cmpmem(blurred, TARGET_WIDTH * TARGET_HEIGHT * 4,
+                                expected, TARGET_WIDTH * TARGET_HEIGHT * 4);
+                g_free(blurred);
+            }
+        }
+        g_free(expected);
+    }
+    g_free(noise);
+    g_rand_free(random);
+
+    // A half transparent color is premultiplied & keeps its exact value
+    guint8 *solid = g_malloc(SOURCE_WIDTH * SOURCE_HEIGHT * 4);
+    for (gint i = 0; i < SOURCE_WIDTH * SOURCE_HEIGHT; i++) {
+        memcpy(&solid[i * 4], "\xc8\x64\x32\x80", 4);
+    }
+    ImageSource solid_source = {
+        solid, SOURCE_WIDTH, SOURCE_HEIGHT, SOURCE_WIDTH * 4, 4
+    };
+    // Contained in the target, leaving a transparent border above & below
+    ImagePlacement contain = { 0.7, 0, 38.95 };
+    guint8 *scaled = scale_image(&solid_source, &contain, image_kernels_detect(), 0);
+    g_assert_cmpuint(get_pixel(scaled, 0, 0), ==, 0);
+    g_assert_cmpuint(get_pixel(scaled, 105, 37), ==, 0);
+    g_assert_cmpuint(get_pixel(scaled, 105, 39), ==, 0x80643219);
+    g_assert_cmpuint(get_pixel(scaled, 210, 159), ==, 0x80643219);
+    g_assert_cmpuint(get_pixel(scaled, 105, 160), ==, 0);
+    g_free(scaled);
+
+    // Blurring a solid color keeps it, right up to the edges
+    ImagePlacement cover = { 1.2, -5, -3 };
+    scaled = scale_image(&solid_source, &cover, image_kernels_detect(), 0);
+    guint8 *blurred = blur_image(scaled, 9, image_kernels_detect(), 0);
+    g_assert_cmpmem(blurred, TARGET_WIDTH * TARGET_HEIGHT * 4,
+                    scaled, TARGET_WIDTH * TARGET_HEIGHT * 4);
+    // Dimming darkens the color but keeps its alpha
+    image_dim_argb(blurred, TARGET_WIDTH, TARGET_HEIGHT, TARGET_WIDTH * 4, 128);
+    g_assert_cmpuint(get_pixel(blurred, 0, 0), ==, 0x8032190d);
+    g_assert_cmpuint(get_pixel(blurred, 210, 196), ==, 0x8032190d);
+    image_dim_argb(scaled, TARGET_WIDTH, TARGET_HEIGHT, TARGET_WIDTH * 4, 255);
+    g_assert_cmpuint(get_pixel(scaled, 105, 98), ==, 0x80643219);
+    g_free(blurred);
+    g_free(scaled);
+    g_free(solid);
+
+    return EXIT_SUCCESS;
+}
+
+
+/* Scale an image onto a cleared target of the test's size */
+static guint8 *scale_image(const ImageSource *source, const ImagePlacement *placement,
+                           ImageKernels kernels, guint thread_count)
+{
+    guint8 *target = g_malloc0(TARGET_WIDTH * TARGET_HEIGHT * 4);
+    image_scale_to_argb(source, placement, target, TARGET_WIDTH, TARGET_HEIGHT,
+                        TARGET_WIDTH * 4, kernels, thread_count);
+    return target;
+}
+
+
+/* Blur a copy of a target-sized image */
+static guint8 *blur_image(const guint8 *pixels, gint radius, ImageKernels kernels,
+                          guint thread_count)
+{
+    guint8 *blurred = g_malloc(TARGET_WIDTH * TARGET_HEIGHT * 4);
+    memcpy(blurred, pixels, TARGET_WIDTH * TARGET_HEIGHT * 4);
+    image_blur_argb(blurred, TARGET_WIDTH, TARGET_HEIGHT, TARGET_WIDTH * 4, radius,
+                    kernels, thread_count);
+    return blurred;
+}
+
+
+/* Read a native-endian ARGB32 pixel */
+static guint32 get_pixel(const guint8 *pixels, gint x, gint y)
+{
+    guint32 pixel;
+    memcpy(&pixel, &pixels[(y * TARGET_WIDTH + x) * 4], sizeof(pixel));
+    return pixel;
+}
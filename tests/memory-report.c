@@ -0,0 +1,36 @@
+/* Memory Report Check
+ *
+ * Checks nothing is sampled without a report file in the environment, & that
+ * setting a report file later starts sampling.
+ */
+#include <stdlib.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "memory_report.h"
+
+
+int main(void)
+{
+    g_unsetenv("LIGHTDM_MINI_GREETER_MEMORY_FILE");
+    initialize_memory_report();
+    memory_report_sample("gtk_init");
+    g_assert_cmpuint(memory_report_get_sample_count(), ==, 0);
+
+    // A report file from the configuration samples from then on
+    gchar *test_dir = g_dir_make_tmp("mini-greeter-memory-XXXXXX", NULL);
+    g_assert_nonnull(test_dir);
+    gchar *report_path = g_build_filename(test_dir, "memory.json", NULL);
+    memory_report_set_file(report_path);
+    memory_report_sample("initialize_config");
+    g_assert_cmpuint(memory_report_get_sample_count(), ==, 1);
+
+    memory_report_set_file(NULL);
+    g_assert_cmpuint(memory_report_get_sample_count(), ==, 0);
+    g_rmdir(test_dir);
+
+    g_free(report_path);
+    g_free(test_dir);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,193 @@
+/* Session Discovery Check
+ *
+ * Scans a directory of session files, then loads the same sessions back from
+ * the cache & checks a rescan picks up an added session in place. A session
+ * file edited in place & a `TryExec` program installed later must show up
+ * without a rescan, even though the directory didn't change. LightDM's
+ * `sessions-directory` setting must replace the default directories, with
+ * `lightdm.conf` winning over its drop-in files.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "focus_ring.h"
+#include "sessions.h"
+
+
+static gchar *write_session_file(const gchar *directory, const gchar *key,
+                                 const gchar *contents);
+static void check_sessions(FocusRing *ring);
+
+
+int main(void)
+{
+    gchar *test_dir = g_dir_make_tmp("mini-greeter-sessions-XXXXXX", NULL);
+    g_assert_nonnull(test_dir);
+    gchar *cache_dir = g_build_filename(test_dir, "cache", NULL);
+    gchar *session_dir = g_build_filename(test_dir, "xsessions", NULL);
+    g_assert_true(g_mkdir(session_dir, 0700) == 0);
+    // Must be set before anything asks GLib for the user's cache directory
+    g_setenv("XDG_CACHE_HOME", cache_dir, TRUE);
+    g_setenv("LIGHTDM_MINI_GREETER_SESSION_DIRS", session_dir, TRUE);
+    g_setenv("LANGUAGE", "C", TRUE);
+
+    gchar *session_paths[] = {
+        write_session_file(session_dir, "xfce",
+            "[Desktop Entry]\nName=Xfce Session\nExec=startxfce4\n"),
+        write_session_file(session_dir, "i3",
+            "[Desktop Entry]\nName=i3\nExec=i3\n"),
+        write_session_file(session_dir, "hidden",
+            "[Desktop Entry]\nName=Hidden\nExec=true\nHidden=true\n"),
+        write_session_file(session_dir, "missing",
+            "[Desktop Entry]\nName=Missing\nExec=x\n"
+            "TryExec=mini-greeter-missing-session\n"),
+    };
+
+    // The first ring is scanned, the second is loaded from the cache
+    FocusRing *scanned_ring = initialize_session_ring();
+    check_sessions(scanned_ring);
+    FocusRing *cached_ring = initialize_session_ring();
+    check_sessions(cached_ring);
+    destroy_focus_ring(cached_ring);
+
+    // A new session is added without replacing the ring or its selection
+    SessionWatch *watch = initialize_session_watch(scanned_ring);
+    focus_ring_scroll_to_value(scanned_ring, "i3");
+    gchar *added_path = write_session_file(session_dir, "awesome",
+        "[Desktop Entry]\nName=awesome\nExec=awesome\n");
+    gint64 deadline = g_get_monotonic_time() + 5 * G_USEC_PER_SEC;
+    while (focus_ring_get_length(scanned_ring) != 3 &&
+            g_get_monotonic_time() < deadline) {
+        if (!g_main_context_iteration(NULL, FALSE)) {
+            g_usleep(10000);
+        }
+    }
+    g_assert_cmpuint(focus_ring_get_length(scanned_ring), ==, 3);
+    g_assert_cmpstr(focus_ring_get_value(scanned_ring), ==, "i3");
+    g_assert_cmpuint(focus_ring_get_index(scanned_ring), ==, 2);
+    destroy_session_watch(watch);
+    destroy_focus_ring(scanned_ring);
+
+    // Editing a file in place leaves its directory's mtime alone
+    FILE *edited_file = fopen(session_paths[1], "w");
+    g_assert_nonnull(edited_file);
+    fputs("[Desktop Entry]\nName=i3 Edited\nExec=i3\n", edited_file);
+    fclose(edited_file);
+    FocusRing *edited_ring = initialize_session_ring();
+    g_assert_cmpstr(focus_ring_scroll_to_value(edited_ring, "i3"), ==, "i3");
+    const Session *edited_session = focus_ring_get_selected(edited_ring);
+    g_assert_cmpstr(edited_session->name, ==, "i3 Edited");
+    destroy_focus_ring(edited_ring);
+
+    // The cache keeps the session until its program is installed
+    gchar *program_path = g_build_filename(test_dir, "mini-greeter-later", NULL);
+    gchar *later_contents = g_strdup_printf(
+        "[Desktop Entry]\nName=Later\nExec=later\nTryExec=%s\n", program_path);
+    gchar *later_path = write_session_file(session_dir, "later", later_contents);
+    FocusRing *uninstalled_ring = initialize_session_ring();
+    g_assert_cmpuint(focus_ring_get_length(uninstalled_ring), ==, 3);
+    destroy_focus_ring(uninstalled_ring);
+    g_assert_true(g_file_set_contents(program_path, "#!/bin/sh\n", -1, NULL));
+    g_assert_true(g_chmod(program_path, 0700) == 0);
+    FocusRing *installed_ring = initialize_session_ring();
+    g_assert_cmpuint(focus_ring_get_length(installed_ring), ==, 4);
+    g_assert_cmpstr(focus_ring_scroll_to_value(installed_ring, "later"), ==, "later");
+    destroy_focus_ring(installed_ring);
+    g_unlink(later_path);
+    g_unlink(program_path);
+    g_free(later_path);
+    g_free(later_contents);
+    g_free(program_path);
+
+    // Without the override, LightDM's configuration picks the directories
+    gchar *config_dir = g_build_filename(test_dir, "lightdm", NULL);
+    gchar *drop_in_dir = g_build_filename(config_dir, "lightdm.conf.d", NULL);
+    gchar *configured_dir = g_build_filename(test_dir, "configured-sessions", NULL);
+    g_assert_true(g_mkdir_with_parents(drop_in_dir, 0700) == 0);
+    g_assert_true(g_mkdir(configured_dir, 0700) == 0);
+    gchar *drop_in_path = g_build_filename(drop_in_dir, "50-sessions.conf", NULL);
+    gchar *drop_in_contents =
+        g_strdup_printf("[LightDM]\nsessions-directory=%s\n", session_dir);
+    g_assert_true(g_file_set_contents(drop_in_path, drop_in_contents, -1, NULL));
+    gchar *config_path = g_build_filename(config_dir, "lightdm.conf", NULL);
+    gchar *config_contents =
+        g_strdup_printf("[LightDM]\nsessions-directory=%s\n", configured_dir);
+    g_assert_true(g_file_set_contents(config_path, config_contents, -1, NULL));
+    gchar *configured_path = write_session_file(configured_dir, "sway",
+        "[Desktop Entry]\nName=Sway\nExec=sway\nX-LightDM-Session-Type=wayland\n");
+    g_unsetenv("LIGHTDM_MINI_GREETER_SESSION_DIRS");
+    g_setenv("LIGHTDM_MINI_GREETER_LIGHTDM_CONFIG_DIRS", config_dir, TRUE);
+
+    FocusRing *configured_ring = initialize_session_ring();
+    g_assert_cmpuint(focus_ring_get_length(configured_ring), ==, 1);
+    g_assert_cmpstr(focus_ring_get_value(configured_ring), ==, "sway");
+    const Session *configured_session = focus_ring_get_selected(configured_ring);
+    g_assert_cmpstr(configured_session->type, ==, "wayland");
+    destroy_focus_ring(configured_ring);
+
+    g_unlink(configured_path);
+    g_unlink(config_path);
+    g_unlink(drop_in_path);
+    g_rmdir(configured_dir);
+    g_rmdir(drop_in_dir);
+    g_rmdir(config_dir);
+    g_free(configured_path);
+    g_free(config_contents);
+    g_free(config_path);
+    g_free(drop_in_contents);
+    g_free(drop_in_path);
+    g_free(configured_dir);
+    g_free(drop_in_dir);
+    g_free(config_dir);
+
+    gchar *cache_path = g_build_filename(
+        cache_dir, "lightdm-mini-greeter", "sessions", NULL);
+    gchar *cache_parent = g_path_get_dirname(cache_path);
+    g_unlink(cache_path);
+    g_rmdir(cache_parent);
+    g_rmdir(cache_dir);
+    g_unlink(added_path);
+    for (guint i = 0; i < G_N_ELEMENTS(session_paths); i++) {
+        g_unlink(session_paths[i]);
+        g_free(session_paths[i]);
+    }
+    g_rmdir(session_dir);
+    g_rmdir(test_dir);
+
+    g_free(cache_parent);
+    g_free(cache_path);
+    g_free(added_path);
+    g_free(session_dir);
+    g_free(cache_dir);
+    g_free(test_dir);
+    return EXIT_SUCCESS;
+}
+
+
+/* Write a session file, returning its path */
+static gchar *write_session_file(const gchar *directory, const gchar *key,
+                                 const gchar *contents)
+{
+    gchar *file_name = g_strconcat(key, ".desktop", NULL);
+    gchar *path = g_build_filename(directory, file_name, NULL);
+    g_assert_true(g_file_set_contents(path, contents, -1, NULL));
+    g_free(file_name);
+    return path;
+}
+
+
+/* Check the visible sessions were found, sorted by name */
+static void check_sessions(FocusRing *ring)
+{
+    g_assert_cmpuint(focus_ring_get_length(ring), ==, 2);
+    g_assert_cmpstr(focus_ring_get_value(ring), ==, "xfce");
+    const Session *session = focus_ring_get_selected(ring);
+    g_assert_cmpstr(session->name, ==, "Xfce Session");
+    g_assert_cmpstr(session->type, ==, "x");
+    g_assert_cmpstr(session->exec, ==, "startxfce4");
+    g_assert_cmpstr(focus_ring_next(ring), ==, "i3");
+}
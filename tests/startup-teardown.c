@@ -0,0 +1,206 @@
+/* Startup & Teardown Check
+ *
+ * Run by `make check` under AddressSanitizer & LeakSanitizer. A test config
+ * is parsed, loaded back from the user's compiled config & from the one built
+ * by `--compile-config`, & turned into CSS, then everything is freed. A file
+ * that can't be parsed must be rejected without exiting. When a display is
+ * available, the whole greeter is started & torn down as well, & a changed
+ * font weight must only reload the fonts' theme component.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#include "app.h"
+#include "config.h"
+#include "config_cache.h"
+#include "memory_report.h"
+#include "theme.h"
+#include "timing.h"
+
+
+// Leaves every color & the password border unset, so parsing copies defaults
+#define TEST_CONFIG \
+    "[greeter]\n" \
+    "user = tester\n" \
+    "show-sys-info = true\n" \
+    "lock-memory = false\n" \
+    "[greeter-hotkeys]\n" \
+    "mod-key = alt\n" \
+    "[greeter-theme]\n" \
+    "background-image = \"\"\n" \
+    "password-character = *\n"
+
+static void check_config_lifecycle(const gchar *config_path);
+static void check_same_config(const Config *expected, const Config *actual);
+static void check_css(const Config *config);
+static void check_app_lifecycle(const gchar *config_path);
+static void check_theme_reload(App *app, const gchar *config_path);
+
+
+int main(void)
+{
+    gchar *test_dir = g_dir_make_tmp("mini-greeter-check-XXXXXX", NULL);
+    g_assert_nonnull(test_dir);
+    gchar *cache_dir = g_build_filename(test_dir, "cache", NULL);
+    gchar *config_path = g_build_filename(test_dir, "greeter.conf", NULL);
+    g_assert_true(g_file_set_contents(config_path, TEST_CONFIG, -1, NULL));
+    // Must be set before anything asks GLib for the user's cache directory
+    g_setenv("XDG_CACHE_HOME", cache_dir, TRUE);
+    g_setenv("LIGHTDM_MINI_GREETER_CONFIG", config_path, TRUE);
+
+    check_config_lifecycle(config_path);
+    check_app_lifecycle(config_path);
+
+    gchar *compiled_path = get_compiled_config_path(config_path);
+    gchar *user_compiled_path = get_user_compiled_config_path(config_path);
+    gchar *user_compiled_dir = g_path_get_dirname(user_compiled_path);
+    g_unlink(compiled_path);
+    g_unlink(user_compiled_path);
+    g_unlink(config_path);
+    g_rmdir(user_compiled_dir);
+    g_rmdir(cache_dir);
+    g_rmdir(test_dir);
+
+    g_free(user_compiled_dir);
+    g_free(user_compiled_path);
+    g_free(compiled_path);
+    g_free(config_path);
+    g_free(cache_dir);
+    g_free(test_dir);
+    return EXIT_SUCCESS;
+}
+
+
+/* Load the config through each path & check they all agree */
+static void check_config_lifecycle(const gchar *config_path)
+{
+    // Nothing is compiled yet, so this parses & writes the user's compiled config
+    Config *parsed = initialize_config();
+    check_css(parsed);
+    g_assert_cmpstr(parsed->login_user, ==, "tester");
+    g_assert_cmpstr(parsed->background_image, ==, "\"\"");
+    g_assert_nonnull(parsed->password_char);
+    g_assert_cmpuint(*parsed->password_char, ==, '*');
+    g_assert_true(gdk_rgba_equal(parsed->password_border_color, parsed->border_color));
+    g_assert_true(gdk_rgba_equal(parsed->sys_info_color, parsed->text_color));
+
+    Config *user_compiled = initialize_config();
+    check_same_config(parsed, user_compiled);
+    check_css(user_compiled);
+
+    g_assert_true(compile_config_file());
+    Config *compiled = initialize_config();
+    check_same_config(parsed, compiled);
+    check_css(compiled);
+
+    // An invalid file is reported instead of exiting, so reloads can skip it
+    g_assert_true(g_file_set_contents(
+        config_path, "[greeter-hotkeys]\nmod-key = hyper\n", -1, NULL));
+    GError *load_error = NULL;
+    g_assert_null(load_config(&load_error));
+    g_assert_nonnull(load_error);
+    g_error_free(load_error);
+    g_assert_true(g_file_set_contents(config_path, TEST_CONFIG, -1, NULL));
+
+    destroy_config(compiled);
+    destroy_config(user_compiled);
+    destroy_config(parsed);
+}
+
+
+/* Check that two Configs hold the same values in separate blocks */
+static void check_same_config(const Config *expected, const Config *actual)
+{
+    g_assert_true(expected != actual);
+    g_assert_cmpstr(expected->login_user, ==, actual->login_user);
+    g_assert_cmpstr(expected->font, ==, actual->font);
+    g_assert_cmpstr(expected->background_image, ==, actual->background_image);
+    g_assert_cmpstr(expected->sys_info_font, ==, actual->sys_info_font);
+    g_assert_cmpstr(expected->sys_info_margin, ==, actual->sys_info_margin);
+    g_assert_cmpstr(expected->memory_report_file, ==, actual->memory_report_file);
+    g_assert_cmpstr(expected->auth_metrics_file, ==, actual->auth_metrics_file);
+    g_assert_true(gdk_rgba_equal(expected->window_color, actual->window_color));
+    g_assert_true(gdk_rgba_equal(expected->sys_info_color, actual->sys_info_color));
+    g_assert_cmpuint(*expected->password_char, ==, *actual->password_char);
+    g_assert_cmpuint(expected->mod_bit, ==, actual->mod_bit);
+    g_assert_cmpuint(expected->session_key, ==, actual->session_key);
+    g_assert_true(expected->show_sys_info == actual->show_sys_info);
+    g_assert_true(expected->lock_memory == actual->lock_memory);
+}
+
+
+/* Build every theme component, so any leaked color strings are reported */
+static void check_css(const Config *config)
+{
+    for (int c = 0; c < THEME_COMPONENT_COUNT; c++) {
+        char *css = build_theme_css(config, (ThemeComponent) c);
+        g_assert_nonnull(css);
+        free(css);
+    }
+
+    char *fonts_css = build_theme_css(config, THEME_FONTS);
+    g_assert_nonnull(strstr(fonts_css, config->font));
+    free(fonts_css);
+    char *sys_info_css = build_theme_css(config, THEME_SYS_INFO);
+    g_assert_nonnull(strstr(sys_info_css, config->sys_info_margin));
+    free(sys_info_css);
+}
+
+
+/* Start & tear down the whole greeter, if there's a display to start it on.
+ *
+ * The daemon is never connected to, so no authentication is started.
+ */
+static void check_app_lifecycle(const gchar *config_path)
+{
+    if (!gtk_init_check(NULL, NULL)) {
+        g_message("No display available, skipping the greeter startup check");
+        return;
+    }
+
+    initialize_timing();
+    initialize_memory_report();
+    App *app = initialize_app(0, NULL);
+    gtk_widget_show_all(GTK_WIDGET(APP_MAIN_WINDOW(app)));
+    for (int i = 0; i < 100 && g_main_context_iteration(NULL, FALSE); i++) {
+        continue;
+    }
+    check_theme_reload(app, config_path);
+    destroy_app(app);
+}
+
+
+/* Change the font weight & check only the fonts' provider is reloaded, in place */
+static void check_theme_reload(App *app, const gchar *config_path)
+{
+    GtkCssProvider *providers[THEME_COMPONENT_COUNT];
+    const char *css[THEME_COMPONENT_COUNT];
+    for (int c = 0; c < THEME_COMPONENT_COUNT; c++) {
+        g_assert_nonnull(app->ui->theme_providers[c]);
+        providers[c] = app->ui->theme_providers[c];
+        css[c] = app->ui->theme_css[c];
+    }
+
+    g_assert_true(g_file_set_contents(
+        config_path, TEST_CONFIG "font-weight = lighter\n", -1, NULL));
+    Config *changed = initialize_config();
+    update_ui_theme(changed, app->ui);
+    for (int c = 0; c < THEME_COMPONENT_COUNT; c++) {
+        g_assert_true(app->ui->theme_providers[c] == providers[c]);
+        if (c == THEME_FONTS) {
+            g_assert_true(app->ui->theme_css[c] != css[c]);
+            g_assert_nonnull(strstr(app->ui->theme_css[c], "lighter"));
+        } else {
+            g_assert_true(app->ui->theme_css[c] == css[c]);
+        }
+    }
+
+    // Put the original theme back before the app is torn down with its config
+    update_ui_theme(app->config, app->ui);
+    destroy_config(changed);
+    g_assert_true(g_file_set_contents(config_path, TEST_CONFIG, -1, NULL));
+}
@@ -0,0 +1,84 @@
+/* User List Check
+ *
+ * Builds the user ring around a default user LightDM doesn't know about, then
+ * loads an avatar on a worker thread & checks it's scaled & handed over.
+ */
+#include <stdlib.h>
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "focus_ring.h"
+#include "users.h"
+
+#define DEFAULT_USER "mini-greeter-test-user"
+#define AVATAR_SIZE 16
+
+
+static gchar *write_avatar_file(const gchar *directory);
+static void count_loaded_avatar(User *user, gpointer user_data);
+
+
+int main(void)
+{
+    gchar *test_dir = g_dir_make_tmp("mini-greeter-users-XXXXXX", NULL);
+    g_assert_nonnull(test_dir);
+    gchar *avatar_path = write_avatar_file(test_dir);
+
+    // The default user is added & selected even though LightDM hides them
+    FocusRing *ring = initialize_user_ring(DEFAULT_USER);
+    g_assert_cmpstr(focus_ring_get_value(ring), ==, DEFAULT_USER);
+    User *user = focus_ring_get_selected(ring);
+    g_assert_null(user->avatar);
+    user->image_path = g_strdup(avatar_path);
+
+    guint loaded_count = 0;
+    GCancellable *cancellable = g_cancellable_new();
+    load_user_avatars(ring, AVATAR_SIZE, cancellable, count_loaded_avatar,
+                      &loaded_count);
+    gint64 deadline = g_get_monotonic_time() + 5 * G_USEC_PER_SEC;
+    while (loaded_count == 0 && g_get_monotonic_time() < deadline) {
+        if (!g_main_context_iteration(NULL, FALSE)) {
+            g_usleep(10000);
+        }
+    }
+    g_assert_cmpuint(loaded_count, ==, 1);
+    g_assert_nonnull(user->avatar);
+    g_assert_true(gdk_pixbuf_get_width(user->avatar) <= AVATAR_SIZE);
+    g_assert_true(gdk_pixbuf_get_height(user->avatar) <= AVATAR_SIZE);
+
+    g_cancellable_cancel(cancellable);
+    g_object_unref(cancellable);
+    destroy_focus_ring(ring);
+    g_unlink(avatar_path);
+    g_free(avatar_path);
+    g_rmdir(test_dir);
+    g_free(test_dir);
+
+    return EXIT_SUCCESS;
+}
+
+
+/* Write a PNG larger than the avatar size, returning its path */
+static gchar *write_avatar_file(const gchar *directory)
+{
+    gchar *path = g_build_filename(directory, "avatar.png", NULL);
+    GdkPixbuf *image =
+        gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, AVATAR_SIZE * 4, AVATAR_SIZE * 2);
+    g_assert_nonnull(image);
+    gdk_pixbuf_fill(image, 0x336699ff);
+    g_assert_true(gdk_pixbuf_save(image, path, "png", NULL, NULL));
+    g_object_unref(image);
+    return path;
+}
+
+
+/* Count the avatars handed to the main thread */
+static void count_loaded_avatar(User *user, gpointer user_data)
+{
+    guint *loaded_count = user_data;
+    g_assert_nonnull(user->avatar);
+    (*loaded_count)++;
+}